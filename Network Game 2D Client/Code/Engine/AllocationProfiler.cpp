@@ -0,0 +1,233 @@
+#include "AllocationProfiler.hpp"
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include "MemoryManager.hpp"
+
+
+//-----------------------------------------------------------------------------------------------
+STATIC volatile bool AllocationProfiler::s_isRunning = false;
+STATIC bool AllocationProfiler::s_isInitialized = false;
+STATIC CRITICAL_SECTION AllocationProfiler::s_cs;
+STATIC volatile LONG AllocationProfiler::s_allocationCounter = 0;
+STATIC unsigned int AllocationProfiler::s_sampleRate = 1;
+STATIC unsigned int AllocationProfiler::s_numFramesProfiled = 0;
+STATIC unsigned int AllocationProfiler::s_numSites = 0;
+STATIC unsigned int AllocationProfiler::s_numDroppedAllocations = 0;
+STATIC AllocationSiteStatistics AllocationProfiler::s_sites[ ALLOCATION_PROFILER_TABLE_SIZE ];
+STATIC AllocationSiteStatistics AllocationProfiler::s_sortedSites[ MAX_ALLOCATION_PROFILER_SITES ];
+
+
+//-----------------------------------------------------------------------------------------------
+static inline unsigned int GetSizeBucketIndex( size_t numBytes )
+{
+	unsigned int bucketIndex = 0;
+	numBytes >>= SMALLEST_ALLOCATION_SIZE_BUCKET_LOG2;
+	while( numBytes != 0 && bucketIndex < NUM_ALLOCATION_SIZE_BUCKETS - 1 )
+	{
+		++bucketIndex;
+		numBytes >>= 1;
+	}
+	return bucketIndex;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+static bool IsMoreLiveBytes( const AllocationSiteStatistics& first, const AllocationSiteStatistics& second )
+{
+	return first.m_numLiveBytes > second.m_numLiveBytes;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+static bool IsMoreTotalAllocations( const AllocationSiteStatistics& first, const AllocationSiteStatistics& second )
+{
+	return first.m_numTotalAllocations > second.m_numTotalAllocations;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+static bool IsMoreTotalBytes( const AllocationSiteStatistics& first, const AllocationSiteStatistics& second )
+{
+	return first.m_numTotalBytes > second.m_numTotalBytes;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+STATIC void AllocationProfiler::Start( unsigned int sampleEveryNthAllocation )
+{
+	if( !s_isInitialized )
+	{
+		InitializeCriticalSection( &s_cs );
+		s_isInitialized = true;
+	}
+
+	EnterCriticalSection( &s_cs );
+	memset( s_sites, 0, sizeof( s_sites ) );
+	s_numSites = 0;
+	s_numDroppedAllocations = 0;
+	s_numFramesProfiled = 0;
+	s_allocationCounter = 0;
+	s_sampleRate = ( sampleEveryNthAllocation == 0 ) ? 1 : sampleEveryNthAllocation;
+	s_isRunning = true;
+	LeaveCriticalSection( &s_cs );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+STATIC void AllocationProfiler::Stop()
+{
+	s_isRunning = false;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+STATIC void AllocationProfiler::AdvanceFrame()
+{
+	if( s_isRunning )
+		++s_numFramesProfiled;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+STATIC unsigned int AllocationProfiler::GetSortedSites( AllocationSiteStatistics* sites_out, unsigned int maxNumSites, AllocationSiteSortKey sortKey )
+{
+	if( !s_isInitialized )
+		return 0;
+
+	EnterCriticalSection( &s_cs );
+	unsigned int numSites = SortSites( sortKey );
+	if( numSites > maxNumSites )
+		numSites = maxNumSites;
+
+	memcpy( sites_out, s_sortedSites, numSites * sizeof( AllocationSiteStatistics ) );
+	LeaveCriticalSection( &s_cs );
+
+	return numSites;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+STATIC bool AllocationProfiler::DumpToFile( const char* filePath )
+{
+	if( !s_isInitialized )
+		return false;
+
+	FILE* file = nullptr;
+	errno_t fileOpenError = fopen_s( &file, filePath, "w" );
+	if( fileOpenError )
+		return false;
+
+	EnterCriticalSection( &s_cs );
+	unsigned int numSites = SortSites( SORT_BY_LIVE_BYTES );
+
+	fprintf( file, "sample rate,%u,frames,%u,dropped allocations,%u\n", s_sampleRate, s_numFramesProfiled, s_numDroppedAllocations );
+	fprintf( file, "file,line,live bytes,live allocations,total bytes,total allocations" );
+	for( unsigned int bucketIndex = 0; bucketIndex < NUM_ALLOCATION_SIZE_BUCKETS; ++bucketIndex )
+		fprintf( file, ",<%u", 1U << ( SMALLEST_ALLOCATION_SIZE_BUCKET_LOG2 + bucketIndex ) );
+	fprintf( file, "\n" );
+
+	for( unsigned int siteIndex = 0; siteIndex < numSites; ++siteIndex )
+	{
+		const AllocationSiteStatistics& site = s_sortedSites[ siteIndex ];
+		fprintf( file, "%s,%u,%Iu,%Iu,%Iu,%Iu", site.m_fileName ? site.m_fileName : "<file not given>", site.m_lineNumber, site.m_numLiveBytes, site.m_numLiveAllocations, site.m_numTotalBytes, site.m_numTotalAllocations );
+		for( unsigned int bucketIndex = 0; bucketIndex < NUM_ALLOCATION_SIZE_BUCKETS; ++bucketIndex )
+			fprintf( file, ",%Iu", site.m_sizeHistogram[ bucketIndex ] );
+		fprintf( file, "\n" );
+	}
+	LeaveCriticalSection( &s_cs );
+
+	fclose( file );
+	return true;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+STATIC void AllocationProfiler::RecordAllocation( MetaData* block )
+{
+	block->m_isSampled = false;
+	if( s_sampleRate > 1 && ( (unsigned int) InterlockedIncrement( &s_allocationCounter ) % s_sampleRate ) != 0 )
+		return;
+
+	EnterCriticalSection( &s_cs );
+	AllocationSiteStatistics* site = FindSite( block->m_fileName, block->m_lineNumber, true );
+	if( site != nullptr )
+	{
+		site->m_numLiveBytes += block->m_requestedSize;
+		++site->m_numLiveAllocations;
+		site->m_numTotalBytes += block->m_requestedSize;
+		++site->m_numTotalAllocations;
+		++site->m_sizeHistogram[ GetSizeBucketIndex( block->m_requestedSize ) ];
+		block->m_isSampled = true;
+	}
+	else
+	{
+		++s_numDroppedAllocations;
+	}
+	LeaveCriticalSection( &s_cs );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+STATIC void AllocationProfiler::RecordFree( MetaData* block )
+{
+	block->m_isSampled = false;
+
+	EnterCriticalSection( &s_cs );
+	AllocationSiteStatistics* site = FindSite( block->m_fileName, block->m_lineNumber, false );
+
+	// blocks sampled before the profiler was last restarted may no longer have any live bytes counted
+	if( site != nullptr && site->m_numLiveAllocations != 0 )
+	{
+		site->m_numLiveBytes -= ( block->m_requestedSize < site->m_numLiveBytes ) ? block->m_requestedSize : site->m_numLiveBytes;
+		--site->m_numLiveAllocations;
+	}
+	LeaveCriticalSection( &s_cs );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+STATIC AllocationSiteStatistics* AllocationProfiler::FindSite( const char* fileName, unsigned int lineNumber, bool shouldAddIfMissing )
+{
+	unsigned int hash = (unsigned int) ( (size_t) fileName >> 3 ) ^ ( lineNumber * 2654435761U );
+	for( unsigned int probeIndex = 0; probeIndex < ALLOCATION_PROFILER_TABLE_SIZE; ++probeIndex )
+	{
+		AllocationSiteStatistics& site = s_sites[ ( hash + probeIndex ) & ( ALLOCATION_PROFILER_TABLE_SIZE - 1 ) ];
+		if( site.m_numTotalAllocations == 0 )
+		{
+			if( !shouldAddIfMissing || s_numSites >= MAX_ALLOCATION_PROFILER_SITES )
+				return nullptr;
+
+			site.m_fileName = fileName;
+			site.m_lineNumber = lineNumber;
+			++s_numSites;
+			return &site;
+		}
+
+		if( site.m_fileName == fileName && site.m_lineNumber == lineNumber )
+			return &site;
+	}
+
+	return nullptr;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+STATIC unsigned int AllocationProfiler::SortSites( AllocationSiteSortKey sortKey )
+{
+	unsigned int numSites = 0;
+	for( unsigned int siteIndex = 0; siteIndex < ALLOCATION_PROFILER_TABLE_SIZE && numSites < MAX_ALLOCATION_PROFILER_SITES; ++siteIndex )
+	{
+		if( s_sites[ siteIndex ].m_numTotalAllocations != 0 )
+			s_sortedSites[ numSites++ ] = s_sites[ siteIndex ];
+	}
+
+	if( sortKey == SORT_BY_LIVE_BYTES )
+		std::sort( s_sortedSites, s_sortedSites + numSites, IsMoreLiveBytes );
+	else if( sortKey == SORT_BY_TOTAL_ALLOCATIONS )
+		std::sort( s_sortedSites, s_sortedSites + numSites, IsMoreTotalAllocations );
+	else
+		std::sort( s_sortedSites, s_sortedSites + numSites, IsMoreTotalBytes );
+
+	return numSites;
+}
\ No newline at end of file
@@ -0,0 +1,82 @@
+#ifndef include_AllocationProfiler
+#define include_AllocationProfiler
+#pragma once
+
+//-----------------------------------------------------------------------------------------------
+#include <windows.h>
+#include "EngineCommon.hpp"
+
+
+//-----------------------------------------------------------------------------------------------
+struct MetaData;
+
+
+//-----------------------------------------------------------------------------------------------
+const unsigned int ALLOCATION_PROFILER_TABLE_SIZE = 1024;
+const unsigned int MAX_ALLOCATION_PROFILER_SITES = ALLOCATION_PROFILER_TABLE_SIZE * 3 / 4;
+const unsigned int NUM_ALLOCATION_SIZE_BUCKETS = 16;
+const unsigned int SMALLEST_ALLOCATION_SIZE_BUCKET_LOG2 = 4;
+const char* const DEFAULT_ALLOCATION_PROFILE_FILE_PATH = "AllocationProfile.csv";
+
+
+//-----------------------------------------------------------------------------------------------
+//Bucket 0 counts allocations below 1 << SMALLEST_ALLOCATION_SIZE_BUCKET_LOG2 bytes, every bucket
+//after that doubles, and the last one collects everything bigger.
+struct AllocationSiteStatistics
+{
+	const char*		m_fileName;
+	unsigned int	m_lineNumber;
+	size_t			m_numLiveBytes;
+	size_t			m_numLiveAllocations;
+	size_t			m_numTotalBytes;
+	size_t			m_numTotalAllocations;
+	size_t			m_sizeHistogram[ NUM_ALLOCATION_SIZE_BUCKETS ];
+};
+
+
+//-----------------------------------------------------------------------------------------------
+enum AllocationSiteSortKey
+{
+	SORT_BY_LIVE_BYTES,
+	SORT_BY_TOTAL_ALLOCATIONS,
+	SORT_BY_TOTAL_BYTES,
+};
+
+
+//-----------------------------------------------------------------------------------------------
+//Aggregates MemoryManager allocations by the file and line they came from. Sites live in an open
+//addressed table keyed by the __FILE__ pointer and line, so recording never allocates. When
+//sampling, only every Nth allocation (and later its free) is recorded; counts are not scaled.
+class AllocationProfiler
+{
+public:
+	static void Start( unsigned int sampleEveryNthAllocation );
+	static void Stop();
+	static bool IsRunning() { return s_isRunning; }
+	static void AdvanceFrame();
+	static unsigned int GetSampleRate() { return s_sampleRate; }
+	static unsigned int GetNumFramesProfiled() { return s_numFramesProfiled; }
+	static unsigned int GetNumDroppedAllocations() { return s_numDroppedAllocations; }
+	static unsigned int GetSortedSites( AllocationSiteStatistics* sites_out, unsigned int maxNumSites, AllocationSiteSortKey sortKey );
+	static bool DumpToFile( const char* filePath );
+	static void RecordAllocation( MetaData* block );
+	static void RecordFree( MetaData* block );
+
+private:
+	static AllocationSiteStatistics* FindSite( const char* fileName, unsigned int lineNumber, bool shouldAddIfMissing );
+	static unsigned int SortSites( AllocationSiteSortKey sortKey );
+
+	static volatile bool				s_isRunning;
+	static bool							s_isInitialized;
+	static CRITICAL_SECTION				s_cs;
+	static volatile LONG				s_allocationCounter;
+	static unsigned int					s_sampleRate;
+	static unsigned int					s_numFramesProfiled;
+	static unsigned int					s_numSites;
+	static unsigned int					s_numDroppedAllocations;
+	static AllocationSiteStatistics		s_sites[ ALLOCATION_PROFILER_TABLE_SIZE ];
+	static AllocationSiteStatistics		s_sortedSites[ MAX_ALLOCATION_PROFILER_SITES ];
+};
+
+
+#endif // include_AllocationProfiler
\ No newline at end of file
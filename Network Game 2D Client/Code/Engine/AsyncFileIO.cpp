@@ -0,0 +1,255 @@
+#include "AsyncFileIO.hpp"
+#include <process.h>
+#include <string.h>
+#include "JobManager.hpp"
+#include "MemoryManager.hpp"
+#include "DeferredEventQueue.hpp"
+#include "NewMacroDef.hpp"
+
+
+//-----------------------------------------------------------------------------------------------
+STATIC HANDLE AsyncFileIO::s_completionPort = nullptr;
+STATIC HANDLE AsyncFileIO::s_completionThreadHandle = nullptr;
+STATIC AsyncFileIOStatistics AsyncFileIO::s_statistics;
+
+
+//-----------------------------------------------------------------------------------------------
+//A completion with no overlapped is the shutdown message.
+unsigned int __stdcall AsyncFileIOCompletionThreadEntryFunc( void* )
+{
+	while( true )
+	{
+		DWORD numBytesTransferred = 0;
+		ULONG_PTR completionKey = 0;
+		OVERLAPPED* overlapped = nullptr;
+		BOOL didSucceed = GetQueuedCompletionStatus( AsyncFileIO::s_completionPort, &numBytesTransferred, &completionKey, &overlapped, INFINITE );
+		if( overlapped == nullptr )
+			break;
+
+		AsyncFileRequest* request = reinterpret_cast< AsyncFileRequest* >( overlapped );
+		AsyncFileIO::CompleteRequest( request, numBytesTransferred, didSucceed ? ERROR_SUCCESS : GetLastError() );
+	}
+
+	DeferredEventQueue::ReleaseThreadRing();
+	MemoryManager::FlushThreadCache();
+	return 0;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+STATIC void AsyncFileIO::Startup( bool shouldUseCompletionPort )
+{
+	if( s_completionPort != nullptr )
+		return;
+
+	memset( &s_statistics, 0, sizeof( s_statistics ) );
+	if( !shouldUseCompletionPort )
+		return;
+
+	s_completionPort = CreateIoCompletionPort( INVALID_HANDLE_VALUE, nullptr, 0, 1 );
+	if( s_completionPort == nullptr )
+		return;
+
+	s_completionThreadHandle = reinterpret_cast< HANDLE >( _beginthreadex( nullptr, 0, AsyncFileIOCompletionThreadEntryFunc, nullptr, 0, nullptr ) );
+	if( s_completionThreadHandle == nullptr )
+	{
+		CloseHandle( s_completionPort );
+		s_completionPort = nullptr;
+	}
+}
+
+
+//-----------------------------------------------------------------------------------------------
+//Requests still in flight are cancelled by closing their files, not here.
+STATIC void AsyncFileIO::Shutdown()
+{
+	if( s_completionPort == nullptr )
+		return;
+
+	PostQueuedCompletionStatus( s_completionPort, 0, 0, nullptr );
+	WaitForSingleObject( s_completionThreadHandle, INFINITE );
+	CloseHandle( s_completionThreadHandle );
+	CloseHandle( s_completionPort );
+	s_completionThreadHandle = nullptr;
+	s_completionPort = nullptr;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+STATIC HANDLE AsyncFileIO::OpenFileForReading( const std::string& filePath )
+{
+	HANDLE fileHandle = CreateFileA( filePath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_OVERLAPPED, nullptr );
+	if( fileHandle != INVALID_HANDLE_VALUE && s_completionPort != nullptr )
+		CreateIoCompletionPort( fileHandle, s_completionPort, 0, 0 );
+
+	return fileHandle;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+STATIC HANDLE AsyncFileIO::OpenFileForWriting( const std::string& filePath )
+{
+	HANDLE fileHandle = CreateFileA( filePath.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_FLAG_OVERLAPPED, nullptr );
+	if( fileHandle != INVALID_HANDLE_VALUE && s_completionPort != nullptr )
+		CreateIoCompletionPort( fileHandle, s_completionPort, 0, 0 );
+
+	return fileHandle;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+STATIC void AsyncFileIO::CloseFile( HANDLE fileHandle )
+{
+	if( fileHandle != INVALID_HANDLE_VALUE )
+		CloseHandle( fileHandle );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+STATIC bool AsyncFileIO::SubmitRead( AsyncFileRequest* request, HANDLE fileHandle, void* buffer_out, DWORD numBytes, unsigned long long fileOffset, JobCounter* completionCounter )
+{
+	memset( request, 0, sizeof( AsyncFileRequest ) );
+	request->m_overlapped.Offset = (DWORD) ( fileOffset & 0xffffffff );
+	request->m_overlapped.OffsetHigh = (DWORD) ( fileOffset >> 32 );
+	request->m_fileHandle = fileHandle;
+	request->m_buffer = static_cast< byte_t* >( buffer_out );
+	request->m_numBytesRequested = numBytes;
+	request->m_isWrite = false;
+	request->m_completionCounter = completionCounter;
+	return Submit( request );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+STATIC bool AsyncFileIO::SubmitWrite( AsyncFileRequest* request, HANDLE fileHandle, const void* buffer, DWORD numBytes, unsigned long long fileOffset, JobCounter* completionCounter )
+{
+	memset( request, 0, sizeof( AsyncFileRequest ) );
+	request->m_overlapped.Offset = (DWORD) ( fileOffset & 0xffffffff );
+	request->m_overlapped.OffsetHigh = (DWORD) ( fileOffset >> 32 );
+	request->m_fileHandle = fileHandle;
+	request->m_buffer = static_cast< byte_t* >( const_cast< void* >( buffer ) );
+	request->m_numBytesRequested = numBytes;
+	request->m_isWrite = true;
+	request->m_completionCounter = completionCounter;
+	return Submit( request );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+//The counter goes up here and comes back down when the request completes, failed or not. A
+//request that fails to even start still completes, straight away, so waiting on it never hangs;
+//false only tells the caller it did.
+STATIC bool AsyncFileIO::Submit( AsyncFileRequest* request )
+{
+	if( request->m_completionCounter != nullptr )
+		InterlockedIncrement( &request->m_completionCounter->m_numUnfinishedJobs );
+
+	InterlockedIncrement( &s_statistics.m_numRequestsInFlight );
+
+	if( s_completionPort == nullptr )
+	{
+		JobManager::AddNewJob( new BlockingFileIOJob( request ) );
+		return true;
+	}
+
+	// a request that finishes straight away is still posted to the completion port
+	BOOL didStart = FALSE;
+	if( request->m_isWrite )
+		didStart = WriteFile( request->m_fileHandle, request->m_buffer, request->m_numBytesRequested, nullptr, &request->m_overlapped );
+	else
+		didStart = ReadFile( request->m_fileHandle, request->m_buffer, request->m_numBytesRequested, nullptr, &request->m_overlapped );
+
+	if( didStart )
+		return true;
+
+	DWORD errorCode = GetLastError();
+	if( errorCode == ERROR_IO_PENDING )
+		return true;
+
+	CompleteRequest( request, 0, errorCode );
+	return false;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+//The files are always opened for overlapped I/O, so even a blocking request needs an event to
+//wait on.
+STATIC void AsyncFileIO::IssueBlockingRequest( AsyncFileRequest* request )
+{
+	request->m_overlapped.hEvent = CreateEventA( nullptr, TRUE, FALSE, nullptr );
+
+	BOOL didStart = FALSE;
+	if( request->m_isWrite )
+		didStart = WriteFile( request->m_fileHandle, request->m_buffer, request->m_numBytesRequested, nullptr, &request->m_overlapped );
+	else
+		didStart = ReadFile( request->m_fileHandle, request->m_buffer, request->m_numBytesRequested, nullptr, &request->m_overlapped );
+
+	DWORD numBytesTransferred = 0;
+	DWORD errorCode = ERROR_SUCCESS;
+	if( !didStart && GetLastError() != ERROR_IO_PENDING )
+		errorCode = GetLastError();
+	else if( !GetOverlappedResult( request->m_fileHandle, &request->m_overlapped, &numBytesTransferred, TRUE ) )
+		errorCode = GetLastError();
+
+	CloseHandle( request->m_overlapped.hEvent );
+	request->m_overlapped.hEvent = nullptr;
+	CompleteRequest( request, numBytesTransferred, errorCode );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+//Reading past the end of the file counts as success with fewer bytes than requested.
+STATIC void AsyncFileIO::CompleteRequest( AsyncFileRequest* request, DWORD numBytesTransferred, DWORD errorCode )
+{
+	if( errorCode == ERROR_HANDLE_EOF )
+		errorCode = ERROR_SUCCESS;
+
+	request->m_numBytesTransferred = numBytesTransferred;
+	request->m_errorCode = errorCode;
+
+	if( errorCode != ERROR_SUCCESS )
+	{
+		InterlockedIncrement( &s_statistics.m_numRequestsFailed );
+	}
+	else if( request->m_isWrite )
+	{
+		InterlockedIncrement( &s_statistics.m_numWritesCompleted );
+		InterlockedExchangeAdd64( &s_statistics.m_numBytesWritten, numBytesTransferred );
+	}
+	else
+	{
+		InterlockedIncrement( &s_statistics.m_numReadsCompleted );
+		InterlockedExchangeAdd64( &s_statistics.m_numBytesRead, numBytesTransferred );
+	}
+
+	InterlockedDecrement( &s_statistics.m_numRequestsInFlight );
+
+	// the waiter may free the request as soon as the counter is signalled
+	JobCounter* completionCounter = request->m_completionCounter;
+	if( completionCounter != nullptr )
+		JobManager::SignalCounter( completionCounter );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+STATIC void AsyncFileIO::ResetStatistics()
+{
+	LONG numRequestsInFlight = s_statistics.m_numRequestsInFlight;
+	memset( &s_statistics, 0, sizeof( s_statistics ) );
+	s_statistics.m_numRequestsInFlight = numRequestsInFlight;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+BlockingFileIOJob::BlockingFileIOJob( AsyncFileRequest* request )
+	: m_request( request )
+{
+	m_jobType = JOB_TYPE_FILE_IO;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void BlockingFileIOJob::Execute()
+{
+	AsyncFileIO::IssueBlockingRequest( m_request );
+}
\ No newline at end of file
@@ -0,0 +1,91 @@
+#ifndef include_AsyncFileIO
+#define include_AsyncFileIO
+#pragma once
+
+//-----------------------------------------------------------------------------------------------
+#include <string>
+#include <windows.h>
+#include "Job.hpp"
+#include "EngineCommon.hpp"
+
+
+//-----------------------------------------------------------------------------------------------
+//The OVERLAPPED has to stay first: the completion port hands it back and the request is found
+//from its address. The request and its buffer belong to the caller and must stay alive until
+//the completion counter has been waited on.
+struct AsyncFileRequest
+{
+	OVERLAPPED		m_overlapped;
+	HANDLE			m_fileHandle;
+	byte_t*			m_buffer;
+	DWORD			m_numBytesRequested;
+	DWORD			m_numBytesTransferred;
+	DWORD			m_errorCode;
+	bool			m_isWrite;
+	JobCounter*		m_completionCounter;
+};
+
+
+//-----------------------------------------------------------------------------------------------
+struct AsyncFileIOStatistics
+{
+	volatile LONG		m_numRequestsInFlight;
+	volatile LONG		m_numReadsCompleted;
+	volatile LONG		m_numWritesCompleted;
+	volatile LONG		m_numRequestsFailed;
+	volatile LONGLONG	m_numBytesRead;
+	volatile LONGLONG	m_numBytesWritten;
+};
+
+
+//-----------------------------------------------------------------------------------------------
+//Reads and writes run as overlapped I/O, so any number can be in flight without a thread each.
+//One thread waits on the completion port and counts each finished request off its completion
+//counter, which releases whatever waits on the counter through the JobManager. Without a
+//completion port every request instead becomes a blocking JOB_TYPE_FILE_IO job. Needs the
+//JobManager started first and shut down after.
+class AsyncFileIO
+{
+public:
+	static void Startup( bool shouldUseCompletionPort = true );
+	static void Shutdown();
+	static HANDLE OpenFileForReading( const std::string& filePath );
+	static HANDLE OpenFileForWriting( const std::string& filePath );
+	static void CloseFile( HANDLE fileHandle );
+	static bool SubmitRead( AsyncFileRequest* request, HANDLE fileHandle, void* buffer_out, DWORD numBytes, unsigned long long fileOffset, JobCounter* completionCounter );
+	static bool SubmitWrite( AsyncFileRequest* request, HANDLE fileHandle, const void* buffer, DWORD numBytes, unsigned long long fileOffset, JobCounter* completionCounter );
+	static bool IsUsingCompletionPort() { return s_completionPort != nullptr; }
+	static const AsyncFileIOStatistics& GetStatistics() { return s_statistics; }
+	static void ResetStatistics();
+
+private:
+	friend unsigned int __stdcall AsyncFileIOCompletionThreadEntryFunc( void* data );
+	friend class BlockingFileIOJob;
+
+	static bool Submit( AsyncFileRequest* request );
+	static void IssueBlockingRequest( AsyncFileRequest* request );
+	static void CompleteRequest( AsyncFileRequest* request, DWORD numBytesTransferred, DWORD errorCode );
+
+	static HANDLE					s_completionPort;
+	static HANDLE					s_completionThreadHandle;
+	static AsyncFileIOStatistics	s_statistics;
+};
+
+
+//-----------------------------------------------------------------------------------------------
+unsigned int __stdcall AsyncFileIOCompletionThreadEntryFunc( void* data );
+
+
+//-----------------------------------------------------------------------------------------------
+class BlockingFileIOJob : public Job, public PooledObject< BlockingFileIOJob >
+{
+public:
+	BlockingFileIOJob( AsyncFileRequest* request );
+	void Execute();
+
+private:
+	AsyncFileRequest*	m_request;
+};
+
+
+#endif // include_AsyncFileIO
\ No newline at end of file
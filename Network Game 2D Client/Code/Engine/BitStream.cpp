@@ -0,0 +1,336 @@
+#include <string.h>
+#include <vector>
+#include "BitStream.hpp"
+#include "Time.hpp"
+#include "NewMacroDef.hpp"
+
+
+//-----------------------------------------------------------------------------------------------
+BitWriter::BitWriter( void* buffer, unsigned int bufferSizeInBytes )
+	: m_buffer( (unsigned char*) buffer )
+	, m_bufferSizeInBits( bufferSizeInBytes * 8 )
+	, m_numBitsWritten( 0 )
+	, m_byteIndex( 0 )
+	, m_scratch( 0 )
+	, m_numScratchBits( 0 )
+	, m_hasOverflowed( false )
+{
+	// positions are counted in bits in an unsigned int
+	assert( bufferSizeInBytes <= MAX_BIT_STREAM_BUFFER_SIZE_IN_BYTES );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void BitWriter::WriteVarUInt( unsigned int value )
+{
+	while( value >= 0x80 )
+	{
+		WriteBits( ( value & 0x7f ) | 0x80, 8 );
+		value >>= 7;
+	}
+	WriteBits( value, 8 );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void BitWriter::WriteRangedInt( int value, int minValue, int maxValue )
+{
+	assert( minValue <= maxValue );
+	if( value < minValue )
+		value = minValue;
+	if( value > maxValue )
+		value = maxValue;
+
+	unsigned int range = (unsigned int) maxValue - (unsigned int) minValue;
+	WriteBits( (unsigned int) value - (unsigned int) minValue, GetNumBitsRequired( range ) );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void BitWriter::WriteQuantizedFloat( float value, float minValue, float maxValue, unsigned int numBits )
+{
+	assert( minValue < maxValue && numBits > 0 && numBits <= MAX_BITS_PER_WRITE );
+	if( value < minValue )
+		value = minValue;
+	if( value > maxValue )
+		value = maxValue;
+
+	unsigned int maxQuantizedValue = (unsigned int) ( ( 1ULL << numBits ) - 1 );
+	double normalizedValue = ( (double) value - minValue ) / ( (double) maxValue - minValue );
+	WriteBits( (unsigned int) ( normalizedValue * maxQuantizedValue + 0.5 ), numBits );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void BitWriter::AlignToByte()
+{
+	unsigned int numPaddingBits = ( 8 - ( m_numBitsWritten & 7 ) ) & 7;
+	WriteBits( 0, numPaddingBits );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void BitWriter::WritePendingScratchBytes()
+{
+	while( m_numScratchBits >= 8 )
+	{
+		m_buffer[ m_byteIndex++ ] = (unsigned char) m_scratch;
+		m_scratch >>= 8;
+		m_numScratchBits -= 8;
+	}
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void BitWriter::WriteAlignedBytes( const void* data, unsigned int numBytes )
+{
+	AlignToByte();
+	if( m_hasOverflowed || m_numBitsWritten + numBytes * 8 > m_bufferSizeInBits )
+	{
+		m_hasOverflowed = true;
+		return;
+	}
+
+	WritePendingScratchBytes();
+	memcpy( &m_buffer[ m_byteIndex ], data, numBytes );
+	m_byteIndex += numBytes;
+	m_numBitsWritten += numBytes * 8;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void BitWriter::Flush()
+{
+	WritePendingScratchBytes();
+	if( m_numScratchBits > 0 )
+	{
+		m_buffer[ m_byteIndex++ ] = (unsigned char) m_scratch;
+		m_scratch = 0;
+		m_numScratchBits = 0;
+		m_numBitsWritten = m_byteIndex * 8;
+	}
+}
+
+
+//-----------------------------------------------------------------------------------------------
+BitReader::BitReader( const void* buffer, unsigned int bufferSizeInBytes )
+	: m_buffer( (const unsigned char*) buffer )
+	, m_bufferSizeInBytes( bufferSizeInBytes )
+	, m_bufferSizeInBits( bufferSizeInBytes * 8 )
+	, m_numBitsRead( 0 )
+	, m_byteIndex( 0 )
+	, m_scratch( 0 )
+	, m_numScratchBits( 0 )
+	, m_hasOverflowed( false )
+{
+	assert( bufferSizeInBytes <= MAX_BIT_STREAM_BUFFER_SIZE_IN_BYTES );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+unsigned int BitReader::ReadVarUInt()
+{
+	unsigned int value = 0;
+	for( unsigned int byteIndex = 0; byteIndex < MAX_VARINT_BYTES; ++byteIndex )
+	{
+		unsigned int byteValue = ReadBits( 8 );
+		value |= ( byteValue & 0x7f ) << ( byteIndex * 7 );
+		if( ( byteValue & 0x80 ) == 0 )
+			return value;
+	}
+
+	m_hasOverflowed = true;
+	return 0;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+int BitReader::ReadRangedInt( int minValue, int maxValue )
+{
+	assert( minValue <= maxValue );
+	unsigned int range = (unsigned int) maxValue - (unsigned int) minValue;
+	unsigned int value = ReadBits( GetNumBitsRequired( range ) );
+	if( value > range )
+	{
+		m_hasOverflowed = true;
+		return minValue;
+	}
+
+	return (int) ( (unsigned int) minValue + value );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+float BitReader::ReadQuantizedFloat( float minValue, float maxValue, unsigned int numBits )
+{
+	assert( minValue < maxValue && numBits > 0 && numBits <= MAX_BITS_PER_WRITE );
+	unsigned int maxQuantizedValue = (unsigned int) ( ( 1ULL << numBits ) - 1 );
+	double normalizedValue = (double) ReadBits( numBits ) / maxQuantizedValue;
+	return (float) ( minValue + normalizedValue * ( (double) maxValue - minValue ) );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void BitReader::AlignToByte()
+{
+	unsigned int numPaddingBits = ( 8 - ( m_numBitsRead & 7 ) ) & 7;
+	ReadBits( numPaddingBits );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void BitReader::ReadAlignedBytes( void* data_out, unsigned int numBytes )
+{
+	AlignToByte();
+	if( m_hasOverflowed || m_numBitsRead + numBytes * 8 > m_bufferSizeInBits )
+	{
+		m_hasOverflowed = true;
+		return;
+	}
+
+	unsigned char* output = (unsigned char*) data_out;
+	while( numBytes > 0 && m_numScratchBits >= 8 )
+	{
+		*output++ = (unsigned char) m_scratch;
+		m_scratch >>= 8;
+		m_numScratchBits -= 8;
+		m_numBitsRead += 8;
+		--numBytes;
+	}
+
+	memcpy( output, &m_buffer[ m_byteIndex ], numBytes );
+	m_byteIndex += numBytes;
+	m_numBitsRead += numBytes * 8;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+struct BenchmarkRecord
+{
+	bool			m_isMoving;
+	int				m_packetNumberDelta;
+	unsigned int	m_playerID;
+	float			m_xPosition;
+	float			m_yPosition;
+	float			m_xVelocity;
+	float			m_yVelocity;
+	float			m_yawDegrees;
+};
+
+
+//-----------------------------------------------------------------------------------------------
+const float BENCHMARK_WORLD_SIZE = 1024.f;
+const float BENCHMARK_MAX_SPEED = 64.f;
+const unsigned int BENCHMARK_POSITION_BITS = 16;
+const unsigned int BENCHMARK_VELOCITY_BITS = 12;
+const unsigned int BENCHMARK_YAW_BITS = 9;
+const unsigned int BENCHMARK_MAX_PLAYER_ID = 255;
+
+
+//-----------------------------------------------------------------------------------------------
+static void WriteBenchmarkRecord( BitWriter& writer, const BenchmarkRecord& record )
+{
+	writer.WriteBool( record.m_isMoving );
+	writer.WriteVarInt( record.m_packetNumberDelta );
+	writer.WriteRangedInt( record.m_playerID, 0, BENCHMARK_MAX_PLAYER_ID );
+	writer.WriteQuantizedFloat( record.m_xPosition, 0.f, BENCHMARK_WORLD_SIZE, BENCHMARK_POSITION_BITS );
+	writer.WriteQuantizedFloat( record.m_yPosition, 0.f, BENCHMARK_WORLD_SIZE, BENCHMARK_POSITION_BITS );
+	writer.WriteQuantizedFloat( record.m_xVelocity, -BENCHMARK_MAX_SPEED, BENCHMARK_MAX_SPEED, BENCHMARK_VELOCITY_BITS );
+	writer.WriteQuantizedFloat( record.m_yVelocity, -BENCHMARK_MAX_SPEED, BENCHMARK_MAX_SPEED, BENCHMARK_VELOCITY_BITS );
+	writer.WriteQuantizedFloat( record.m_yawDegrees, 0.f, 360.f, BENCHMARK_YAW_BITS );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+static void ReadBenchmarkRecord( BitReader& reader, BenchmarkRecord& record_out )
+{
+	record_out.m_isMoving = reader.ReadBool();
+	record_out.m_packetNumberDelta = reader.ReadVarInt();
+	record_out.m_playerID = reader.ReadRangedInt( 0, BENCHMARK_MAX_PLAYER_ID );
+	record_out.m_xPosition = reader.ReadQuantizedFloat( 0.f, BENCHMARK_WORLD_SIZE, BENCHMARK_POSITION_BITS );
+	record_out.m_yPosition = reader.ReadQuantizedFloat( 0.f, BENCHMARK_WORLD_SIZE, BENCHMARK_POSITION_BITS );
+	record_out.m_xVelocity = reader.ReadQuantizedFloat( -BENCHMARK_MAX_SPEED, BENCHMARK_MAX_SPEED, BENCHMARK_VELOCITY_BITS );
+	record_out.m_yVelocity = reader.ReadQuantizedFloat( -BENCHMARK_MAX_SPEED, BENCHMARK_MAX_SPEED, BENCHMARK_VELOCITY_BITS );
+	record_out.m_yawDegrees = reader.ReadQuantizedFloat( 0.f, 360.f, BENCHMARK_YAW_BITS );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+static bool AreValuesWithinStep( float value1, float value2, float minValue, float maxValue, unsigned int numBits )
+{
+	float step = ( maxValue - minValue ) / (float) ( ( 1U << numBits ) - 1 );
+	float difference = value1 - value2;
+	return ( difference <= step && difference >= -step );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+static bool DoBenchmarkRecordsMatch( const BenchmarkRecord& original, const BenchmarkRecord& decoded )
+{
+	return original.m_isMoving == decoded.m_isMoving
+		&& original.m_packetNumberDelta == decoded.m_packetNumberDelta
+		&& original.m_playerID == decoded.m_playerID
+		&& AreValuesWithinStep( original.m_xPosition, decoded.m_xPosition, 0.f, BENCHMARK_WORLD_SIZE, BENCHMARK_POSITION_BITS )
+		&& AreValuesWithinStep( original.m_yPosition, decoded.m_yPosition, 0.f, BENCHMARK_WORLD_SIZE, BENCHMARK_POSITION_BITS )
+		&& AreValuesWithinStep( original.m_xVelocity, decoded.m_xVelocity, -BENCHMARK_MAX_SPEED, BENCHMARK_MAX_SPEED, BENCHMARK_VELOCITY_BITS )
+		&& AreValuesWithinStep( original.m_yVelocity, decoded.m_yVelocity, -BENCHMARK_MAX_SPEED, BENCHMARK_MAX_SPEED, BENCHMARK_VELOCITY_BITS )
+		&& AreValuesWithinStep( original.m_yawDegrees, decoded.m_yawDegrees, 0.f, 360.f, BENCHMARK_YAW_BITS );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+static float GetBenchmarkRandomFloat( unsigned int& seed, float minValue, float maxValue )
+{
+	seed = seed * 1664525U + 1013904223U;
+	return minValue + ( maxValue - minValue ) * ( (float) ( seed >> 8 ) / (float) 0xffffff );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+BitStreamBenchmarkResults RunBitStreamBenchmark( unsigned int numRecords )
+{
+	BitStreamBenchmarkResults results;
+	results.m_numRecords = numRecords;
+	results.m_numRawBytesPerRecord = sizeof( bool ) + sizeof( int ) + sizeof( unsigned int ) + 5 * sizeof( float );
+
+	std::vector< BenchmarkRecord > originalRecords( numRecords );
+	std::vector< BenchmarkRecord > decodedRecords( numRecords );
+	unsigned int seed = 12345;
+	for( unsigned int recordIndex = 0; recordIndex < numRecords; ++recordIndex )
+	{
+		BenchmarkRecord& record = originalRecords[ recordIndex ];
+		record.m_isMoving = ( recordIndex & 3 ) != 0;
+		record.m_packetNumberDelta = (int) GetBenchmarkRandomFloat( seed, -300.f, 300.f );
+		record.m_playerID = recordIndex & BENCHMARK_MAX_PLAYER_ID;
+		record.m_xPosition = GetBenchmarkRandomFloat( seed, 0.f, BENCHMARK_WORLD_SIZE );
+		record.m_yPosition = GetBenchmarkRandomFloat( seed, 0.f, BENCHMARK_WORLD_SIZE );
+		record.m_xVelocity = GetBenchmarkRandomFloat( seed, -BENCHMARK_MAX_SPEED, BENCHMARK_MAX_SPEED );
+		record.m_yVelocity = GetBenchmarkRandomFloat( seed, -BENCHMARK_MAX_SPEED, BENCHMARK_MAX_SPEED );
+		record.m_yawDegrees = GetBenchmarkRandomFloat( seed, 0.f, 359.f );
+	}
+
+	size_t bufferSizeInBytes = (size_t) numRecords * results.m_numRawBytesPerRecord + 1;
+	assert( bufferSizeInBytes <= MAX_BIT_STREAM_BUFFER_SIZE_IN_BYTES );
+	std::vector< unsigned char > buffer( bufferSizeInBytes );
+	BitWriter writer( &buffer[ 0 ], (unsigned int) bufferSizeInBytes );
+	double startTime = GetCurrentTimeSeconds();
+	for( unsigned int recordIndex = 0; recordIndex < numRecords; ++recordIndex )
+		WriteBenchmarkRecord( writer, originalRecords[ recordIndex ] );
+
+	writer.Flush();
+	results.m_secondsWriting = GetCurrentTimeSeconds() - startTime;
+
+	BitReader reader( &buffer[ 0 ], writer.GetNumBytesWritten() );
+	startTime = GetCurrentTimeSeconds();
+	for( unsigned int recordIndex = 0; recordIndex < numRecords; ++recordIndex )
+		ReadBenchmarkRecord( reader, decodedRecords[ recordIndex ] );
+
+	results.m_secondsReading = GetCurrentTimeSeconds() - startTime;
+
+	results.m_didRoundTripMatch = !writer.HasOverflowed() && !reader.HasOverflowed();
+	for( unsigned int recordIndex = 0; recordIndex < numRecords && results.m_didRoundTripMatch; ++recordIndex )
+		results.m_didRoundTripMatch = DoBenchmarkRecordsMatch( originalRecords[ recordIndex ], decodedRecords[ recordIndex ] );
+
+	results.m_numBitsPerRecord = ( numRecords == 0 ) ? 0 : writer.GetNumBitsWritten() / numRecords;
+	return results;
+}
\ No newline at end of file
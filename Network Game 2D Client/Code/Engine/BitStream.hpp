@@ -0,0 +1,203 @@
+#ifndef include_BitStream
+#define include_BitStream
+#pragma once
+
+//-----------------------------------------------------------------------------------------------
+#include <assert.h>
+
+//Bits are packed least significant bit first into a 64 bit scratch word which is written to (or
+//refilled from) the caller's buffer 32 bits at a time, little endian, so the common path is a
+//shift, an or and a single compare per value.
+
+
+//-----------------------------------------------------------------------------------------------
+const unsigned int MAX_BITS_PER_WRITE = 32;
+const unsigned int MAX_VARINT_BYTES = 5;
+const unsigned int MAX_BIT_STREAM_BUFFER_SIZE_IN_BYTES = 0xffffffff / 8;
+
+
+//-----------------------------------------------------------------------------------------------
+inline unsigned int GetNumBitsRequired( unsigned int maxValue )
+{
+	unsigned int numBits = 0;
+	while( maxValue != 0 )
+	{
+		++numBits;
+		maxValue >>= 1;
+	}
+	return numBits;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+inline unsigned int ZigZagEncode( int value )
+{
+	return ( (unsigned int) value << 1 ) ^ (unsigned int) ( value >> 31 );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+inline int ZigZagDecode( unsigned int value )
+{
+	return (int) ( value >> 1 ) ^ -(int) ( value & 1 );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+class BitWriter
+{
+public:
+	BitWriter( void* buffer, unsigned int bufferSizeInBytes );
+	void WriteBits( unsigned int value, unsigned int numBits );
+	void WriteBool( bool value ) { WriteBits( value ? 1 : 0, 1 ); }
+	void WriteVarUInt( unsigned int value );
+	void WriteVarInt( int value ) { WriteVarUInt( ZigZagEncode( value ) ); }
+	void WriteRangedInt( int value, int minValue, int maxValue );
+	void WriteQuantizedFloat( float value, float minValue, float maxValue, unsigned int numBits );
+	void WriteAlignedBytes( const void* data, unsigned int numBytes );
+	void AlignToByte();
+	void Flush();
+	unsigned int GetNumBitsWritten() const { return m_numBitsWritten; }
+	unsigned int GetNumBytesWritten() const { return ( m_numBitsWritten + 7 ) >> 3; }
+	bool HasOverflowed() const { return m_hasOverflowed; }
+
+private:
+	void WriteScratchWord();
+	void WritePendingScratchBytes();
+
+	unsigned char*		m_buffer;
+	unsigned int		m_bufferSizeInBits;
+	unsigned int		m_numBitsWritten;
+	unsigned int		m_byteIndex;
+	unsigned long long	m_scratch;
+	unsigned int		m_numScratchBits;
+	bool				m_hasOverflowed;
+};
+
+
+//-----------------------------------------------------------------------------------------------
+inline void BitWriter::WriteBits( unsigned int value, unsigned int numBits )
+{
+	assert( numBits <= MAX_BITS_PER_WRITE );
+	if( m_hasOverflowed || m_numBitsWritten + numBits > m_bufferSizeInBits )
+	{
+		m_hasOverflowed = true;
+		return;
+	}
+
+	unsigned long long mask = ( 1ULL << numBits ) - 1;
+	m_scratch |= ( (unsigned long long) value & mask ) << m_numScratchBits;
+	m_numScratchBits += numBits;
+	m_numBitsWritten += numBits;
+
+	if( m_numScratchBits >= 32 )
+		WriteScratchWord();
+}
+
+
+//-----------------------------------------------------------------------------------------------
+inline void BitWriter::WriteScratchWord()
+{
+	unsigned int word = (unsigned int) m_scratch;
+	m_buffer[ m_byteIndex ] = (unsigned char) word;
+	m_buffer[ m_byteIndex + 1 ] = (unsigned char) ( word >> 8 );
+	m_buffer[ m_byteIndex + 2 ] = (unsigned char) ( word >> 16 );
+	m_buffer[ m_byteIndex + 3 ] = (unsigned char) ( word >> 24 );
+	m_byteIndex += 4;
+	m_scratch >>= 32;
+	m_numScratchBits -= 32;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+class BitReader
+{
+public:
+	BitReader( const void* buffer, unsigned int bufferSizeInBytes );
+	unsigned int ReadBits( unsigned int numBits );
+	bool ReadBool() { return ReadBits( 1 ) != 0; }
+	unsigned int ReadVarUInt();
+	int ReadVarInt() { return ZigZagDecode( ReadVarUInt() ); }
+	int ReadRangedInt( int minValue, int maxValue );
+	float ReadQuantizedFloat( float minValue, float maxValue, unsigned int numBits );
+	void ReadAlignedBytes( void* data_out, unsigned int numBytes );
+	void AlignToByte();
+	unsigned int GetNumBitsRead() const { return m_numBitsRead; }
+	unsigned int GetNumBitsRemaining() const { return m_bufferSizeInBits - m_numBitsRead; }
+	bool HasOverflowed() const { return m_hasOverflowed; }
+
+private:
+	void RefillScratch();
+
+	const unsigned char*	m_buffer;
+	unsigned int			m_bufferSizeInBytes;
+	unsigned int			m_bufferSizeInBits;
+	unsigned int			m_numBitsRead;
+	unsigned int			m_byteIndex;
+	unsigned long long		m_scratch;
+	unsigned int			m_numScratchBits;
+	bool					m_hasOverflowed;
+};
+
+
+//-----------------------------------------------------------------------------------------------
+inline unsigned int BitReader::ReadBits( unsigned int numBits )
+{
+	assert( numBits <= MAX_BITS_PER_WRITE );
+	if( m_hasOverflowed || m_numBitsRead + numBits > m_bufferSizeInBits )
+	{
+		m_hasOverflowed = true;
+		return 0;
+	}
+
+	if( m_numScratchBits < numBits )
+		RefillScratch();
+
+	unsigned long long mask = ( 1ULL << numBits ) - 1;
+	unsigned int value = (unsigned int) ( m_scratch & mask );
+	m_scratch >>= numBits;
+	m_numScratchBits -= numBits;
+	m_numBitsRead += numBits;
+	return value;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+inline void BitReader::RefillScratch()
+{
+	unsigned int numBytesLeft = m_bufferSizeInBytes - m_byteIndex;
+	unsigned int word = 0;
+	if( numBytesLeft >= 4 )
+	{
+		word = m_buffer[ m_byteIndex ] | ( m_buffer[ m_byteIndex + 1 ] << 8 ) | ( m_buffer[ m_byteIndex + 2 ] << 16 ) | ( (unsigned int) m_buffer[ m_byteIndex + 3 ] << 24 );
+		m_byteIndex += 4;
+		m_scratch |= (unsigned long long) word << m_numScratchBits;
+		m_numScratchBits += 32;
+		return;
+	}
+
+	for( unsigned int byteIndex = 0; byteIndex < numBytesLeft; ++byteIndex )
+		word |= (unsigned int) m_buffer[ m_byteIndex++ ] << ( byteIndex * 8 );
+
+	m_scratch |= (unsigned long long) word << m_numScratchBits;
+	m_numScratchBits += numBytesLeft * 8;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+struct BitStreamBenchmarkResults
+{
+	unsigned int	m_numRecords;
+	unsigned int	m_numBitsPerRecord;
+	unsigned int	m_numRawBytesPerRecord;
+	double			m_secondsWriting;
+	double			m_secondsReading;
+	bool			m_didRoundTripMatch;
+};
+
+
+//-----------------------------------------------------------------------------------------------
+BitStreamBenchmarkResults RunBitStreamBenchmark( unsigned int numRecords );
+
+
+#endif // include_BitStream
\ No newline at end of file
@@ -0,0 +1,400 @@
+#include "DeferredEventQueue.hpp"
+#include <string.h>
+#include "Time.hpp"
+#include "EventSystem.hpp"
+#include "MemoryManager.hpp"
+#include "NewMacroDef.hpp"
+
+
+//-----------------------------------------------------------------------------------------------
+//Records are a header and the payload right behind it, both rounded up to MEMORY_ALIGNMENT. A
+//record never wraps: the producer skips to the start of the buffer instead, leaving a padding
+//record with no dispatch function if there is room for a header, and nothing otherwise.
+struct DeferredEventRecordHeader
+{
+	void ( *m_dispatch )( void* payload, bool shouldFire );
+	unsigned int	m_typeIndex;
+	unsigned int	m_sizeInBytes;
+};
+
+const unsigned int DEFERRED_EVENT_HEADER_SIZE_IN_BYTES = ( sizeof( DeferredEventRecordHeader ) + MEMORY_ALIGNMENT - 1 ) & ~( MEMORY_ALIGNMENT - 1 );
+
+
+//-----------------------------------------------------------------------------------------------
+//The indices only ever count up and are masked into the buffer; the producer owns the write
+//index and the released flag, the consumer the read index, each side on its own cache line.
+struct DeferredEventRing
+{
+	volatile unsigned int	m_writeIndex;
+	unsigned int			m_pendingWriteIndex;
+	volatile bool			m_isReleased;
+	byte_t					m_writePadding[ CACHE_LINE_SIZE_IN_BYTES ];
+	volatile unsigned int	m_readIndex;
+	byte_t					m_readPadding[ CACHE_LINE_SIZE_IN_BYTES ];
+	byte_t*					m_buffer;
+};
+
+
+//-----------------------------------------------------------------------------------------------
+STATIC DeferredEventRing* volatile DeferredEventQueue::s_producerRings[ MAX_DEFERRED_EVENT_PRODUCER_THREADS ];
+STATIC volatile LONG DeferredEventQueue::s_numProducerRings = 0;
+STATIC volatile LONG DeferredEventQueue::s_numEventTypes = 0;
+STATIC volatile LONG DeferredEventQueue::s_numEventsDropped = 0;
+STATIC LONG DeferredEventQueue::s_numEventsDroppedAtLastDispatch = 0;
+STATIC unsigned int DeferredEventQueue::s_generation = 0;
+STATIC DeferredEventTypeStatistics DeferredEventQueue::s_typeStatistics[ MAX_DEFERRED_EVENT_TYPES ];
+STATIC DeferredEventFrameStatistics DeferredEventQueue::s_lastFrameStatistics;
+
+
+//-----------------------------------------------------------------------------------------------
+//A ring from before the last Startup has been freed, so the generation tells a thread to make a
+//new one.
+struct ThreadEventRingState
+{
+	DeferredEventRing*	m_ring;
+	unsigned int		m_generation;
+};
+
+static __declspec( thread ) ThreadEventRingState g_threadEventRingState = { nullptr, 0 };
+
+
+//-----------------------------------------------------------------------------------------------
+//Posting jobs may be on fibers that move between threads, so the thread's state is looked up by
+//a call that is never inlined rather than through an address the compiler may have kept.
+static __declspec( noinline ) ThreadEventRingState* GetThreadEventRingState()
+{
+	return &g_threadEventRingState;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+//Event types keep their indices and names across restarts; only the counts start over.
+STATIC void DeferredEventQueue::Startup()
+{
+	++s_generation;
+	s_numProducerRings = 0;
+	s_numEventsDropped = 0;
+	s_numEventsDroppedAtLastDispatch = 0;
+	memset( &s_lastFrameStatistics, 0, sizeof( s_lastFrameStatistics ) );
+	for( unsigned int typeIndex = 0; typeIndex < MAX_DEFERRED_EVENT_TYPES; ++typeIndex )
+	{
+		DeferredEventTypeStatistics& typeStatistics = s_typeStatistics[ typeIndex ];
+		typeStatistics.m_numPosted = 0;
+		typeStatistics.m_numDropped = 0;
+		typeStatistics.m_numDispatched = 0;
+		typeStatistics.m_numDispatchedLastFrame = 0;
+	}
+}
+
+
+//-----------------------------------------------------------------------------------------------
+//Events still queued are destroyed without being fired, since their subscribers may be gone.
+//Every other thread has to have stopped posting first.
+STATIC void DeferredEventQueue::Shutdown()
+{
+	for( unsigned int ringIndex = 0; ringIndex < MAX_DEFERRED_EVENT_PRODUCER_THREADS; ++ringIndex )
+	{
+		DeferredEventRing* ring = s_producerRings[ ringIndex ];
+		if( ring == nullptr )
+			continue;
+
+		DrainRing( ring, false );
+		s_producerRings[ ringIndex ] = nullptr;
+		DeleteRing( ring );
+	}
+
+	s_numProducerRings = 0;
+	++s_generation;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+//The params are deleted once the event has been fired, or straight away if it is dropped.
+STATIC bool DeferredEventQueue::PostNamedEvent( const std::string& eventName, NamedProperties* params )
+{
+	static volatile LONG s_namedEventTypeIndex = -1;
+	unsigned int typeIndex = ( s_namedEventTypeIndex >= 0 ) ? (unsigned int) s_namedEventTypeIndex : RegisterEventType( &s_namedEventTypeIndex, NAMED_DEFERRED_EVENT_TYPE_NAME );
+
+	DeferredEventRing* ring = nullptr;
+	void* payload = BeginRecord( typeIndex, &DispatchNamedEvent, sizeof( NamedEvent ), ring );
+	if( payload == nullptr )
+	{
+		delete params;
+		return false;
+	}
+
+	new ( payload ) NamedEvent( eventName, params );
+	CommitRecord( ring );
+	return true;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+STATIC void DeferredEventQueue::DispatchNamedEvent( void* payload, bool shouldFire )
+{
+	NamedEvent* event = static_cast< NamedEvent* >( payload );
+	if( shouldFire && event->m_params != nullptr )
+		EventSystem::FireEvent( event->m_eventName, *event->m_params );
+	else if( shouldFire )
+		EventSystem::FireEvent( event->m_eventName );
+
+	delete event->m_params;
+	event->~NamedEvent();
+}
+
+
+//-----------------------------------------------------------------------------------------------
+//Two threads can race to register the same type; the loser's index is never used and, without a
+//name, never reported. Types past the last index share it.
+STATIC unsigned int DeferredEventQueue::RegisterEventType( volatile LONG* typeIndex, const char* typeName )
+{
+	LONG newTypeIndex = InterlockedIncrement( &s_numEventTypes ) - 1;
+	if( newTypeIndex >= (LONG) MAX_DEFERRED_EVENT_TYPES )
+		newTypeIndex = MAX_DEFERRED_EVENT_TYPES - 1;
+
+	LONG registeredTypeIndex = InterlockedCompareExchange( typeIndex, newTypeIndex, -1 );
+	if( registeredTypeIndex >= 0 )
+		return (unsigned int) registeredTypeIndex;
+
+	if( s_typeStatistics[ newTypeIndex ].m_name == nullptr )
+		s_typeStatistics[ newTypeIndex ].m_name = typeName;
+
+	return (unsigned int) newTypeIndex;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+STATIC unsigned int DeferredEventQueue::GetNumEventTypes()
+{
+	return ( s_numEventTypes < (LONG) MAX_DEFERRED_EVENT_TYPES ) ? (unsigned int) s_numEventTypes : MAX_DEFERRED_EVENT_TYPES;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+//Only the first post from a thread gets here, to claim an empty slot in the producer list. Slots
+//are only ever emptied by the dispatching thread, once a released ring has been drained. While
+//every slot is taken the thread keeps looking on each post, dropping its events until one frees.
+STATIC DeferredEventRing* DeferredEventQueue::GetThreadRing()
+{
+	ThreadEventRingState* threadState = GetThreadEventRingState();
+	if( threadState->m_ring != nullptr && threadState->m_generation == s_generation )
+		return threadState->m_ring;
+
+	threadState->m_ring = nullptr;
+	threadState->m_generation = s_generation;
+
+	DeferredEventRing* ring = nullptr;
+	for( unsigned int ringIndex = 0; ringIndex < MAX_DEFERRED_EVENT_PRODUCER_THREADS; ++ringIndex )
+	{
+		if( s_producerRings[ ringIndex ] != nullptr )
+			continue;
+
+		if( ring == nullptr )
+			ring = CreateRing();
+
+		// the interlocked exchange also makes the ring complete before the dispatching thread can find it
+		if( InterlockedCompareExchangePointer( (void* volatile*) &s_producerRings[ ringIndex ], ring, nullptr ) != nullptr )
+			continue;
+
+		RaiseNumProducerRings( (LONG) ringIndex + 1 );
+		threadState->m_ring = ring;
+		return ring;
+	}
+
+	if( ring != nullptr )
+		DeleteRing( ring );
+
+	return nullptr;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+STATIC DeferredEventRing* DeferredEventQueue::CreateRing()
+{
+	DeferredEventRing* ring = new DeferredEventRing;
+	ring->m_writeIndex = 0;
+	ring->m_pendingWriteIndex = 0;
+	ring->m_isReleased = false;
+	ring->m_readIndex = 0;
+	ring->m_buffer = new byte_t[ DEFERRED_EVENT_RING_SIZE_IN_BYTES ];
+	return ring;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+STATIC void DeferredEventQueue::DeleteRing( DeferredEventRing* ring )
+{
+	delete[] ring->m_buffer;
+	delete ring;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+//The count is only a high water mark over the slots, so the dispatching thread knows how far to
+//look; it never goes down until Startup.
+STATIC void DeferredEventQueue::RaiseNumProducerRings( LONG numProducerRings )
+{
+	LONG oldNumProducerRings = s_numProducerRings;
+	while( oldNumProducerRings < numProducerRings )
+	{
+		LONG seenNumProducerRings = InterlockedCompareExchange( &s_numProducerRings, numProducerRings, oldNumProducerRings );
+		if( seenNumProducerRings == oldNumProducerRings )
+			break;
+
+		oldNumProducerRings = seenNumProducerRings;
+	}
+}
+
+
+//-----------------------------------------------------------------------------------------------
+//Events the thread has already posted are still dispatched. A ring from before the last Startup
+//has been freed already, so only the thread's own pointer is cleared then.
+STATIC void DeferredEventQueue::ReleaseThreadRing()
+{
+	ThreadEventRingState* threadState = GetThreadEventRingState();
+	DeferredEventRing* ring = threadState->m_ring;
+	threadState->m_ring = nullptr;
+	if( ring == nullptr || threadState->m_generation != s_generation )
+		return;
+
+	// every record is committed already; after this the ring belongs to the dispatching thread
+	_WriteBarrier();
+	ring->m_isReleased = true;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+//Writes the header and hands back where the payload goes. Nothing is visible to the dispatching
+//thread until CommitRecord.
+STATIC void* DeferredEventQueue::BeginRecord( unsigned int typeIndex, DispatchFunc dispatch, size_t payloadSizeInBytes, DeferredEventRing*& ring_out )
+{
+	InterlockedIncrement( &s_typeStatistics[ typeIndex ].m_numPosted );
+
+	DeferredEventRing* ring = GetThreadRing();
+	unsigned int recordSizeInBytes = DEFERRED_EVENT_HEADER_SIZE_IN_BYTES + (unsigned int) ( ( payloadSizeInBytes + MEMORY_ALIGNMENT - 1 ) & ~( MEMORY_ALIGNMENT - 1 ) );
+	if( ring == nullptr || recordSizeInBytes > DEFERRED_EVENT_RING_SIZE_IN_BYTES / 2 )
+	{
+		InterlockedIncrement( &s_typeStatistics[ typeIndex ].m_numDropped );
+		InterlockedIncrement( &s_numEventsDropped );
+		return nullptr;
+	}
+
+	unsigned int writeIndex = ring->m_writeIndex;
+	unsigned int numBytesUsed = writeIndex - ring->m_readIndex;
+	unsigned int writeOffset = writeIndex & ( DEFERRED_EVENT_RING_SIZE_IN_BYTES - 1 );
+	unsigned int numPaddingBytes = ( writeOffset + recordSizeInBytes > DEFERRED_EVENT_RING_SIZE_IN_BYTES ) ? DEFERRED_EVENT_RING_SIZE_IN_BYTES - writeOffset : 0;
+	if( numBytesUsed + numPaddingBytes + recordSizeInBytes > DEFERRED_EVENT_RING_SIZE_IN_BYTES )
+	{
+		InterlockedIncrement( &s_typeStatistics[ typeIndex ].m_numDropped );
+		InterlockedIncrement( &s_numEventsDropped );
+		return nullptr;
+	}
+
+	if( numPaddingBytes > 0 )
+	{
+		if( numPaddingBytes >= DEFERRED_EVENT_HEADER_SIZE_IN_BYTES )
+		{
+			DeferredEventRecordHeader* paddingHeader = reinterpret_cast< DeferredEventRecordHeader* >( ring->m_buffer + writeOffset );
+			paddingHeader->m_dispatch = nullptr;
+			paddingHeader->m_typeIndex = typeIndex;
+			paddingHeader->m_sizeInBytes = numPaddingBytes;
+		}
+
+		writeIndex += numPaddingBytes;
+		writeOffset = 0;
+	}
+
+	DeferredEventRecordHeader* header = reinterpret_cast< DeferredEventRecordHeader* >( ring->m_buffer + writeOffset );
+	header->m_dispatch = dispatch;
+	header->m_typeIndex = typeIndex;
+	header->m_sizeInBytes = recordSizeInBytes;
+
+	ring->m_pendingWriteIndex = writeIndex + recordSizeInBytes;
+	ring_out = ring;
+	return ring->m_buffer + writeOffset + DEFERRED_EVENT_HEADER_SIZE_IN_BYTES;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+STATIC void DeferredEventQueue::CommitRecord( DeferredEventRing* ring )
+{
+	// the record has to be visible before the write index that publishes it
+	_WriteBarrier();
+	ring->m_writeIndex = ring->m_pendingWriteIndex;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+//Stops at the write index seen on the way in, so events posted by the handlers wait their turn.
+STATIC void DeferredEventQueue::DrainRing( DeferredEventRing* ring, bool shouldFire )
+{
+	unsigned int writeIndex = ring->m_writeIndex;
+	unsigned int readIndex = ring->m_readIndex;
+	while( readIndex != writeIndex )
+	{
+		unsigned int readOffset = readIndex & ( DEFERRED_EVENT_RING_SIZE_IN_BYTES - 1 );
+		if( DEFERRED_EVENT_RING_SIZE_IN_BYTES - readOffset < DEFERRED_EVENT_HEADER_SIZE_IN_BYTES )
+		{
+			readIndex += DEFERRED_EVENT_RING_SIZE_IN_BYTES - readOffset;
+			continue;
+		}
+
+		DeferredEventRecordHeader* header = reinterpret_cast< DeferredEventRecordHeader* >( ring->m_buffer + readOffset );
+		unsigned int recordSizeInBytes = header->m_sizeInBytes;
+		if( header->m_dispatch != nullptr )
+		{
+			header->m_dispatch( ring->m_buffer + readOffset + DEFERRED_EVENT_HEADER_SIZE_IN_BYTES, shouldFire );
+			if( shouldFire )
+			{
+				DeferredEventTypeStatistics& typeStatistics = s_typeStatistics[ header->m_typeIndex ];
+				++typeStatistics.m_numDispatched;
+				++typeStatistics.m_numDispatchedLastFrame;
+				++s_lastFrameStatistics.m_numDispatched;
+			}
+		}
+
+		readIndex += recordSizeInBytes;
+	}
+
+	// the records have to be finished with before the producer may write over them
+	MemoryBarrier();
+	ring->m_readIndex = readIndex;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+//Call once a frame, always from the same thread; the frame statistics cover one call.
+STATIC void DeferredEventQueue::DispatchEvents()
+{
+	double secondsAtStart = GetCurrentTimeSeconds();
+	s_lastFrameStatistics.m_numDispatched = 0;
+	for( unsigned int typeIndex = 0; typeIndex < MAX_DEFERRED_EVENT_TYPES; ++typeIndex )
+		s_typeStatistics[ typeIndex ].m_numDispatchedLastFrame = 0;
+
+	unsigned int numProducerThreads = 0;
+	LONG numProducerRings = s_numProducerRings;
+	for( LONG ringIndex = 0; ringIndex < numProducerRings; ++ringIndex )
+	{
+		DeferredEventRing* ring = s_producerRings[ ringIndex ];
+		if( ring == nullptr )
+			continue;
+
+		// read before draining, so that a released ring is only freed once its last events are out
+		bool wasReleased = ring->m_isReleased;
+		DrainRing( ring, true );
+		if( !wasReleased )
+		{
+			++numProducerThreads;
+			continue;
+		}
+
+		s_producerRings[ ringIndex ] = nullptr;
+		DeleteRing( ring );
+	}
+
+	LONG numEventsDropped = s_numEventsDropped;
+	s_lastFrameStatistics.m_numDropped = (unsigned int) ( numEventsDropped - s_numEventsDroppedAtLastDispatch );
+	s_numEventsDroppedAtLastDispatch = numEventsDropped;
+	s_lastFrameStatistics.m_numProducerThreads = numProducerThreads;
+	s_lastFrameStatistics.m_secondsDispatching = GetCurrentTimeSeconds() - secondsAtStart;
+}
\ No newline at end of file
@@ -0,0 +1,161 @@
+#ifndef include_DeferredEventQueue
+#define include_DeferredEventQueue
+#pragma once
+
+//-----------------------------------------------------------------------------------------------
+#include <new>
+#include <string>
+#include <typeinfo>
+#include <windows.h>
+#include "EventChannel.hpp"
+#include "EngineCommon.hpp"
+#include "NamedProperties.hpp"
+
+
+//-----------------------------------------------------------------------------------------------
+const unsigned int DEFERRED_EVENT_RING_SIZE_IN_BYTES = 64 * 1024;
+const unsigned int MAX_DEFERRED_EVENT_PRODUCER_THREADS = 64;
+const unsigned int MAX_DEFERRED_EVENT_TYPES = 64;
+const char* const NAMED_DEFERRED_EVENT_TYPE_NAME = "EventSystem";
+
+
+//-----------------------------------------------------------------------------------------------
+struct DeferredEventRing;
+
+
+//-----------------------------------------------------------------------------------------------
+//Posted and dropped counts are bumped by any thread; the rest only by the dispatching thread.
+struct DeferredEventTypeStatistics
+{
+	const char*		m_name;
+	volatile LONG	m_numPosted;
+	volatile LONG	m_numDropped;
+	LONG			m_numDispatched;
+	LONG			m_numDispatchedLastFrame;
+};
+
+
+//-----------------------------------------------------------------------------------------------
+struct DeferredEventFrameStatistics
+{
+	unsigned int	m_numDispatched;
+	unsigned int	m_numDropped;
+	unsigned int	m_numProducerThreads;
+	double			m_secondsDispatching;
+};
+
+
+//-----------------------------------------------------------------------------------------------
+//Lets any thread fire events that EventChannels and the EventSystem, which are main thread only,
+//deliver later on the thread that calls DispatchEvents. Each posting thread copies its events
+//into a single producer, single consumer ring of its own, created the first time it posts, so
+//posting never takes a lock or waits for the consumer; a full ring drops the event and counts
+//it. Threads that post hand their ring back with ReleaseThreadRing before they exit, which frees
+//the slot for another thread once its last events have been dispatched. Events keep the order
+//they were posted in per OS thread, not per job: a job on a fiber that moves threads between
+//posts can see its events delivered out of order, and there is no order between threads.
+//NamedProperties can not be copied, so a named event takes ownership of params made with new.
+//Events posted while dispatching wait for the next DispatchEvents. Payloads are copied with
+//their copy constructor and may need no more than MEMORY_ALIGNMENT alignment.
+class DeferredEventQueue
+{
+	typedef void ( *DispatchFunc )( void* payload, bool shouldFire );
+
+public:
+	static void Startup();
+	static void Shutdown();
+	template< typename T_Event >
+		static bool Post( const T_Event& event );
+	static bool PostNamedEvent( const std::string& eventName, NamedProperties* params = nullptr );
+	static void DispatchEvents();
+	static void ReleaseThreadRing();
+	static unsigned int GetNumEventTypes();
+	static const DeferredEventTypeStatistics& GetEventTypeStatistics( unsigned int typeIndex ) { return s_typeStatistics[ typeIndex ]; }
+	static const DeferredEventFrameStatistics& GetLastFrameStatistics() { return s_lastFrameStatistics; }
+
+private:
+	struct NamedEvent
+	{
+		NamedEvent( const std::string& eventName, NamedProperties* params ) : m_eventName( eventName ), m_params( params ) {}
+
+		std::string			m_eventName;
+		NamedProperties*	m_params;
+	};
+
+	template< typename T_Event >
+	struct EventTypeIndex
+	{
+		static volatile LONG	s_typeIndex;
+	};
+
+	template< typename T_Event >
+		static void DispatchTypedEvent( void* payload, bool shouldFire );
+	static void DispatchNamedEvent( void* payload, bool shouldFire );
+	template< typename T_Event >
+		static unsigned int GetEventTypeIndex();
+	static unsigned int RegisterEventType( volatile LONG* typeIndex, const char* typeName );
+	static void* BeginRecord( unsigned int typeIndex, DispatchFunc dispatch, size_t payloadSizeInBytes, DeferredEventRing*& ring_out );
+	static void CommitRecord( DeferredEventRing* ring );
+	static DeferredEventRing* GetThreadRing();
+	static DeferredEventRing* CreateRing();
+	static void DeleteRing( DeferredEventRing* ring );
+	static void RaiseNumProducerRings( LONG numProducerRings );
+	static void DrainRing( DeferredEventRing* ring, bool shouldFire );
+
+	static DeferredEventRing* volatile		s_producerRings[ MAX_DEFERRED_EVENT_PRODUCER_THREADS ];
+	static volatile LONG					s_numProducerRings;
+	static volatile LONG					s_numEventTypes;
+	static volatile LONG					s_numEventsDropped;
+	static LONG								s_numEventsDroppedAtLastDispatch;
+	static unsigned int						s_generation;
+	static DeferredEventTypeStatistics		s_typeStatistics[ MAX_DEFERRED_EVENT_TYPES ];
+	static DeferredEventFrameStatistics		s_lastFrameStatistics;
+};
+
+
+//-----------------------------------------------------------------------------------------------
+template< typename T_Event >
+STATIC volatile LONG DeferredEventQueue::EventTypeIndex< T_Event >::s_typeIndex = -1;
+
+
+//-----------------------------------------------------------------------------------------------
+template< typename T_Event >
+inline STATIC bool DeferredEventQueue::Post( const T_Event& event )
+{
+	DeferredEventRing* ring = nullptr;
+	void* payload = BeginRecord( GetEventTypeIndex< T_Event >(), &DispatchTypedEvent< T_Event >, sizeof( T_Event ), ring );
+	if( payload == nullptr )
+		return false;
+
+	new ( payload ) T_Event( event );
+	CommitRecord( ring );
+	return true;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+//Also called without firing to throw away events still queued at shutdown.
+template< typename T_Event >
+inline STATIC void DeferredEventQueue::DispatchTypedEvent( void* payload, bool shouldFire )
+{
+	T_Event* event = static_cast< T_Event* >( payload );
+	if( shouldFire )
+		EventChannel< T_Event >::Fire( *event );
+
+	event->~T_Event();
+}
+
+
+//-----------------------------------------------------------------------------------------------
+template< typename T_Event >
+inline STATIC unsigned int DeferredEventQueue::GetEventTypeIndex()
+{
+	LONG typeIndex = EventTypeIndex< T_Event >::s_typeIndex;
+	if( typeIndex >= 0 )
+		return (unsigned int) typeIndex;
+
+	return RegisterEventType( &EventTypeIndex< T_Event >::s_typeIndex, typeid( T_Event ).name() );
+}
+
+
+#endif // include_DeferredEventQueue
\ No newline at end of file
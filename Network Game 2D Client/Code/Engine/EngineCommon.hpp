@@ -13,6 +13,7 @@ typedef unsigned char byte_t;
 //-----------------------------------------------------------------------------------------------
 const int NUM_VIRTUAL_KEYS = 256;
 const int NUM_KEYBOARD_CHARS = 256;
+const unsigned int CACHE_LINE_SIZE_IN_BYTES = 64;
 
 
 //-----------------------------------------------------------------------------------------------
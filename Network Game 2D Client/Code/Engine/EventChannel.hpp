@@ -0,0 +1,219 @@
+#ifndef include_EventChannel
+#define include_EventChannel
+#pragma once
+
+//-----------------------------------------------------------------------------------------------
+#include <vector>
+#include "EngineCommon.hpp"
+
+
+//-----------------------------------------------------------------------------------------------
+const unsigned int INVALID_EVENT_CHANNEL_INDEX = 0xffffffff;
+
+
+//-----------------------------------------------------------------------------------------------
+//Names one subscription to one channel. A handle left over after its subscription is gone is
+//recognised by its generation, so unsubscribing it twice does nothing.
+struct EventChannelHandle
+{
+	EventChannelHandle() : m_slotIndex( INVALID_EVENT_CHANNEL_INDEX ), m_generation( 0 ) {}
+	bool IsValid() const { return m_slotIndex != INVALID_EVENT_CHANNEL_INDEX; }
+
+	unsigned int	m_slotIndex;
+	unsigned int	m_generation;
+};
+
+
+//-----------------------------------------------------------------------------------------------
+//A channel per event struct type, for events fired often enough that EventSystem's string lookup
+//and NamedProperties are too slow. Subscribers sit in one contiguous array of delegates, each an
+//object pointer and a stub that calls the member function it was instantiated for, so firing is
+//a loop of direct calls with no allocation. Unsubscribing swaps the last delegate into the hole;
+//during a fire it only blanks the delegate and the array is compacted when the fire ends.
+//Subscribers added during a fire miss that event. Main thread only, like EventSystem.
+template< typename T_Event >
+class EventChannel
+{
+	typedef void ( *StubFunc )( void* object, const T_Event& event );
+
+public:
+	template< typename T_SubscriberType, void ( T_SubscriberType::*T_Function )( const T_Event& ) >
+		static EventChannelHandle Subscribe( T_SubscriberType* subscriber );
+	template< void ( *T_Function )( const T_Event& ) >
+		static EventChannelHandle SubscribeFunction();
+	static void Unsubscribe( EventChannelHandle& handle );
+	static void Fire( const T_Event& event );
+	static unsigned int GetNumSubscribers() { return (unsigned int) s_delegates.size() - s_numBlankedDelegates; }
+
+private:
+	struct Delegate
+	{
+		void*			m_object;
+		StubFunc		m_stub;
+		unsigned int	m_slotIndex;
+	};
+
+	struct Slot
+	{
+		unsigned int	m_delegateIndex;
+		unsigned int	m_generation;
+	};
+
+	template< typename T_SubscriberType, void ( T_SubscriberType::*T_Function )( const T_Event& ) >
+		static void CallMemberFunction( void* object, const T_Event& event ) { ( static_cast< T_SubscriberType* >( object )->*T_Function )( event ); }
+	template< void ( *T_Function )( const T_Event& ) >
+		static void CallFunction( void*, const T_Event& event ) { T_Function( event ); }
+	static EventChannelHandle AddDelegate( void* object, StubFunc stub );
+	static void RemoveDelegate( unsigned int delegateIndex );
+
+	static std::vector< Delegate >		s_delegates;
+	static std::vector< Slot >			s_slots;
+	static std::vector< unsigned int >	s_freeSlotIndices;
+	static unsigned int					s_fireDepth;
+	static unsigned int					s_numBlankedDelegates;
+};
+
+
+//-----------------------------------------------------------------------------------------------
+template< typename T_Event >
+STATIC std::vector< typename EventChannel< T_Event >::Delegate > EventChannel< T_Event >::s_delegates;
+
+template< typename T_Event >
+STATIC std::vector< typename EventChannel< T_Event >::Slot > EventChannel< T_Event >::s_slots;
+
+template< typename T_Event >
+STATIC std::vector< unsigned int > EventChannel< T_Event >::s_freeSlotIndices;
+
+template< typename T_Event >
+STATIC unsigned int EventChannel< T_Event >::s_fireDepth = 0;
+
+template< typename T_Event >
+STATIC unsigned int EventChannel< T_Event >::s_numBlankedDelegates = 0;
+
+
+//-----------------------------------------------------------------------------------------------
+template< typename T_Event >
+template< typename T_SubscriberType, void ( T_SubscriberType::*T_Function )( const T_Event& ) >
+inline STATIC EventChannelHandle EventChannel< T_Event >::Subscribe( T_SubscriberType* subscriber )
+{
+	return AddDelegate( subscriber, &CallMemberFunction< T_SubscriberType, T_Function > );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+template< typename T_Event >
+template< void ( *T_Function )( const T_Event& ) >
+inline STATIC EventChannelHandle EventChannel< T_Event >::SubscribeFunction()
+{
+	return AddDelegate( nullptr, &CallFunction< T_Function > );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+template< typename T_Event >
+inline STATIC EventChannelHandle EventChannel< T_Event >::AddDelegate( void* object, StubFunc stub )
+{
+	unsigned int slotIndex = 0;
+	if( !s_freeSlotIndices.empty() )
+	{
+		slotIndex = s_freeSlotIndices.back();
+		s_freeSlotIndices.pop_back();
+	}
+	else
+	{
+		slotIndex = (unsigned int) s_slots.size();
+		Slot newSlot;
+		newSlot.m_generation = 0;
+		s_slots.push_back( newSlot );
+	}
+
+	Delegate newDelegate;
+	newDelegate.m_object = object;
+	newDelegate.m_stub = stub;
+	newDelegate.m_slotIndex = slotIndex;
+	s_slots[ slotIndex ].m_delegateIndex = (unsigned int) s_delegates.size();
+	s_delegates.push_back( newDelegate );
+
+	EventChannelHandle handle;
+	handle.m_slotIndex = slotIndex;
+	handle.m_generation = s_slots[ slotIndex ].m_generation;
+	return handle;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+//The slot is freed straight away even while firing; its blanked delegate no longer points back
+//at it once the generation has moved on.
+template< typename T_Event >
+inline STATIC void EventChannel< T_Event >::Unsubscribe( EventChannelHandle& handle )
+{
+	if( handle.m_slotIndex >= s_slots.size() || s_slots[ handle.m_slotIndex ].m_generation != handle.m_generation )
+	{
+		handle = EventChannelHandle();
+		return;
+	}
+
+	Slot& slot = s_slots[ handle.m_slotIndex ];
+	unsigned int delegateIndex = slot.m_delegateIndex;
+	++slot.m_generation;
+	slot.m_delegateIndex = INVALID_EVENT_CHANNEL_INDEX;
+	s_freeSlotIndices.push_back( handle.m_slotIndex );
+	handle = EventChannelHandle();
+
+	if( s_fireDepth > 0 )
+	{
+		s_delegates[ delegateIndex ].m_stub = nullptr;
+		++s_numBlankedDelegates;
+	}
+	else
+	{
+		RemoveDelegate( delegateIndex );
+	}
+}
+
+
+//-----------------------------------------------------------------------------------------------
+template< typename T_Event >
+inline STATIC void EventChannel< T_Event >::RemoveDelegate( unsigned int delegateIndex )
+{
+	unsigned int lastDelegateIndex = (unsigned int) s_delegates.size() - 1;
+	if( delegateIndex != lastDelegateIndex )
+	{
+		s_delegates[ delegateIndex ] = s_delegates[ lastDelegateIndex ];
+		s_slots[ s_delegates[ delegateIndex ].m_slotIndex ].m_delegateIndex = delegateIndex;
+	}
+
+	s_delegates.pop_back();
+}
+
+
+//-----------------------------------------------------------------------------------------------
+//Compacting walks backwards so every delegate swapped into a hole has already been checked.
+template< typename T_Event >
+inline STATIC void EventChannel< T_Event >::Fire( const T_Event& event )
+{
+	++s_fireDepth;
+	unsigned int numDelegates = (unsigned int) s_delegates.size();
+	for( unsigned int delegateIndex = 0; delegateIndex < numDelegates; ++delegateIndex )
+	{
+		void* object = s_delegates[ delegateIndex ].m_object;
+		StubFunc stub = s_delegates[ delegateIndex ].m_stub;
+		if( stub != nullptr )
+			stub( object, event );
+	}
+	--s_fireDepth;
+
+	if( s_fireDepth > 0 || s_numBlankedDelegates == 0 )
+		return;
+
+	for( unsigned int delegateIndex = (unsigned int) s_delegates.size(); delegateIndex > 0; --delegateIndex )
+	{
+		if( s_delegates[ delegateIndex - 1 ].m_stub == nullptr )
+			RemoveDelegate( delegateIndex - 1 );
+	}
+
+	s_numBlankedDelegates = 0;
+}
+
+
+#endif // include_EventChannel
\ No newline at end of file
@@ -1,4 +1,5 @@
 #include "EventSystem.hpp"
+#include "LinearArena.hpp"
 #include "NewMacroDef.hpp"
 
 
@@ -32,11 +33,16 @@ STATIC void EventSystem::FireEvent( const std::string& eventToFire )
 	if( mapIter == s_subscribers.end() )
 		return;
 
-	std::vector<EventSubscriberBase*> subscriberVec = mapIter->second;
+	// subscribers may unregister while the event is firing, so iterate over a copy on the scratch stack
+	LinearArena& scratchStack = FrameAllocator::GetScratchStack();
+	ScopedArenaMarker scratchMarker( scratchStack );
+	const std::vector< EventSubscriberBase* >& subscribers = mapIter->second;
+	ArenaVector< EventSubscriberBase* >::Type subscriberVec( subscribers.begin(), subscribers.end(), ArenaAllocator< EventSubscriberBase* >( scratchStack ) );
+	NamedProperties noParams;
 	for( unsigned int subscriberIndex = 0; subscriberIndex < subscriberVec.size(); ++subscriberIndex )
 	{
 		EventSubscriberBase* subscriber = subscriberVec[ subscriberIndex ];
-		subscriber->CallCallbackFunction( NamedProperties() );
+		subscriber->CallCallbackFunction( noParams );
 	}
 }
 
@@ -48,7 +54,11 @@ STATIC void EventSystem::FireEvent( const std::string& eventToFire, const NamedP
 	if( mapIter == s_subscribers.end() )
 		return;
 
-	std::vector<EventSubscriberBase*> subscriberVec = mapIter->second;
+	// subscribers may unregister while the event is firing, so iterate over a copy on the scratch stack
+	LinearArena& scratchStack = FrameAllocator::GetScratchStack();
+	ScopedArenaMarker scratchMarker( scratchStack );
+	const std::vector< EventSubscriberBase* >& subscribers = mapIter->second;
+	ArenaVector< EventSubscriberBase* >::Type subscriberVec( subscribers.begin(), subscribers.end(), ArenaAllocator< EventSubscriberBase* >( scratchStack ) );
 	for( unsigned int subscriberIndex = 0; subscriberIndex < subscriberVec.size(); ++subscriberIndex )
 	{
 		EventSubscriberBase* subscriber = subscriberVec[ subscriberIndex ];
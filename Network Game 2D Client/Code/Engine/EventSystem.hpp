@@ -6,6 +6,7 @@
 #include <map>
 #include <vector>
 #include "EngineCommon.hpp"
+#include "ObjectPool.hpp"
 #include "NamedProperties.hpp"
 
 
@@ -13,13 +14,14 @@
 class EventSubscriberBase
 {
 public:
+	virtual ~EventSubscriberBase() {}
 	virtual void CallCallbackFunction( const NamedProperties& ) {}
 };
 
 
 //-----------------------------------------------------------------------------------------------
 template< class T_SubscriberType >
-class TypedEventSubscription : public EventSubscriberBase
+class TypedEventSubscription : public EventSubscriberBase, public PooledObject< TypedEventSubscription< T_SubscriberType > >
 {
 	typedef void ( T_SubscriberType::*ObjectMemberFunctionType )( const NamedProperties& params );
 
@@ -41,6 +43,9 @@ inline void TypedEventSubscription<T_SubscriberType>::CallCallbackFunction( cons
 
 
 //-----------------------------------------------------------------------------------------------
+//Events by name, for the console and data driven scripting. Anything fired per frame or per
+//packet should be a struct type on an EventChannel instead. Main thread only; other threads post
+//through the DeferredEventQueue.
 class EventSystem
 {
 public:
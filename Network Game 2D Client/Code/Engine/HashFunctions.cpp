@@ -0,0 +1,343 @@
+#include "HashFunctions.hpp"
+#include <string.h>
+#include <assert.h>
+#include <vector>
+#include <intrin.h>
+#include <nmmintrin.h>
+#include "Time.hpp"
+#include "ParallelFor.hpp"
+#include "NewMacroDef.hpp"
+
+
+//-----------------------------------------------------------------------------------------------
+const unsigned long long XXHASH64_PRIME_1 = 0x9E3779B185EBCA87ULL;
+const unsigned long long XXHASH64_PRIME_2 = 0xC2B2AE3D27D4EB4FULL;
+const unsigned long long XXHASH64_PRIME_3 = 0x165667B19E3779F9ULL;
+const unsigned long long XXHASH64_PRIME_4 = 0x85EBCA77C2B2AE63ULL;
+const unsigned long long XXHASH64_PRIME_5 = 0x27D4EB2F165667C5ULL;
+const unsigned int CRC32C_POLYNOMIAL = 0x82F63B78;
+const int CPUID_ECX_SSE42_BIT = 1 << 20;
+
+
+//-----------------------------------------------------------------------------------------------
+//Built before main runs, so no thread ever sees it half filled.
+struct CRC32CTable
+{
+	CRC32CTable()
+	{
+		for( unsigned int byteValue = 0; byteValue < 256; ++byteValue )
+		{
+			unsigned int crc = byteValue;
+			for( int bitIndex = 0; bitIndex < 8; ++bitIndex )
+				crc = ( crc & 1 ) ? ( crc >> 1 ) ^ CRC32C_POLYNOMIAL : ( crc >> 1 );
+
+			m_entries[ byteValue ] = crc;
+		}
+	}
+
+	unsigned int	m_entries[ 256 ];
+};
+
+
+//-----------------------------------------------------------------------------------------------
+static bool DetectSSE42Support()
+{
+	int cpuInfo[ 4 ];
+	__cpuid( cpuInfo, 1 );
+	return ( cpuInfo[ 2 ] & CPUID_ECX_SSE42_BIT ) != 0;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+static const CRC32CTable s_crc32cTable;
+static const bool s_isSSE42Supported = DetectSSE42Support();
+
+
+//-----------------------------------------------------------------------------------------------
+bool IsSSE42Supported()
+{
+	return s_isSSE42Supported;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+//Kept byte for byte the same as the hash HashBufferJob has always produced, sign extended chars
+//included, so hashes saved before still match.
+unsigned int ComputeLegacyHash( const byte_t* data, size_t numBytes )
+{
+	unsigned int hashValue = 0;
+	for( size_t byteIndex = 0; byteIndex < numBytes; ++byteIndex )
+	{
+		hashValue &= 0x07ffffff;
+		hashValue *= 31;
+		hashValue += static_cast< char >( data[ byteIndex ] );
+	}
+
+	return hashValue;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+static inline unsigned long long RotateLeft64( unsigned long long value, int numBits )
+{
+	return ( value << numBits ) | ( value >> ( 64 - numBits ) );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+static inline unsigned long long Read64( const byte_t* data )
+{
+	unsigned long long value;
+	memcpy( &value, data, sizeof( value ) );
+	return value;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+static inline unsigned int Read32( const byte_t* data )
+{
+	unsigned int value;
+	memcpy( &value, data, sizeof( value ) );
+	return value;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+static inline unsigned long long XXHash64Round( unsigned long long accumulator, unsigned long long input )
+{
+	accumulator += input * XXHASH64_PRIME_2;
+	accumulator = RotateLeft64( accumulator, 31 );
+	return accumulator * XXHASH64_PRIME_1;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+static inline unsigned long long XXHash64MergeRound( unsigned long long hashValue, unsigned long long accumulator )
+{
+	hashValue ^= XXHash64Round( 0, accumulator );
+	return hashValue * XXHASH64_PRIME_1 + XXHASH64_PRIME_4;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+//The reference XXH64: four independent lanes over each 32 byte stripe keep the multipliers busy,
+//then the tail is folded in 8, 4 and 1 bytes at a time. Assumes a little endian CPU.
+unsigned long long ComputeXXHash64( const byte_t* data, size_t numBytes, unsigned long long seed )
+{
+	const byte_t* dataEnd = data + numBytes;
+	unsigned long long hashValue = 0;
+
+	if( numBytes >= 32 )
+	{
+		const byte_t* lastStripe = dataEnd - 32;
+		unsigned long long lane1 = seed + XXHASH64_PRIME_1 + XXHASH64_PRIME_2;
+		unsigned long long lane2 = seed + XXHASH64_PRIME_2;
+		unsigned long long lane3 = seed;
+		unsigned long long lane4 = seed - XXHASH64_PRIME_1;
+		do
+		{
+			lane1 = XXHash64Round( lane1, Read64( data ) );
+			lane2 = XXHash64Round( lane2, Read64( data + 8 ) );
+			lane3 = XXHash64Round( lane3, Read64( data + 16 ) );
+			lane4 = XXHash64Round( lane4, Read64( data + 24 ) );
+			data += 32;
+		}
+		while( data <= lastStripe );
+
+		hashValue = RotateLeft64( lane1, 1 ) + RotateLeft64( lane2, 7 ) + RotateLeft64( lane3, 12 ) + RotateLeft64( lane4, 18 );
+		hashValue = XXHash64MergeRound( hashValue, lane1 );
+		hashValue = XXHash64MergeRound( hashValue, lane2 );
+		hashValue = XXHash64MergeRound( hashValue, lane3 );
+		hashValue = XXHash64MergeRound( hashValue, lane4 );
+	}
+	else
+	{
+		hashValue = seed + XXHASH64_PRIME_5;
+	}
+
+	hashValue += (unsigned long long) numBytes;
+
+	for( ; data + 8 <= dataEnd; data += 8 )
+	{
+		hashValue ^= XXHash64Round( 0, Read64( data ) );
+		hashValue = RotateLeft64( hashValue, 27 ) * XXHASH64_PRIME_1 + XXHASH64_PRIME_4;
+	}
+
+	if( data + 4 <= dataEnd )
+	{
+		hashValue ^= (unsigned long long) Read32( data ) * XXHASH64_PRIME_1;
+		hashValue = RotateLeft64( hashValue, 23 ) * XXHASH64_PRIME_2 + XXHASH64_PRIME_3;
+		data += 4;
+	}
+
+	for( ; data < dataEnd; ++data )
+	{
+		hashValue ^= (unsigned long long) *data * XXHASH64_PRIME_5;
+		hashValue = RotateLeft64( hashValue, 11 ) * XXHASH64_PRIME_1;
+	}
+
+	hashValue ^= hashValue >> 33;
+	hashValue *= XXHASH64_PRIME_2;
+	hashValue ^= hashValue >> 29;
+	hashValue *= XXHASH64_PRIME_3;
+	hashValue ^= hashValue >> 32;
+	return hashValue;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+static unsigned int ComputeCRC32CWithSSE42( const byte_t* data, size_t numBytes, unsigned int crc )
+{
+#if defined( _M_X64 )
+	unsigned long long wideCRC = crc;
+	for( ; numBytes >= 8; numBytes -= 8, data += 8 )
+		wideCRC = _mm_crc32_u64( wideCRC, Read64( data ) );
+
+	crc = (unsigned int) wideCRC;
+#endif
+
+	for( ; numBytes >= 4; numBytes -= 4, data += 4 )
+		crc = _mm_crc32_u32( crc, Read32( data ) );
+
+	for( ; numBytes > 0; --numBytes, ++data )
+		crc = _mm_crc32_u8( crc, *data );
+
+	return crc;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+static unsigned int ComputeCRC32CWithTable( const byte_t* data, size_t numBytes, unsigned int crc )
+{
+	for( ; numBytes > 0; --numBytes, ++data )
+		crc = s_crc32cTable.m_entries[ ( crc ^ *data ) & 0xff ] ^ ( crc >> 8 );
+
+	return crc;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+unsigned int ComputeCRC32C( const byte_t* data, size_t numBytes, unsigned int previousCRC )
+{
+	unsigned int crc = ~previousCRC;
+	if( s_isSSE42Supported )
+		crc = ComputeCRC32CWithSSE42( data, numBytes, crc );
+	else
+		crc = ComputeCRC32CWithTable( data, numBytes, crc );
+
+	return ~crc;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+unsigned long long ComputeHash( hashAlgorithm algorithm, const byte_t* data, size_t numBytes )
+{
+	switch( algorithm )
+	{
+		case HASH_ALGORITHM_XXHASH64:		return ComputeXXHash64( data, numBytes );
+		case HASH_ALGORITHM_CRC32C:			return ComputeCRC32C( data, numBytes );
+		default:							return ComputeLegacyHash( data, numBytes );
+	}
+}
+
+
+//-----------------------------------------------------------------------------------------------
+const char* GetHashAlgorithmName( hashAlgorithm algorithm )
+{
+	switch( algorithm )
+	{
+		case HASH_ALGORITHM_LEGACY:			return "legacy";
+		case HASH_ALGORITHM_XXHASH64:		return "xxh64";
+		case HASH_ALGORITHM_CRC32C:			return "crc32c";
+		default:							return "unknown";
+	}
+}
+
+
+//-----------------------------------------------------------------------------------------------
+bool GetHashAlgorithmFromName( const std::string& name, hashAlgorithm& algorithm_out )
+{
+	for( int algorithmIndex = 0; algorithmIndex < NUMBER_OF_HASH_ALGORITHMS; ++algorithmIndex )
+	{
+		if( name == GetHashAlgorithmName( static_cast< hashAlgorithm >( algorithmIndex ) ) )
+		{
+			algorithm_out = static_cast< hashAlgorithm >( algorithmIndex );
+			return true;
+		}
+	}
+
+	return false;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+struct HashTreeLeaf
+{
+	HashTreeLeaf( hashAlgorithm algorithm, const byte_t* data, size_t numBytes, unsigned long long* leafHashes_out ) : m_algorithm( algorithm ), m_data( data ), m_numBytes( numBytes ), m_leafHashes( leafHashes_out ) {}
+
+	void operator()( unsigned int leafIndex ) const
+	{
+		size_t leafOffset = (size_t) leafIndex * HASH_TREE_LEAF_SIZE_IN_BYTES;
+		size_t leafSize = ( m_numBytes - leafOffset < HASH_TREE_LEAF_SIZE_IN_BYTES ) ? m_numBytes - leafOffset : HASH_TREE_LEAF_SIZE_IN_BYTES;
+		m_leafHashes[ leafIndex ] = ComputeHash( m_algorithm, m_data + leafOffset, leafSize );
+	}
+
+	hashAlgorithm			m_algorithm;
+	const byte_t*			m_data;
+	size_t					m_numBytes;
+	unsigned long long*		m_leafHashes;
+};
+
+
+//-----------------------------------------------------------------------------------------------
+//The length goes in after the last leaf hash so buffers that differ only in trailing empty
+//leaves still hash differently.
+unsigned long long ComputeTreeHash( hashAlgorithm algorithm, const byte_t* data, size_t numBytes )
+{
+	TreeHashBuilder treeHashBuilder( algorithm );
+	treeHashBuilder.AddData( data, numBytes );
+	return treeHashBuilder.Finish();
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void TreeHashBuilder::AddData( const byte_t* data, size_t numBytes )
+{
+	// a partial leaf can only ever be the last one
+	assert( m_numBytesAdded % HASH_TREE_LEAF_SIZE_IN_BYTES == 0 );
+
+	unsigned int numLeaves = (unsigned int) ( ( numBytes + HASH_TREE_LEAF_SIZE_IN_BYTES - 1 ) / HASH_TREE_LEAF_SIZE_IN_BYTES );
+	m_numBytesAdded += numBytes;
+	if( numLeaves == 0 )
+		return;
+
+	size_t firstLeafIndex = m_leafHashes.size();
+	m_leafHashes.resize( firstLeafIndex + numLeaves );
+	ParallelFor( 0, numLeaves, 1, HashTreeLeaf( m_algorithm, data, numBytes, &m_leafHashes[ firstLeafIndex ] ) );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+unsigned long long TreeHashBuilder::Finish()
+{
+	m_leafHashes.push_back( m_numBytesAdded );
+	return ComputeHash( m_algorithm, reinterpret_cast< const byte_t* >( &m_leafHashes[ 0 ] ), m_leafHashes.size() * sizeof( unsigned long long ) );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+HashBenchmarkResults RunHashBenchmark( hashAlgorithm algorithm, bool isTreeHash, const byte_t* data, size_t numBytes )
+{
+	HashBenchmarkResults results;
+	results.m_algorithm = algorithm;
+	results.m_isTreeHash = isTreeHash;
+
+	double startTime = GetCurrentTimeSeconds();
+	if( isTreeHash )
+		results.m_hashValue = ComputeTreeHash( algorithm, data, numBytes );
+	else
+		results.m_hashValue = ComputeHash( algorithm, data, numBytes );
+
+	results.m_secondsElapsed = GetCurrentTimeSeconds() - startTime;
+	return results;
+}
\ No newline at end of file
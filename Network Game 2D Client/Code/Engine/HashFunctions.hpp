@@ -0,0 +1,77 @@
+#ifndef include_HashFunctions
+#define include_HashFunctions
+#pragma once
+
+//-----------------------------------------------------------------------------------------------
+#include <string>
+#include <vector>
+#include <stddef.h>
+#include "EngineCommon.hpp"
+
+
+//-----------------------------------------------------------------------------------------------
+const size_t HASH_TREE_LEAF_SIZE_IN_BYTES = 1024 * 1024;
+
+
+//-----------------------------------------------------------------------------------------------
+enum hashAlgorithm
+{
+	HASH_ALGORITHM_LEGACY,
+	HASH_ALGORITHM_XXHASH64,
+	HASH_ALGORITHM_CRC32C,
+	NUMBER_OF_HASH_ALGORITHMS,
+};
+
+
+//-----------------------------------------------------------------------------------------------
+//None of these are cryptographic; they catch corruption, not tampering. CRC32C runs on the SSE4.2
+//crc32 instruction when the CPU has it and falls back to a lookup table otherwise, with the same
+//result either way. Passing a previous CRC32C continues it over the next bytes.
+unsigned int ComputeLegacyHash( const byte_t* data, size_t numBytes );
+unsigned long long ComputeXXHash64( const byte_t* data, size_t numBytes, unsigned long long seed = 0 );
+unsigned int ComputeCRC32C( const byte_t* data, size_t numBytes, unsigned int previousCRC = 0 );
+unsigned long long ComputeHash( hashAlgorithm algorithm, const byte_t* data, size_t numBytes );
+bool IsSSE42Supported();
+const char* GetHashAlgorithmName( hashAlgorithm algorithm );
+bool GetHashAlgorithmFromName( const std::string& name, hashAlgorithm& algorithm_out );
+
+
+//-----------------------------------------------------------------------------------------------
+//Hashes every HASH_TREE_LEAF_SIZE_IN_BYTES leaf on its own, spread over the generic workers, then
+//hashes the leaf hashes and the length together. Leaves are a fixed size so the result does not
+//depend on the number of threads, but it is not the same value as the flat hash of the buffer.
+unsigned long long ComputeTreeHash( hashAlgorithm algorithm, const byte_t* data, size_t numBytes );
+
+
+//-----------------------------------------------------------------------------------------------
+//Comes to the same value as ComputeTreeHash over data handed in a piece at a time, for files too
+//big to have in memory at once. Every piece but the last has to be a whole number of leaves.
+class TreeHashBuilder
+{
+public:
+	TreeHashBuilder( hashAlgorithm algorithm ) : m_algorithm( algorithm ), m_numBytesAdded( 0 ) {}
+	void AddData( const byte_t* data, size_t numBytes );
+	unsigned long long Finish();
+
+private:
+	hashAlgorithm						m_algorithm;
+	std::vector< unsigned long long >	m_leafHashes;
+	unsigned long long					m_numBytesAdded;
+};
+
+
+//-----------------------------------------------------------------------------------------------
+struct HashBenchmarkResults
+{
+	hashAlgorithm		m_algorithm;
+	bool				m_isTreeHash;
+	double				m_secondsElapsed;
+	unsigned long long	m_hashValue;
+};
+
+
+//-----------------------------------------------------------------------------------------------
+HashBenchmarkResults RunHashBenchmark( hashAlgorithm algorithm, bool isTreeHash, const byte_t* data, size_t numBytes );
+
+
+#endif // include_HashFunctions
\ No newline at end of file
@@ -7,6 +7,16 @@
 Job::Job()
 	: m_priority( AVERAGE_PRIORITY )
 	, m_jobType( JOB_TYPE_UNDEFINED )
+	, m_queueIndex( INVALID_JOB_QUEUE_INDEX )
+	, m_submissionNumber( 0 )
+	, m_deadline( 0 )
+	, m_completionCounter( nullptr )
+	, m_nextCompletedJob( nullptr )
+	, m_secondsWhenAdded( 0.0 )
+	, m_secondsWhenQueued( 0.0 )
+	, m_secondsWhenStarted( 0.0 )
+	, m_secondsWhenCompleted( 0.0 )
+	, m_isOwnedByWaiter( false )
 {
 
 }
@@ -16,6 +26,16 @@ Job::Job()
 Job::Job( priorityRating priority )
 	: m_priority( priority )
 	, m_jobType( JOB_TYPE_UNDEFINED )
+	, m_queueIndex( INVALID_JOB_QUEUE_INDEX )
+	, m_submissionNumber( 0 )
+	, m_deadline( 0 )
+	, m_completionCounter( nullptr )
+	, m_nextCompletedJob( nullptr )
+	, m_secondsWhenAdded( 0.0 )
+	, m_secondsWhenQueued( 0.0 )
+	, m_secondsWhenStarted( 0.0 )
+	, m_secondsWhenCompleted( 0.0 )
+	, m_isOwnedByWaiter( false )
 {
 
 }
@@ -25,6 +45,8 @@ Job::Job( priorityRating priority )
 LoadFileJob::LoadFileJob( func callbackFunction, const std::string& fileLocation )
 	: m_callbackFunction( callbackFunction )
 	, m_fileLocation( fileLocation )
+	, m_byteBuffer( nullptr )
+	, m_bufferLength( 0 )
 {
 	m_jobType = JOB_TYPE_FILE_IO;
 }
@@ -34,6 +56,8 @@ LoadFileJob::LoadFileJob( func callbackFunction, const std::string& fileLocation
 LoadFileJob::LoadFileJob( func callbackFunction, const std::string& fileLocation, priorityRating priority )
 	: m_callbackFunction( callbackFunction )
 	, m_fileLocation( fileLocation )
+	, m_byteBuffer( nullptr )
+	, m_bufferLength( 0 )
 {
 	m_priority = priority;
 	m_jobType = JOB_TYPE_FILE_IO;
@@ -49,7 +73,7 @@ void LoadFileJob::Execute()
 		return;
 
 	fseek( file, 0, SEEK_END );
-	long m_bufferLength = ftell( file );
+	m_bufferLength = ftell( file );
 	rewind( file );
 
 	m_byteBuffer = new char[ m_bufferLength ];
@@ -65,6 +89,65 @@ void LoadFileJob::FireCallbackEvent()
 }
 
 
+//-----------------------------------------------------------------------------------------------
+MapFileJob::MapFileJob( func callbackFunction, const std::string& fileLocation, bool shouldPrefetch )
+	: m_callbackFunction( callbackFunction )
+	, m_fileLocation( fileLocation )
+	, m_shouldPrefetch( shouldPrefetch )
+	, m_mappedFile( nullptr )
+{
+	m_jobType = JOB_TYPE_FILE_IO;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+MapFileJob::MapFileJob( func callbackFunction, const std::string& fileLocation, bool shouldPrefetch, priorityRating priority )
+	: m_callbackFunction( callbackFunction )
+	, m_fileLocation( fileLocation )
+	, m_shouldPrefetch( shouldPrefetch )
+	, m_mappedFile( nullptr )
+{
+	m_priority = priority;
+	m_jobType = JOB_TYPE_FILE_IO;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+MapFileJob::~MapFileJob()
+{
+	delete m_mappedFile;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void MapFileJob::Execute()
+{
+	m_mappedFile = new MappedFile();
+	if( !m_mappedFile->Open( m_fileLocation, m_shouldPrefetch ) )
+	{
+		delete m_mappedFile;
+		m_mappedFile = nullptr;
+	}
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void MapFileJob::FireCallbackEvent()
+{
+	m_callbackFunction( TakeMappedFile() );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+//For jobs that were awaited rather than given a callback.
+MappedFile* MapFileJob::TakeMappedFile()
+{
+	MappedFile* mappedFile = m_mappedFile;
+	m_mappedFile = nullptr;
+	return mappedFile;
+}
+
+
 //-----------------------------------------------------------------------------------------------
 SaveFileJob::SaveFileJob( func callbackFunction, const std::string& fileLocation, char* buffer )
 	: m_callbackFunction( callbackFunction )
@@ -113,6 +196,9 @@ HashBufferJob::HashBufferJob( func callbackFunction, char* buffer, long length )
 	: m_callbackFunction( callbackFunction )
 	, m_byteBuffer( buffer )
 	, m_bufferLength( length )
+	, m_algorithm( HASH_ALGORITHM_LEGACY )
+	, m_shouldUseTreeHash( false )
+	, m_hashValue( 0 )
 {
 	m_jobType = JOB_TYPE_HASH_ENCRYPTION;
 }
@@ -123,6 +209,23 @@ HashBufferJob::HashBufferJob( func callbackFunction, char* buffer, long length,
 	: m_callbackFunction( callbackFunction )
 	, m_byteBuffer( buffer )
 	, m_bufferLength( length )
+	, m_algorithm( HASH_ALGORITHM_LEGACY )
+	, m_shouldUseTreeHash( false )
+	, m_hashValue( 0 )
+{
+	m_priority = priority;
+	m_jobType = JOB_TYPE_HASH_ENCRYPTION;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+HashBufferJob::HashBufferJob( func callbackFunction, char* buffer, long length, hashAlgorithm algorithm, bool shouldUseTreeHash, priorityRating priority )
+	: m_callbackFunction( callbackFunction )
+	, m_byteBuffer( buffer )
+	, m_bufferLength( length )
+	, m_algorithm( algorithm )
+	, m_shouldUseTreeHash( shouldUseTreeHash )
+	, m_hashValue( 0 )
 {
 	m_priority = priority;
 	m_jobType = JOB_TYPE_HASH_ENCRYPTION;
@@ -132,13 +235,12 @@ HashBufferJob::HashBufferJob( func callbackFunction, char* buffer, long length,
 //-----------------------------------------------------------------------------------------------
 void HashBufferJob::Execute()
 {
-	m_hashValue = 0;
-	for( int byteIndex = 0; byteIndex < m_bufferLength; ++byteIndex )
-	{
-		m_hashValue &= 0x07ffffff;
-		m_hashValue *= 31;
-		m_hashValue += m_byteBuffer[ byteIndex ];
-	}
+	const byte_t* data = reinterpret_cast< const byte_t* >( m_byteBuffer );
+	size_t numBytes = ( m_bufferLength > 0 ) ? (size_t) m_bufferLength : 0;
+	if( m_shouldUseTreeHash )
+		m_hashValue = ComputeTreeHash( m_algorithm, data, numBytes );
+	else
+		m_hashValue = ComputeHash( m_algorithm, data, numBytes );
 }
 
 
@@ -4,9 +4,17 @@
 
 //-----------------------------------------------------------------------------------------------
 #include <string>
+#include <vector>
+#include "MappedFile.hpp"
+#include "ObjectPool.hpp"
+#include "HashFunctions.hpp"
 #include "NamedProperties.hpp"
 
 
+//-----------------------------------------------------------------------------------------------
+const unsigned int INVALID_JOB_QUEUE_INDEX = 0xffffffff;
+
+
 //-----------------------------------------------------------------------------------------------
 enum priorityRating
 {
@@ -28,22 +36,55 @@ enum jobType
 };
 
 
+//-----------------------------------------------------------------------------------------------
+class Job;
+struct JobFiber;
+
+
+//-----------------------------------------------------------------------------------------------
+//Counts the jobs of one stage of work that have not finished yet. Jobs added after a counter,
+//and fiber jobs suspended in WaitFor on it, wait until it reaches zero. The owner keeps the
+//counter alive until JobManager::WaitFor on it has returned; its waiting lists are guarded by
+//JobManager::s_cs.
+class JobCounter
+{
+public:
+	JobCounter() : m_numUnfinishedJobs( 0 ) {}
+	bool IsDone() const { return m_numUnfinishedJobs == 0; }
+
+	volatile LONG				m_numUnfinishedJobs;
+	std::vector< Job* >			m_jobsWaiting;
+	std::vector< JobFiber* >	m_fibersWaiting;
+};
+
+
 //-----------------------------------------------------------------------------------------------
 class Job
 {
 public:
 	Job();
 	Job( priorityRating priority );
+	virtual ~Job() {}
 	virtual void Execute() {}
 	virtual void FireCallbackEvent() {}
 
 	priorityRating	m_priority;
 	jobType			m_jobType;
+	unsigned int	m_queueIndex;
+	unsigned int	m_submissionNumber;
+	unsigned int	m_deadline;
+	JobCounter*		m_completionCounter;
+	Job* volatile	m_nextCompletedJob;
+	double			m_secondsWhenAdded;
+	double			m_secondsWhenQueued;
+	double			m_secondsWhenStarted;
+	double			m_secondsWhenCompleted;
+	bool			m_isOwnedByWaiter;
 };
 
 
 //-----------------------------------------------------------------------------------------------
-class LoadFileJob : public Job
+class LoadFileJob : public Job, public PooledObject< LoadFileJob >
 {
 	typedef void ( *func ) ( char*, long );
 
@@ -52,6 +93,8 @@ public:
 	LoadFileJob( func callbackFunction, const std::string& fileLocation, priorityRating priority );
 	void Execute();
 	void FireCallbackEvent();
+	char* GetBuffer() const { return m_byteBuffer; }
+	long GetBufferLength() const { return m_bufferLength; }
 
 private:
 	std::string		m_fileLocation;
@@ -62,7 +105,30 @@ private:
 
 
 //-----------------------------------------------------------------------------------------------
-class SaveFileJob : public Job
+//Hands the callback a read only view of the file instead of a copy of it. The callback takes
+//ownership of the mapped file, which is closed when it is deleted; a failed open passes nullptr.
+class MapFileJob : public Job, public PooledObject< MapFileJob >
+{
+	typedef void ( *func ) ( MappedFile* );
+
+public:
+	MapFileJob( func callbackFunction, const std::string& fileLocation, bool shouldPrefetch );
+	MapFileJob( func callbackFunction, const std::string& fileLocation, bool shouldPrefetch, priorityRating priority );
+	~MapFileJob();
+	void Execute();
+	void FireCallbackEvent();
+	MappedFile* TakeMappedFile();
+
+private:
+	std::string		m_fileLocation;
+	bool			m_shouldPrefetch;
+	MappedFile*		m_mappedFile;
+	func			m_callbackFunction;
+};
+
+
+//-----------------------------------------------------------------------------------------------
+class SaveFileJob : public Job, public PooledObject< SaveFileJob >
 {
 	typedef bool ( *func ) ( bool );
 
@@ -81,26 +147,32 @@ private:
 
 
 //-----------------------------------------------------------------------------------------------
-class HashBufferJob : public Job
+//Hashes with the legacy hash unless told otherwise. A tree hash splits the buffer across the
+//generic workers, with this job's thread hashing leaves too until they are all done.
+class HashBufferJob : public Job, public PooledObject< HashBufferJob >
 {
-	typedef unsigned int ( *func ) ( unsigned int );
+	typedef unsigned int ( *func ) ( unsigned long long );
 
 public:
 	HashBufferJob( func callbackFunction, char* buffer, long length );
 	HashBufferJob( func callbackFunction, char* buffer, long length, priorityRating priority );
+	HashBufferJob( func callbackFunction, char* buffer, long length, hashAlgorithm algorithm, bool shouldUseTreeHash, priorityRating priority );
 	void Execute();
 	void FireCallbackEvent();
+	unsigned long long GetHashValue() const { return m_hashValue; }
 
 private:
-	char*			m_byteBuffer;
-	long			m_bufferLength;
-	unsigned int	m_hashValue;
-	func			m_callbackFunction;
+	char*				m_byteBuffer;
+	long				m_bufferLength;
+	hashAlgorithm		m_algorithm;
+	bool				m_shouldUseTreeHash;
+	unsigned long long	m_hashValue;
+	func				m_callbackFunction;
 };
 
 
 //-----------------------------------------------------------------------------------------------
-class ReverseBufferJob : public Job
+class ReverseBufferJob : public Job, public PooledObject< ReverseBufferJob >
 {
 	typedef void ( *func ) (  );
 
@@ -0,0 +1,59 @@
+#include "JobCompletionQueue.hpp"
+#include "NewMacroDef.hpp"
+
+
+//-----------------------------------------------------------------------------------------------
+JobCompletionQueue::JobCompletionQueue()
+	: m_head( &m_stub )
+	, m_tail( &m_stub )
+{
+	m_stub.m_nextCompletedJob = nullptr;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void JobCompletionQueue::Push( Job* job )
+{
+	job->m_nextCompletedJob = nullptr;
+	Job* previousHead = static_cast< Job* >( InterlockedExchangePointer( reinterpret_cast< void* volatile* >( &m_head ), job ) );
+	previousHead->m_nextCompletedJob = job;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+Job* JobCompletionQueue::Pop()
+{
+	Job* tail = m_tail;
+	Job* next = tail->m_nextCompletedJob;
+
+	if( tail == &m_stub )
+	{
+		if( next == nullptr )
+			return nullptr;
+
+		m_tail = next;
+		tail = next;
+		next = next->m_nextCompletedJob;
+	}
+
+	if( next != nullptr )
+	{
+		m_tail = next;
+		return tail;
+	}
+
+	// the tail is the last job pushed unless a producer is still linking a newer one in
+	if( tail != m_head )
+		return nullptr;
+
+	// put the stub behind the tail so the tail can be handed out without emptying the list
+	Push( &m_stub );
+	next = tail->m_nextCompletedJob;
+	if( next != nullptr )
+	{
+		m_tail = next;
+		return tail;
+	}
+
+	return nullptr;
+}
\ No newline at end of file
@@ -0,0 +1,35 @@
+#ifndef include_JobCompletionQueue
+#define include_JobCompletionQueue
+#pragma once
+
+//-----------------------------------------------------------------------------------------------
+#include <windows.h>
+#include "Job.hpp"
+#include "EngineCommon.hpp"
+
+
+//-----------------------------------------------------------------------------------------------
+//Intrusive multiple producer, single consumer queue linked through Job::m_nextCompletedJob.
+//Pushing is one exchange and one store and never waits on the consumer. Pop can come back empty
+//while a producer is between those two steps; that job is then returned by a later Pop. Only the
+//consumer may call IsEmpty, which counts such a half pushed job as already there.
+class JobCompletionQueue
+{
+public:
+	JobCompletionQueue();
+	void Push( Job* job );
+	Job* Pop();
+	bool IsEmpty() const { return m_tail == &m_stub && m_head == &m_stub; }
+
+private:
+	JobCompletionQueue( const JobCompletionQueue& );
+	void operator=( const JobCompletionQueue& );
+
+	Job* volatile	m_head;
+	byte_t			m_padding[ CACHE_LINE_SIZE_IN_BYTES ];
+	Job*			m_tail;
+	Job				m_stub;
+};
+
+
+#endif // include_JobCompletionQueue
\ No newline at end of file
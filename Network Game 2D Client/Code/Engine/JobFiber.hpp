@@ -0,0 +1,38 @@
+#ifndef include_JobFiber
+#define include_JobFiber
+#pragma once
+
+//-----------------------------------------------------------------------------------------------
+#include "Job.hpp"
+
+
+//-----------------------------------------------------------------------------------------------
+const SIZE_T JOB_FIBER_STACK_COMMIT_SIZE_IN_BYTES = 16 * 1024;
+const SIZE_T JOB_FIBER_STACK_RESERVE_SIZE_IN_BYTES = 128 * 1024;
+const LONG MAX_NUM_JOB_FIBERS = 256;
+
+
+//-----------------------------------------------------------------------------------------------
+enum jobFiberState
+{
+	FIBER_STATE_IDLE,
+	FIBER_STATE_RUNNING,
+	FIBER_STATE_WAITING,
+	FIBER_STATE_FINISHED,
+};
+
+
+//-----------------------------------------------------------------------------------------------
+//A fiber runs one job at a time and is reused for the next one once its job has finished. A job
+//that waits on a counter switches its fiber back to the worker's scheduler fiber, and whichever
+//worker picks the fiber up again once the counter reaches zero resumes it, stack and all.
+struct JobFiber
+{
+	void*			m_fiber;
+	Job*			m_job;
+	jobFiberState	m_state;
+	JobCounter*		m_counterWaitedOn;
+};
+
+
+#endif // include_JobFiber
\ No newline at end of file
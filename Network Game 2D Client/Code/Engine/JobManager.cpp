@@ -1,217 +1,990 @@
 #include "JobManager.hpp"
+#include <stdio.h>
+#include <assert.h>
 #include <process.h>
+#include <string.h>
+#include "Time.hpp"
 #include "EngineCommon.hpp"
+#include "MemoryManager.hpp"
+#include "StringFunctions.hpp"
+#include "DeferredEventQueue.hpp"
 #include "NewMacroDef.hpp"
 
 
 //-----------------------------------------------------------------------------------------------
-STATIC std::vector< Job* > JobManager::s_jobsTodoByType[];
-STATIC std::vector< Job* > JobManager::s_jobsCompleted;
-STATIC std::vector< WorkerThread* > JobManager::s_workerThreads;
 STATIC CRITICAL_SECTION JobManager::s_cs;
+STATIC bool JobManager::s_isStarted = false;
+STATIC volatile bool JobManager::s_isShuttingDown = false;
+STATIC bool JobManager::s_areJobsRunOnFibers = false;
+STATIC volatile LONG JobManager::s_numQueuedJobs = 0;
+STATIC volatile LONG JobManager::s_numSleepingGenericWorkers = 0;
+STATIC CONDITION_VARIABLE JobManager::s_genericJobAdded;
+STATIC CONDITION_VARIABLE JobManager::s_jobAddedByType[];
+STATIC unsigned int JobManager::s_numJobsSubmitted = 0;
+STATIC JobPriorityQueue JobManager::s_jobsTodoByType[];
+STATIC JobCompletionQueue JobManager::s_jobsCompleted;
+STATIC double JobManager::s_callbackBudgetSecondsPerFrame = DEFAULT_CALLBACK_BUDGET_SECONDS_PER_FRAME;
+STATIC JobLatencyStatistics JobManager::s_latencyStatistics;
+STATIC JobTypeStatistics JobManager::s_jobTypeStatistics[];
+STATIC double JobManager::s_secondsWhenStatisticsReset = 0.0;
+STATIC std::vector< WorkerThread* > JobManager::s_workerThreads;
+STATIC WorkerThread* JobManager::s_genericWorkerThreads[];
+STATIC volatile LONG JobManager::s_numGenericWorkerThreads = 0;
+STATIC std::deque< JobFiber* > JobManager::s_readyJobFibers;
+STATIC volatile LONG JobManager::s_numReadyJobFibers = 0;
+STATIC volatile LONG JobManager::s_numJobFibers = 0;
+STATIC std::vector< JobTimer > JobManager::s_timers;
+
+
+//-----------------------------------------------------------------------------------------------
+//A job on a fiber can resume on a different thread than it suspended on, while the compiler may
+//keep the address of a thread local from before SwitchToFiber. Going through functions that are
+//never inlined looks the address up again on every access, on whatever thread runs it then.
+static __declspec( thread ) WorkerThread* g_currentWorkerThread = nullptr;
+
+
+//-----------------------------------------------------------------------------------------------
+static __declspec( noinline ) WorkerThread* GetCurrentWorkerThread()
+{
+	return g_currentWorkerThread;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+static __declspec( noinline ) void SetCurrentWorkerThread( WorkerThread* workerThread )
+{
+	g_currentWorkerThread = workerThread;
+}
 
 
 //-----------------------------------------------------------------------------------------------
-void WorkerThreadEntryFunc( void* data )
+unsigned int __stdcall WorkerThreadEntryFunc( void* data )
 {
 	WorkerThread* workerThread = static_cast< WorkerThread* >( data );
+	SetCurrentWorkerThread( workerThread );
+
+	bool isRunningJobsOnFibers = JobManager::s_areJobsRunOnFibers && workerThread->IsGeneric();
+	if( isRunningJobsOnFibers )
+	{
+		workerThread->m_schedulerFiber = ConvertThreadToFiberEx( nullptr, FIBER_FLAG_FLOAT_SWITCH );
+		isRunningJobsOnFibers = ( workerThread->m_schedulerFiber != nullptr );
+	}
 
-	while( !g_isQuitting )
+	while( true )
 	{
-		Job* job = JobManager::GetJobFromTodoList( workerThread->m_jobTypeToHandle );
+		JobFiber* readyJobFiber = isRunningJobsOnFibers ? JobManager::GetReadyJobFiber() : nullptr;
+		if( readyJobFiber )
+		{
+			double secondsWhenResumed = GetCurrentTimeSeconds();
+			JobManager::SwitchToJobFiber( workerThread, readyJobFiber );
+			workerThread->m_statistics.m_secondsBusy += GetCurrentTimeSeconds() - secondsWhenResumed;
+			continue;
+		}
+
+		Job* job = JobManager::GetJobForWorker( workerThread );
 		if( job )
 		{
-			job->Execute();
-			JobManager::ReportCompletedJob( job );
+			double secondsWhenStarted = GetCurrentTimeSeconds();
+			workerThread->m_status = WORKING;
+			if( !isRunningJobsOnFibers || !JobManager::RunJobOnFiber( workerThread, job ) )
+				JobManager::RunJob( job );
+			workerThread->m_status = FINISHED_JOB;
+			workerThread->m_statistics.m_secondsBusy += GetCurrentTimeSeconds() - secondsWhenStarted;
+			++workerThread->m_statistics.m_numJobsRun;
 		}
-		else
+		else if( !JobManager::WaitForJob( workerThread ) )
 		{
-			Sleep( 0 );
+			break;
 		}
 	}
+
+	if( isRunningJobsOnFibers )
+	{
+		for( unsigned int fiberIndex = 0; fiberIndex < workerThread->m_freeJobFibers.size(); ++fiberIndex )
+			JobManager::DeleteJobFiber( workerThread->m_freeJobFibers[ fiberIndex ] );
+
+		workerThread->m_freeJobFibers.clear();
+		ConvertFiberToThread();
+	}
+
+	SetCurrentWorkerThread( nullptr );
+	DeferredEventQueue::ReleaseThreadRing();
+	MemoryManager::FlushThreadCache();
+	return 0;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+//Fibers are reused: once a job is done the fiber switches back to whichever scheduler resumed it
+//last and waits there for its next job.
+void __stdcall JobFiberEntryFunc( void* data )
+{
+	JobFiber* jobFiber = static_cast< JobFiber* >( data );
+	while( true )
+	{
+		JobManager::RunJob( jobFiber->m_job );
+		jobFiber->m_job = nullptr;
+		jobFiber->m_state = FIBER_STATE_FINISHED;
+		SwitchToFiber( GetCurrentWorkerThread()->m_schedulerFiber );
+	}
 }
 
 
 //-----------------------------------------------------------------------------------------------
-JobManager::JobManager()
+STATIC void JobManager::Startup( unsigned int numWorkerThreads, bool shouldRunJobsOnFibers )
 {
+	if( s_isStarted )
+		return;
+
+	s_areJobsRunOnFibers = shouldRunJobsOnFibers;
+
 	InitializeCriticalSection( &s_cs );
+	InitializeConditionVariable( &s_genericJobAdded );
+	for( unsigned int jobTypeIndex = 0; jobTypeIndex < NUMBER_OF_JOB_TYPES; ++jobTypeIndex )
+		InitializeConditionVariable( &s_jobAddedByType[ jobTypeIndex ] );
+
+	memset( s_jobTypeStatistics, 0, sizeof( s_jobTypeStatistics ) );
+	s_secondsWhenStatisticsReset = GetCurrentTimeSeconds();
+	s_isShuttingDown = false;
+	s_isStarted = true;
+
+	if( numWorkerThreads == 0 )
+	{
+		// one worker per hardware thread, leaving one for the main thread
+		SYSTEM_INFO systemInfo;
+		GetSystemInfo( &systemInfo );
+		numWorkerThreads = ( systemInfo.dwNumberOfProcessors > 1 ) ? systemInfo.dwNumberOfProcessors - 1 : 1;
+	}
+
+	if( numWorkerThreads > MAX_NUM_GENERIC_WORKER_THREADS )
+		numWorkerThreads = MAX_NUM_GENERIC_WORKER_THREADS;
+
+	for( unsigned int workerIndex = 0; workerIndex < numWorkerThreads; ++workerIndex )
+		CreateNewWorkerThread();
 }
 
 
 //-----------------------------------------------------------------------------------------------
-STATIC void JobManager::CreateNewWorkerThread()
+STATIC void JobManager::Shutdown()
 {
-	WorkerThread* workerThread = new WorkerThread();
+	if( !s_isStarted )
+		return;
 
 	EnterCriticalSection( &s_cs );
-	s_workerThreads.push_back( workerThread );
+	s_isShuttingDown = true;
+	WakeAllConditionVariable( &s_genericJobAdded );
+	for( unsigned int jobTypeIndex = 0; jobTypeIndex < NUMBER_OF_JOB_TYPES; ++jobTypeIndex )
+		WakeAllConditionVariable( &s_jobAddedByType[ jobTypeIndex ] );
 	LeaveCriticalSection( &s_cs );
 
-	_beginthread( WorkerThreadEntryFunc, 0, workerThread );
+	for( unsigned int workerIndex = 0; workerIndex < s_workerThreads.size(); ++workerIndex )
+		WaitForSingleObject( s_workerThreads[ workerIndex ]->m_threadHandle, INFINITE );
+
+	// jobs that never ran are dropped without firing their callbacks
+	for( unsigned int workerIndex = 0; workerIndex < s_workerThreads.size(); ++workerIndex )
+	{
+		WorkerThread* workerThread = s_workerThreads[ workerIndex ];
+		if( workerThread->m_localJobs != nullptr )
+		{
+			while( Job* job = workerThread->m_localJobs->Pop() )
+				delete job;
+		}
+
+		delete workerThread;
+	}
+
+	for( unsigned int jobTypeIndex = 0; jobTypeIndex < NUMBER_OF_JOB_TYPES; ++jobTypeIndex )
+	{
+		while( Job* job = s_jobsTodoByType[ jobTypeIndex ].Pop() )
+			delete job;
+	}
+
+	while( Job* job = s_jobsCompleted.Pop() )
+		delete job;
+
+	// jobs suspended on fibers never finish; the ones still waiting on a counter are leaked
+	for( unsigned int fiberIndex = 0; fiberIndex < s_readyJobFibers.size(); ++fiberIndex )
+		DeleteJobFiber( s_readyJobFibers[ fiberIndex ] );
+
+	s_readyJobFibers.clear();
+	s_numReadyJobFibers = 0;
+	s_numJobFibers = 0;
+	s_timers.clear();
+
+	s_workerThreads.clear();
+	s_numGenericWorkerThreads = 0;
+	s_numQueuedJobs = 0;
+	s_isStarted = false;
+	DeleteCriticalSection( &s_cs );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+STATIC void JobManager::CreateNewWorkerThread()
+{
+	StartWorkerThread( new WorkerThread() );
 }
 
 
 //-----------------------------------------------------------------------------------------------
 STATIC void JobManager::CreateNewWorkerThread( jobType jobTypeToHandle )
 {
-	WorkerThread* workerThread = new WorkerThread( jobTypeToHandle );
+	StartWorkerThread( new WorkerThread( jobTypeToHandle ) );
+}
+
 
+//-----------------------------------------------------------------------------------------------
+STATIC void JobManager::StartWorkerThread( WorkerThread* workerThread )
+{
 	EnterCriticalSection( &s_cs );
 	s_workerThreads.push_back( workerThread );
+	if( workerThread->IsGeneric() && s_numGenericWorkerThreads < MAX_NUM_GENERIC_WORKER_THREADS )
+	{
+		// thieves read the list without the lock, so the slot has to be filled before it is counted
+		s_genericWorkerThreads[ s_numGenericWorkerThreads ] = workerThread;
+		_WriteBarrier();
+		++s_numGenericWorkerThreads;
+	}
 	LeaveCriticalSection( &s_cs );
 
-	_beginthread( WorkerThreadEntryFunc, 0, workerThread );
+	workerThread->m_threadHandle = reinterpret_cast< HANDLE >( _beginthreadex( nullptr, 0, WorkerThreadEntryFunc, workerThread, 0, nullptr ) );
 }
 
 
 //-----------------------------------------------------------------------------------------------
 STATIC void JobManager::AddNewJob( Job* job )
 {
-	EnterCriticalSection( &s_cs );
+	AddNewJob( job, nullptr );
+}
 
-	std::vector< Job* > jobsTodo = s_jobsTodoByType[ job->m_jobType ];
-	jobsTodo.push_back( job );
-	s_jobsTodoByType[ job->m_jobType ] = jobsTodo;
 
-	LeaveCriticalSection( &s_cs );
+//-----------------------------------------------------------------------------------------------
+STATIC void JobManager::AddNewJob( Job* job, JobCounter* completionCounter )
+{
+	if( completionCounter != nullptr )
+		InterlockedIncrement( &completionCounter->m_numUnfinishedJobs );
+
+	job->m_completionCounter = completionCounter;
+	job->m_secondsWhenAdded = GetCurrentTimeSeconds();
+	QueueJob( job );
 }
 
 
 //-----------------------------------------------------------------------------------------------
-STATIC Job* JobManager::GetJobFromTodoList( jobType typeOfJobToGet )
+STATIC void JobManager::AddNewJobAfter( Job* job, JobCounter* prerequisiteCounter, JobCounter* completionCounter )
 {
-	Job* returnJob = nullptr;
-	std::vector< Job* > jobsTodo;
+	if( completionCounter != nullptr )
+		InterlockedIncrement( &completionCounter->m_numUnfinishedJobs );
 
+	job->m_completionCounter = completionCounter;
+	job->m_secondsWhenAdded = GetCurrentTimeSeconds();
+
+	// the last job of the prerequisite stage releases its waiting list under the same lock
 	EnterCriticalSection( &s_cs );
-	jobsTodo = s_jobsTodoByType[ typeOfJobToGet ];
+	if( prerequisiteCounter != nullptr && prerequisiteCounter->m_numUnfinishedJobs != 0 )
+	{
+		prerequisiteCounter->m_jobsWaiting.push_back( job );
+		LeaveCriticalSection( &s_cs );
+		return;
+	}
 	LeaveCriticalSection( &s_cs );
 
-	if( jobsTodo.size() > 0 )
-	{
-		returnJob = jobsTodo.front();
-		unsigned int jobPosition = 0;
+	QueueJob( job );
+}
 
-		for( unsigned int jobIndex = 0; jobIndex < jobsTodo.size(); ++jobIndex )
+
+//-----------------------------------------------------------------------------------------------
+//A worker helps by running other jobs until the counter reaches zero, so waiting from a worker
+//can not starve the jobs being waited on. Any other thread only yields: a job it picked up could
+//wait on a timer or a packet that only that thread's own Update would ever signal.
+STATIC void JobManager::WaitFor( JobCounter* counter )
+{
+	WorkerThread* currentWorkerThread = GetCurrentWorkerThread();
+	if( currentWorkerThread != nullptr && currentWorkerThread->m_currentJobFiber != nullptr )
+	{
+		// suspend this job; the scheduler parks the fiber on the counter once it has switched away
+		JobFiber* jobFiber = currentWorkerThread->m_currentJobFiber;
+		if( counter->m_numUnfinishedJobs != 0 )
 		{
-			Job* job = jobsTodo[ jobIndex ];
-			if( returnJob < job )
-			{
-				returnJob = job;
-				jobPosition = jobIndex;
-			}
+			jobFiber->m_counterWaitedOn = counter;
+			jobFiber->m_state = FIBER_STATE_WAITING;
+			SwitchToFiber( currentWorkerThread->m_schedulerFiber );
+			jobFiber->m_counterWaitedOn = nullptr;
+			currentWorkerThread = GetCurrentWorkerThread();
 		}
+	}
+
+	while( counter->m_numUnfinishedJobs != 0 )
+	{
+		Job* job = ( currentWorkerThread != nullptr ) ? GetJobToHelpWith( currentWorkerThread ) : nullptr;
+		if( job )
+			RunJob( job );
+		else
+			SwitchToThread();
+	}
+
+	// the worker that finished the last job may still be releasing the counter's waiting jobs
+	EnterCriticalSection( &s_cs );
+	LeaveCriticalSection( &s_cs );
+}
 
-		jobsTodo.erase( jobsTodo.begin() + jobPosition );
 
-		EnterCriticalSection( &s_cs );
-		s_jobsTodoByType[ typeOfJobToGet ] = jobsTodo;
+//-----------------------------------------------------------------------------------------------
+//Lets the thread that added a job run it itself, as long as it is still waiting in an injection
+//queue. Jobs on a worker's own deque, or already taken by a worker, are left alone.
+STATIC bool JobManager::RunQueuedJob( Job* job )
+{
+	EnterCriticalSection( &s_cs );
+	bool wasTaken = s_jobsTodoByType[ job->m_jobType ].Remove( job );
+	if( wasTaken )
+		InterlockedDecrement( &s_numQueuedJobs );
+	LeaveCriticalSection( &s_cs );
+
+	if( !wasTaken )
+		return false;
+
+	RunJob( job );
+	return true;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+//Runs the job as a step of the calling job and waits for it. Its callback is never fired: the
+//caller reads its results and deletes it once this returns.
+STATIC void JobManager::AwaitJob( Job* job )
+{
+	assert( IsWorkerThread() );
+
+	JobCounter jobFinished;
+	job->m_isOwnedByWaiter = true;
+	AddNewJob( job, &jobFinished );
+	WaitFor( &jobFinished );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+STATIC void JobManager::AwaitSeconds( double seconds )
+{
+	assert( IsWorkerThread() );
+
+	JobCounter timerFired;
+	timerFired.m_numUnfinishedJobs = 1;
+	AddTimer( &timerFired, seconds );
+	WaitFor( &timerFired );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+//The await functions are only for steps of a job; anywhere else nothing would ever help or wake
+//the wait.
+STATIC bool JobManager::IsWorkerThread()
+{
+	return GetCurrentWorkerThread() != nullptr;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+//Counts one off a counter that waits on something other than jobs, such as a timer or a packet.
+//Several sources may race to signal a counter of one; only the first gets true back.
+STATIC bool JobManager::SignalCounter( JobCounter* counter )
+{
+	std::vector< Job* > jobsReleased;
+
+	EnterCriticalSection( &s_cs );
+	if( counter->m_numUnfinishedJobs == 0 )
+	{
 		LeaveCriticalSection( &s_cs );
+		return false;
 	}
 
-	return returnJob;
+	if( InterlockedDecrement( &counter->m_numUnfinishedJobs ) == 0 )
+		ReleaseCounterWaiters( counter, jobsReleased );
+	LeaveCriticalSection( &s_cs );
+
+	for( unsigned int jobIndex = 0; jobIndex < jobsReleased.size(); ++jobIndex )
+		QueueJob( jobsReleased[ jobIndex ] );
+
+	return true;
 }
 
 
 //-----------------------------------------------------------------------------------------------
-STATIC Job* JobManager::GetJobOfAnyTypeFromTodoList()
+//The counter is signalled from the first Update at least the given seconds from now. A waiter
+//that wakes for another reason must cancel the timer before its counter goes away.
+STATIC void JobManager::AddTimer( JobCounter* counter, double secondsBeforeSignal )
 {
-	Job* returnJob = nullptr;
-	unsigned int todoListToEdit = 0;
-	unsigned int jobPosition = 0;
+	JobTimer timer;
+	timer.m_secondsWhenDue = GetCurrentTimeSeconds() + secondsBeforeSignal;
+	timer.m_counter = counter;
 
-	for( unsigned int jobTypeIndex = 0; jobTypeIndex < NUMBER_OF_JOB_TYPES; ++jobTypeIndex )
+	EnterCriticalSection( &s_cs );
+	s_timers.push_back( timer );
+	LeaveCriticalSection( &s_cs );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+STATIC void JobManager::CancelTimer( JobCounter* counter )
+{
+	EnterCriticalSection( &s_cs );
+	for( unsigned int timerIndex = 0; timerIndex < s_timers.size(); ++timerIndex )
 	{
-		std::vector< Job* > jobsTodo;
+		if( s_timers[ timerIndex ].m_counter == counter )
+		{
+			s_timers[ timerIndex ] = s_timers.back();
+			s_timers.pop_back();
+			break;
+		}
+	}
+	LeaveCriticalSection( &s_cs );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+//Signals while still holding the lock, so a waiter cancelling its timer can not free the counter
+//in between.
+STATIC void JobManager::SignalDueTimers( double secondsNow )
+{
+	EnterCriticalSection( &s_cs );
+	unsigned int timerIndex = 0;
+	while( timerIndex < s_timers.size() )
+	{
+		if( s_timers[ timerIndex ].m_secondsWhenDue > secondsNow )
+		{
+			++timerIndex;
+			continue;
+		}
+
+		JobCounter* counter = s_timers[ timerIndex ].m_counter;
+		s_timers[ timerIndex ] = s_timers.back();
+		s_timers.pop_back();
+		SignalCounter( counter );
+	}
+	LeaveCriticalSection( &s_cs );
+}
 
-		EnterCriticalSection( &s_cs );
-		jobsTodo = s_jobsTodoByType[ jobTypeIndex ];
-		LeaveCriticalSection( &s_cs );
 
-		if( jobsTodo.size() > 0 )
+//-----------------------------------------------------------------------------------------------
+STATIC void JobManager::QueueJob( Job* job )
+{
+	job->m_secondsWhenQueued = GetCurrentTimeSeconds();
+	InterlockedIncrement( &s_jobTypeStatistics[ job->m_jobType ].m_numJobsQueued );
+
+	WorkerThread* currentWorkerThread = GetCurrentWorkerThread();
+	if( currentWorkerThread != nullptr && currentWorkerThread->IsGeneric() && job->m_jobType == JOB_TYPE_UNDEFINED )
+	{
+		currentWorkerThread->m_localJobs->Push( job );
+
+		// the increment is a full fence, pairing with the one a worker makes before it goes to sleep
+		InterlockedIncrement( &s_numQueuedJobs );
+		if( s_numSleepingGenericWorkers > 0 )
 		{
-			for( unsigned int jobIndex = 0; jobIndex < jobsTodo.size(); ++jobIndex )
-			{
-				Job* job = jobsTodo[ jobIndex ];
-				if( returnJob == nullptr || returnJob < job )
-				{
-					returnJob = job;
-					todoListToEdit = jobTypeIndex;
-					jobPosition = jobIndex;
-				}
-			}
+			EnterCriticalSection( &s_cs );
+			WakeConditionVariable( &s_genericJobAdded );
+			LeaveCriticalSection( &s_cs );
 		}
+		return;
 	}
 
 	EnterCriticalSection( &s_cs );
-	std::vector< Job* > jobsTodo = s_jobsTodoByType[ todoListToEdit ];
-	if( jobsTodo.size() > 0 )
-		jobsTodo.erase( jobsTodo.begin() + jobPosition );
-	s_jobsTodoByType[ todoListToEdit ] = jobsTodo;
+	s_jobsTodoByType[ job->m_jobType ].Push( job, s_numJobsSubmitted++ );
+	InterlockedIncrement( &s_numQueuedJobs );
+	WakeWorkersForJob( job->m_jobType );
 	LeaveCriticalSection( &s_cs );
+}
 
-	return returnJob;
+
+//-----------------------------------------------------------------------------------------------
+STATIC void JobManager::WakeWorkersForJob( jobType typeOfJobAdded )
+{
+	WakeConditionVariable( &s_jobAddedByType[ typeOfJobAdded ] );
+	WakeConditionVariable( &s_genericJobAdded );
 }
 
 
 //-----------------------------------------------------------------------------------------------
-STATIC void JobManager::ReportCompletedJob( Job* job )
+STATIC Job* JobManager::GetJobFromTodoList( jobType typeOfJobToGet )
 {
+	Job* returnJob = nullptr;
+
 	EnterCriticalSection( &s_cs );
-	s_jobsCompleted.push_back( job );
+	returnJob = s_jobsTodoByType[ typeOfJobToGet ].Pop();
+	if( returnJob )
+		InterlockedDecrement( &s_numQueuedJobs );
 	LeaveCriticalSection( &s_cs );
+
+	return returnJob;
 }
 
 
 //-----------------------------------------------------------------------------------------------
-STATIC void JobManager::ChangeJobPriority( Job* job, priorityRating newPriority )
+//Every type shares one submission counter, so the deadlines at the front of each queue compare.
+STATIC Job* JobManager::GetJobOfAnyTypeFromTodoList()
 {
-	std::vector< Job* > jobsTodo;
+	Job* returnJob = nullptr;
+	JobPriorityQueue* queueToPopFrom = nullptr;
 
 	EnterCriticalSection( &s_cs );
-	jobsTodo = s_jobsTodoByType[ job->m_jobType ];
+	for( unsigned int jobTypeIndex = 0; jobTypeIndex < NUMBER_OF_JOB_TYPES; ++jobTypeIndex )
+	{
+		Job* dueJob = s_jobsTodoByType[ jobTypeIndex ].Peek();
+		if( dueJob != nullptr && ( returnJob == nullptr || JobPriorityQueue::IsDueBefore( dueJob, returnJob ) ) )
+		{
+			returnJob = dueJob;
+			queueToPopFrom = &s_jobsTodoByType[ jobTypeIndex ];
+		}
+	}
+
+	if( queueToPopFrom != nullptr )
+	{
+		queueToPopFrom->Pop();
+		InterlockedDecrement( &s_numQueuedJobs );
+	}
 	LeaveCriticalSection( &s_cs );
 
-	for( unsigned int jobIndex = 0; jobIndex < jobsTodo.size(); ++jobIndex )
+	return returnJob;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+STATIC Job* JobManager::GetJobForWorker( WorkerThread* workerThread )
+{
+	if( !workerThread->IsGeneric() )
+		return GetJobFromTodoList( workerThread->m_jobTypeToHandle );
+
+	Job* job = workerThread->m_localJobs->Pop();
+	if( job )
+	{
+		InterlockedDecrement( &s_numQueuedJobs );
+		return job;
+	}
+
+	if( s_numQueuedJobs == 0 )
+		return nullptr;
+
+	job = GetJobOfAnyTypeFromTodoList();
+	if( job )
+		return job;
+
+	return StealJob( workerThread );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+STATIC Job* JobManager::GetJobToHelpWith( WorkerThread* helper )
+{
+	if( helper->IsGeneric() )
+		return GetJobForWorker( helper );
+
+	Job* job = GetJobOfAnyTypeFromTodoList();
+	if( job )
+		return job;
+
+	return StealJob( helper );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+STATIC Job* JobManager::StealJob( WorkerThread* thief )
+{
+	LONG numGenericWorkerThreads = s_numGenericWorkerThreads;
+	if( numGenericWorkerThreads == 0 )
+		return nullptr;
+
+	unsigned int firstVictimIndex = ( thief != nullptr ) ? thief->GetNextRandomNumber() % numGenericWorkerThreads : 0;
+	for( LONG attemptIndex = 0; attemptIndex < numGenericWorkerThreads; ++attemptIndex )
 	{
-		Job* jobToChange = jobsTodo[ jobIndex ];
-		if( job == jobToChange )
+		WorkerThread* victim = s_genericWorkerThreads[ ( firstVictimIndex + attemptIndex ) % numGenericWorkerThreads ];
+		if( victim == thief )
+			continue;
+
+		Job* job = victim->m_localJobs->Steal();
+		if( job )
 		{
-			jobToChange->m_priority = newPriority;
-			break;
+			InterlockedDecrement( &s_numQueuedJobs );
+			if( thief != nullptr )
+				++thief->m_statistics.m_numJobsStolen;
+
+			return job;
 		}
 	}
 
+	return nullptr;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+//Returns false once the manager is shutting down. A steal that lost a race leaves the job count
+//above zero, so a generic worker returns straight away to look again instead of sleeping on it.
+STATIC bool JobManager::WaitForJob( WorkerThread* workerThread )
+{
 	EnterCriticalSection( &s_cs );
-	s_jobsTodoByType[ job->m_jobType ] = jobsTodo;
+	workerThread->m_status = OPEN;
+	if( workerThread->IsGeneric() )
+	{
+		InterlockedIncrement( &s_numSleepingGenericWorkers );
+		while( s_numQueuedJobs == 0 && !s_isShuttingDown )
+			SleepConditionVariableCS( &s_genericJobAdded, &s_cs, INFINITE );
+		InterlockedDecrement( &s_numSleepingGenericWorkers );
+	}
+	else
+	{
+		JobPriorityQueue& jobsTodo = s_jobsTodoByType[ workerThread->m_jobTypeToHandle ];
+		while( jobsTodo.IsEmpty() && !s_isShuttingDown )
+			SleepConditionVariableCS( &s_jobAddedByType[ workerThread->m_jobTypeToHandle ], &s_cs, INFINITE );
+	}
+
+	bool isRunning = !s_isShuttingDown;
 	LeaveCriticalSection( &s_cs );
 
-	
+	return isRunning;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+STATIC void JobManager::RunJob( Job* job )
+{
+	job->m_secondsWhenStarted = GetCurrentTimeSeconds();
+	JobTypeStatistics& statistics = s_jobTypeStatistics[ job->m_jobType ];
+	InterlockedDecrement( &statistics.m_numJobsQueued );
+	InterlockedIncrement( &statistics.m_numJobsStarted );
+	RecordJobTiming( statistics.m_waitTimes, job->m_secondsWhenStarted - job->m_secondsWhenQueued );
+
+	job->Execute();
+	ReportCompletedJob( job );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+//Only jobs with a completion counter take the lock, which WaitFor relies on to know the finishing
+//worker is done with the counter. Once pushed, the job belongs to the main thread; a job owned by
+//its waiter is never pushed, since the waiter may delete it as soon as the counter reaches zero.
+STATIC void JobManager::ReportCompletedJob( Job* job )
+{
+	job->m_secondsWhenCompleted = GetCurrentTimeSeconds();
+	RecordJobTiming( s_jobTypeStatistics[ job->m_jobType ].m_executeTimes, job->m_secondsWhenCompleted - job->m_secondsWhenStarted );
+	bool isOwnedByWaiter = job->m_isOwnedByWaiter;
+
+	JobCounter* completionCounter = job->m_completionCounter;
+	if( completionCounter != nullptr )
+	{
+		std::vector< Job* > jobsReleased;
+
+		EnterCriticalSection( &s_cs );
+		if( InterlockedDecrement( &completionCounter->m_numUnfinishedJobs ) == 0 )
+			ReleaseCounterWaiters( completionCounter, jobsReleased );
+		LeaveCriticalSection( &s_cs );
+
+		for( unsigned int jobIndex = 0; jobIndex < jobsReleased.size(); ++jobIndex )
+			QueueJob( jobsReleased[ jobIndex ] );
+	}
+
+	if( !isOwnedByWaiter )
+		s_jobsCompleted.Push( job );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+//Expects s_cs to be held. Fibers are made ready straight away; the jobs are handed back to be
+//queued once the lock is released.
+STATIC void JobManager::ReleaseCounterWaiters( JobCounter* counter, std::vector< Job* >& jobsReleased_out )
+{
+	jobsReleased_out.swap( counter->m_jobsWaiting );
+	for( unsigned int fiberIndex = 0; fiberIndex < counter->m_fibersWaiting.size(); ++fiberIndex )
+		MakeJobFiberReady( counter->m_fibersWaiting[ fiberIndex ] );
+
+	counter->m_fibersWaiting.clear();
+}
+
+
+//-----------------------------------------------------------------------------------------------
+//Jobs already sitting in a worker's own deque or running only have the new priority recorded.
+STATIC void JobManager::ChangeJobPriority( Job* job, priorityRating newPriority )
+{
+	EnterCriticalSection( &s_cs );
+	s_jobsTodoByType[ job->m_jobType ].ChangePriority( job, newPriority );
+	LeaveCriticalSection( &s_cs );
 }
 
 
 //-----------------------------------------------------------------------------------------------
 STATIC void JobManager::Update()
 {
+	if( !s_isStarted )
+		return;
+
 	if( s_workerThreads.size() == 0 )
 	{
 		Job* job = GetJobOfAnyTypeFromTodoList();
 		if( job )
-		{
-			job->Execute();
-			ReportCompletedJob( job );
-		}
+			RunJob( job );
 	}
 
-	EnterCriticalSection( &s_cs );
-	while( s_jobsCompleted.size() > 0 )
+	// at least one callback fires every frame, so even a zero budget keeps the queue moving
+	double secondsAtStart = GetCurrentTimeSeconds();
+	double secondsNow = secondsAtStart;
+	SignalDueTimers( secondsNow );
+	SampleQueueDepths();
+
+	do
 	{
-		Job* completedJob = s_jobsCompleted.front();
+		Job* completedJob = s_jobsCompleted.Pop();
+		if( completedJob == nullptr )
+			return;
+
 		completedJob->FireCallbackEvent();
+		secondsNow = GetCurrentTimeSeconds();
+		RecordLatency( completedJob, secondsNow );
 		delete completedJob;
-		completedJob = nullptr;
-		s_jobsCompleted.erase( s_jobsCompleted.begin() );
+	}
+	while( secondsNow - secondsAtStart < s_callbackBudgetSecondsPerFrame );
+
+	// the budget ran out, but the frame was only over it if callbacks are left for the next one
+	if( !s_jobsCompleted.IsEmpty() )
+		++s_latencyStatistics.m_numFramesOverBudget;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+//Returns nullptr once MAX_NUM_JOB_FIBERS exist, in which case the job runs on the worker thread.
+STATIC JobFiber* JobManager::CreateJobFiber()
+{
+	if( InterlockedIncrement( &s_numJobFibers ) > MAX_NUM_JOB_FIBERS )
+	{
+		InterlockedDecrement( &s_numJobFibers );
+		return nullptr;
+	}
+
+	JobFiber* jobFiber = new JobFiber();
+	jobFiber->m_job = nullptr;
+	jobFiber->m_state = FIBER_STATE_IDLE;
+	jobFiber->m_counterWaitedOn = nullptr;
+	jobFiber->m_fiber = CreateFiberEx( JOB_FIBER_STACK_COMMIT_SIZE_IN_BYTES, JOB_FIBER_STACK_RESERVE_SIZE_IN_BYTES, FIBER_FLAG_FLOAT_SWITCH, JobFiberEntryFunc, jobFiber );
+	if( jobFiber->m_fiber == nullptr )
+	{
+		delete jobFiber;
+		InterlockedDecrement( &s_numJobFibers );
+		return nullptr;
+	}
+
+	return jobFiber;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+STATIC void JobManager::DeleteJobFiber( JobFiber* jobFiber )
+{
+	DeleteFiber( jobFiber->m_fiber );
+	delete jobFiber;
+	InterlockedDecrement( &s_numJobFibers );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+STATIC bool JobManager::RunJobOnFiber( WorkerThread* workerThread, Job* job )
+{
+	JobFiber* jobFiber = nullptr;
+	if( !workerThread->m_freeJobFibers.empty() )
+	{
+		jobFiber = workerThread->m_freeJobFibers.back();
+		workerThread->m_freeJobFibers.pop_back();
+	}
+	else
+	{
+		jobFiber = CreateJobFiber();
+		if( jobFiber == nullptr )
+			return false;
+	}
+
+	jobFiber->m_job = job;
+	SwitchToJobFiber( workerThread, jobFiber );
+	return true;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+STATIC void JobManager::SwitchToJobFiber( WorkerThread* workerThread, JobFiber* jobFiber )
+{
+	jobFiber->m_state = FIBER_STATE_RUNNING;
+	workerThread->m_currentJobFiber = jobFiber;
+	SwitchToFiber( jobFiber->m_fiber );
+	workerThread->m_currentJobFiber = nullptr;
+
+	if( jobFiber->m_state == FIBER_STATE_WAITING )
+	{
+		ParkJobFiber( jobFiber );
+	}
+	else
+	{
+		jobFiber->m_state = FIBER_STATE_IDLE;
+		workerThread->m_freeJobFibers.push_back( jobFiber );
+	}
+}
+
+
+//-----------------------------------------------------------------------------------------------
+//Called from the scheduler fiber after the waiting fiber has switched away, so no other worker
+//can resume it while it is still running.
+STATIC void JobManager::ParkJobFiber( JobFiber* jobFiber )
+{
+	EnterCriticalSection( &s_cs );
+	JobCounter* counterWaitedOn = jobFiber->m_counterWaitedOn;
+	if( counterWaitedOn->m_numUnfinishedJobs == 0 )
+		MakeJobFiberReady( jobFiber );
+	else
+		counterWaitedOn->m_fibersWaiting.push_back( jobFiber );
+	LeaveCriticalSection( &s_cs );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+//Expects s_cs to be held.
+STATIC void JobManager::MakeJobFiberReady( JobFiber* jobFiber )
+{
+	s_readyJobFibers.push_back( jobFiber );
+	InterlockedIncrement( &s_numReadyJobFibers );
+	InterlockedIncrement( &s_numQueuedJobs );
+	WakeConditionVariable( &s_genericJobAdded );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+STATIC JobFiber* JobManager::GetReadyJobFiber()
+{
+	if( s_numReadyJobFibers == 0 )
+		return nullptr;
+
+	JobFiber* readyJobFiber = nullptr;
+
+	EnterCriticalSection( &s_cs );
+	if( !s_readyJobFibers.empty() )
+	{
+		readyJobFiber = s_readyJobFibers.front();
+		s_readyJobFibers.pop_front();
+		InterlockedDecrement( &s_numReadyJobFibers );
+		InterlockedDecrement( &s_numQueuedJobs );
 	}
 	LeaveCriticalSection( &s_cs );
+
+	return readyJobFiber;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+STATIC void JobManager::RecordLatency( const Job* finishedJob, double secondsNow )
+{
+	double secondsAddedToCallback = secondsNow - finishedJob->m_secondsWhenAdded;
+	double secondsCompletedToCallback = secondsNow - finishedJob->m_secondsWhenCompleted;
+
+	++s_latencyStatistics.m_numJobsFinished;
+	s_latencyStatistics.m_totalSecondsAddedToCallback += secondsAddedToCallback;
+	s_latencyStatistics.m_totalSecondsCompletedToCallback += secondsCompletedToCallback;
+	if( secondsAddedToCallback > s_latencyStatistics.m_maxSecondsAddedToCallback )
+		s_latencyStatistics.m_maxSecondsAddedToCallback = secondsAddedToCallback;
+	if( secondsCompletedToCallback > s_latencyStatistics.m_maxSecondsCompletedToCallback )
+		s_latencyStatistics.m_maxSecondsCompletedToCallback = secondsCompletedToCallback;
+
+	RecordJobTiming( s_jobTypeStatistics[ finishedJob->m_jobType ].m_callbackLatencies, secondsCompletedToCallback );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+STATIC void JobManager::SampleQueueDepths()
+{
+	for( unsigned int jobTypeIndex = 0; jobTypeIndex < NUMBER_OF_JOB_TYPES; ++jobTypeIndex )
+	{
+		JobTypeStatistics& statistics = s_jobTypeStatistics[ jobTypeIndex ];
+		LONG numJobsQueued = statistics.m_numJobsQueued;
+		if( numJobsQueued > statistics.m_maxNumJobsQueued )
+			statistics.m_maxNumJobsQueued = numJobsQueued;
+	}
+}
+
+
+//-----------------------------------------------------------------------------------------------
+//Workers keep counting into their own statistics; a reset only snapshots them, so the figures
+//reported are always since the last reset. The live queue depths are left alone.
+STATIC void JobManager::ResetStatistics()
+{
+	memset( &s_latencyStatistics, 0, sizeof( s_latencyStatistics ) );
+	for( unsigned int jobTypeIndex = 0; jobTypeIndex < NUMBER_OF_JOB_TYPES; ++jobTypeIndex )
+	{
+		JobTypeStatistics& statistics = s_jobTypeStatistics[ jobTypeIndex ];
+		statistics.m_maxNumJobsQueued = statistics.m_numJobsQueued;
+		statistics.m_numJobsStarted = 0;
+		memset( &statistics.m_waitTimes, 0, sizeof( statistics.m_waitTimes ) );
+		memset( &statistics.m_executeTimes, 0, sizeof( statistics.m_executeTimes ) );
+		memset( &statistics.m_callbackLatencies, 0, sizeof( statistics.m_callbackLatencies ) );
+	}
+
+	for( unsigned int workerIndex = 0; workerIndex < s_workerThreads.size(); ++workerIndex )
+		s_workerThreads[ workerIndex ]->m_statisticsAtReset = s_workerThreads[ workerIndex ]->m_statistics;
+
+	s_secondsWhenStatisticsReset = GetCurrentTimeSeconds();
+}
+
+
+//-----------------------------------------------------------------------------------------------
+//Percentiles are bucket upper bounds in microseconds.
+STATIC void JobManager::GetStatisticsReport( std::vector< std::string >& reportLines_out )
+{
+	for( unsigned int jobTypeIndex = 0; jobTypeIndex < NUMBER_OF_JOB_TYPES; ++jobTypeIndex )
+	{
+		const JobTypeStatistics& statistics = s_jobTypeStatistics[ jobTypeIndex ];
+		if( statistics.m_numJobsStarted == 0 && statistics.m_numJobsQueued == 0 )
+			continue;
+
+		reportLines_out.push_back( std::string( GetJobTypeName( (jobType) jobTypeIndex ) ) + " jobs  queued: " + ConvertNumberToString( (int) statistics.m_numJobsQueued ) + " (max " + ConvertNumberToString( (int) statistics.m_maxNumJobsQueued ) + ")  started: " + ConvertNumberToString( (int) statistics.m_numJobsStarted ) );
+		reportLines_out.push_back( "  wait us p50/p99: " + ConvertNumberToString( (int) GetJobTimingPercentileMicroseconds( statistics.m_waitTimes, 0.5 ) ) + "/" + ConvertNumberToString( (int) GetJobTimingPercentileMicroseconds( statistics.m_waitTimes, 0.99 ) ) + "  run: " + ConvertNumberToString( (int) GetJobTimingPercentileMicroseconds( statistics.m_executeTimes, 0.5 ) ) + "/" + ConvertNumberToString( (int) GetJobTimingPercentileMicroseconds( statistics.m_executeTimes, 0.99 ) ) + "  callback: " + ConvertNumberToString( (int) GetJobTimingPercentileMicroseconds( statistics.m_callbackLatencies, 0.5 ) ) + "/" + ConvertNumberToString( (int) GetJobTimingPercentileMicroseconds( statistics.m_callbackLatencies, 0.99 ) ) );
+	}
+
+	double secondsSinceReset = GetCurrentTimeSeconds() - s_secondsWhenStatisticsReset;
+	for( unsigned int workerIndex = 0; workerIndex < s_workerThreads.size(); ++workerIndex )
+	{
+		const WorkerThread* workerThread = s_workerThreads[ workerIndex ];
+		double secondsBusy = workerThread->m_statistics.m_secondsBusy - workerThread->m_statisticsAtReset.m_secondsBusy;
+		double percentBusy = ( secondsSinceReset > 0.0 ) ? 100.0 * secondsBusy / secondsSinceReset : 0.0;
+		reportLines_out.push_back( "worker " + ConvertNumberToString( (int) workerIndex ) + " (" + GetJobTypeName( workerThread->m_jobTypeToHandle ) + ")  busy %: " + ConvertNumberToString( percentBusy ) + "  jobs: " + ConvertNumberToString( (int) ( workerThread->m_statistics.m_numJobsRun - workerThread->m_statisticsAtReset.m_numJobsRun ) ) + "  stolen: " + ConvertNumberToString( (int) ( workerThread->m_statistics.m_numJobsStolen - workerThread->m_statisticsAtReset.m_numJobsStolen ) ) );
+	}
+}
+
+
+//-----------------------------------------------------------------------------------------------
+STATIC bool JobManager::DumpStatisticsToFile( const char* filePath )
+{
+	FILE* file = nullptr;
+	errno_t fileOpenError = fopen_s( &file, filePath, "w" );
+	if( fileOpenError )
+		return false;
+
+	double secondsSinceReset = GetCurrentTimeSeconds() - s_secondsWhenStatisticsReset;
+	fprintf( file, "seconds since reset,%f\n", secondsSinceReset );
+	fprintf( file, "job type,measure,queued,max queued,started,total us" );
+	for( unsigned int bucketIndex = 0; bucketIndex < NUM_JOB_TIMING_BUCKETS; ++bucketIndex )
+		fprintf( file, ",<%u", 1U << bucketIndex );
+	fprintf( file, "\n" );
+
+	for( unsigned int jobTypeIndex = 0; jobTypeIndex < NUMBER_OF_JOB_TYPES; ++jobTypeIndex )
+	{
+		const JobTypeStatistics& statistics = s_jobTypeStatistics[ jobTypeIndex ];
+		const JobTimingHistogram* histograms[] = { &statistics.m_waitTimes, &statistics.m_executeTimes, &statistics.m_callbackLatencies };
+		const char* measureNames[] = { "wait", "execute", "callback" };
+		for( unsigned int histogramIndex = 0; histogramIndex < 3; ++histogramIndex )
+		{
+			fprintf( file, "%s,%s,%ld,%ld,%ld,%lld", GetJobTypeName( (jobType) jobTypeIndex ), measureNames[ histogramIndex ], statistics.m_numJobsQueued, statistics.m_maxNumJobsQueued, statistics.m_numJobsStarted, histograms[ histogramIndex ]->m_totalMicroseconds );
+			for( unsigned int bucketIndex = 0; bucketIndex < NUM_JOB_TIMING_BUCKETS; ++bucketIndex )
+				fprintf( file, ",%ld", histograms[ histogramIndex ]->m_bucketCounts[ bucketIndex ] );
+			fprintf( file, "\n" );
+		}
+	}
+
+	fprintf( file, "worker,job type,busy seconds,jobs run,jobs stolen\n" );
+	for( unsigned int workerIndex = 0; workerIndex < s_workerThreads.size(); ++workerIndex )
+	{
+		const WorkerThread* workerThread = s_workerThreads[ workerIndex ];
+		fprintf( file, "%u,%s,%f,%u,%u\n", workerIndex, GetJobTypeName( workerThread->m_jobTypeToHandle ), workerThread->m_statistics.m_secondsBusy - workerThread->m_statisticsAtReset.m_secondsBusy, workerThread->m_statistics.m_numJobsRun - workerThread->m_statisticsAtReset.m_numJobsRun, workerThread->m_statistics.m_numJobsStolen - workerThread->m_statisticsAtReset.m_numJobsStolen );
+	}
+
+	fclose( file );
+	return true;
 }
\ No newline at end of file
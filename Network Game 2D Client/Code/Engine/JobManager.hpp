@@ -3,37 +3,140 @@
 #pragma once
 
 //-----------------------------------------------------------------------------------------------
-#include <queue>
+#include <deque>
+#include <string>
 #include <vector>
 #include <windows.h>
 #include "Job.hpp"
+#include "JobStatistics.hpp"
+#include "JobPriorityQueue.hpp"
+#include "JobCompletionQueue.hpp"
 #include "WorkerThread.hpp"
 
 
 //-----------------------------------------------------------------------------------------------
-void WorkerThreadEntryFunc( void* data );
+const unsigned int MAX_NUM_GENERIC_WORKER_THREADS = 64;
+const double DEFAULT_CALLBACK_BUDGET_SECONDS_PER_FRAME = 0.002;
 
 
 //-----------------------------------------------------------------------------------------------
+//Added to callback covers the whole life of a job, including any wait on prerequisites; completed
+//to callback is how long a finished job sat in the completion queue before the main thread got
+//to it. A frame over budget left completions in the queue for the next frame.
+struct JobLatencyStatistics
+{
+	unsigned int	m_numJobsFinished;
+	unsigned int	m_numFramesOverBudget;
+	double			m_totalSecondsAddedToCallback;
+	double			m_maxSecondsAddedToCallback;
+	double			m_totalSecondsCompletedToCallback;
+	double			m_maxSecondsCompletedToCallback;
+};
+
+
+//-----------------------------------------------------------------------------------------------
+struct JobTimer
+{
+	double			m_secondsWhenDue;
+	JobCounter*		m_counter;
+};
+
+
+//-----------------------------------------------------------------------------------------------
+unsigned int __stdcall WorkerThreadEntryFunc( void* data );
+void __stdcall JobFiberEntryFunc( void* data );
+
+
+//-----------------------------------------------------------------------------------------------
+//Jobs added from a generic worker go on that worker's own deque, everything else is injected
+//into a priority queue per job type. Generic workers drain their own deque, then the injection
+//queues, then steal from each other; workers with nothing to do sleep until a job is added.
+//Completion counters chain stages without going back through the main thread: a job added with
+//a counter holds it above zero until it finishes, including any jobs it adds to the same counter
+//while it runs, and jobs added after that counter are only queued once it reaches zero.
+//Workers hand finished jobs to the main thread through a lock free queue that Update drains,
+//firing callbacks until the per frame budget runs out. When started with fibers, generic workers
+//run each job on a pooled fiber so that WaitFor suspends the job instead of the worker thread.
+//Timers are signalled from Update, so only jobs may wait on them, never the main thread. Threads
+//that are not workers never run other jobs while they wait, since those may wait on timers too.
 class JobManager
 {
 public:
-	JobManager();
+	static void Startup( unsigned int numWorkerThreads = 0, bool shouldRunJobsOnFibers = false );
+	static void Shutdown();
 	static void CreateNewWorkerThread();
 	static void CreateNewWorkerThread( jobType jobTypeToHandle );
 	static void AddNewJob( Job* job );
+	static void AddNewJob( Job* job, JobCounter* completionCounter );
+	static void AddNewJobAfter( Job* job, JobCounter* prerequisiteCounter, JobCounter* completionCounter = nullptr );
+	static void WaitFor( JobCounter* counter );
+	static bool RunQueuedJob( Job* job );
+	static void AwaitJob( Job* job );
+	static void AwaitSeconds( double seconds );
+	static bool IsWorkerThread();
+	static bool SignalCounter( JobCounter* counter );
+	static void AddTimer( JobCounter* counter, double secondsBeforeSignal );
+	static void CancelTimer( JobCounter* counter );
+	static unsigned int GetNumGenericWorkerThreads() { return s_isStarted ? (unsigned int) s_numGenericWorkerThreads : 0; }
 	static Job* GetJobFromTodoList( jobType typeOfJobToGet );
 	static Job* GetJobOfAnyTypeFromTodoList();
 	static void ReportCompletedJob( Job* job );
 	static void ChangeJobPriority( Job* job, priorityRating newPriority );
 	static void Update();
+	static void SetCallbackBudgetSecondsPerFrame( double callbackBudgetSeconds ) { s_callbackBudgetSecondsPerFrame = callbackBudgetSeconds; }
+	static const JobLatencyStatistics& GetLatencyStatistics() { return s_latencyStatistics; }
+	static const JobTypeStatistics& GetJobTypeStatistics( jobType type ) { return s_jobTypeStatistics[ type ]; }
+	static void ResetStatistics();
+	static void GetStatisticsReport( std::vector< std::string >& reportLines_out );
+	static bool DumpStatisticsToFile( const char* filePath );
 
 	static CRITICAL_SECTION					s_cs;
 
-//private:
-	static std::vector< Job* >				s_jobsTodoByType[ NUMBER_OF_JOB_TYPES ];
-	static std::vector< Job* >				s_jobsCompleted;
+private:
+	friend unsigned int __stdcall WorkerThreadEntryFunc( void* data );
+	friend void __stdcall JobFiberEntryFunc( void* data );
+
+	static Job* GetJobForWorker( WorkerThread* workerThread );
+	static bool WaitForJob( WorkerThread* workerThread );
+	static void StartWorkerThread( WorkerThread* workerThread );
+	static void QueueJob( Job* job );
+	static void RunJob( Job* job );
+	static Job* GetJobToHelpWith( WorkerThread* helper );
+	static Job* StealJob( WorkerThread* thief );
+	static void WakeWorkersForJob( jobType typeOfJobAdded );
+	static void RecordLatency( const Job* finishedJob, double secondsNow );
+	static void ReleaseCounterWaiters( JobCounter* counter, std::vector< Job* >& jobsReleased_out );
+	static void SignalDueTimers( double secondsNow );
+	static void SampleQueueDepths();
+	static JobFiber* CreateJobFiber();
+	static void DeleteJobFiber( JobFiber* jobFiber );
+	static bool RunJobOnFiber( WorkerThread* workerThread, Job* job );
+	static void SwitchToJobFiber( WorkerThread* workerThread, JobFiber* jobFiber );
+	static void ParkJobFiber( JobFiber* jobFiber );
+	static void MakeJobFiberReady( JobFiber* jobFiber );
+	static JobFiber* GetReadyJobFiber();
+
+	static bool								s_isStarted;
+	static volatile bool					s_isShuttingDown;
+	static bool								s_areJobsRunOnFibers;
+	static volatile LONG					s_numQueuedJobs;
+	static volatile LONG					s_numSleepingGenericWorkers;
+	static CONDITION_VARIABLE				s_genericJobAdded;
+	static CONDITION_VARIABLE				s_jobAddedByType[ NUMBER_OF_JOB_TYPES ];
+	static unsigned int						s_numJobsSubmitted;
+	static JobPriorityQueue					s_jobsTodoByType[ NUMBER_OF_JOB_TYPES ];
+	static JobCompletionQueue				s_jobsCompleted;
+	static double							s_callbackBudgetSecondsPerFrame;
+	static JobLatencyStatistics				s_latencyStatistics;
+	static JobTypeStatistics				s_jobTypeStatistics[ NUMBER_OF_JOB_TYPES ];
+	static double							s_secondsWhenStatisticsReset;
 	static std::vector< WorkerThread* >		s_workerThreads;
+	static WorkerThread*					s_genericWorkerThreads[ MAX_NUM_GENERIC_WORKER_THREADS ];
+	static volatile LONG					s_numGenericWorkerThreads;
+	static std::deque< JobFiber* >			s_readyJobFibers;
+	static volatile LONG					s_numReadyJobFibers;
+	static volatile LONG					s_numJobFibers;
+	static std::vector< JobTimer >			s_timers;
 };
 
 
@@ -0,0 +1,153 @@
+#include "JobPriorityQueue.hpp"
+#include "EngineCommon.hpp"
+#include "NewMacroDef.hpp"
+
+
+//-----------------------------------------------------------------------------------------------
+void JobPriorityQueue::Push( Job* job, unsigned int submissionNumber )
+{
+	job->m_submissionNumber = submissionNumber;
+	job->m_deadline = CalculateDeadline( submissionNumber, job->m_priority );
+
+	m_heap.push_back( job );
+	job->m_queueIndex = (unsigned int) m_heap.size() - 1;
+	SiftUp( job->m_queueIndex );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+Job* JobPriorityQueue::Pop()
+{
+	if( m_heap.empty() )
+		return nullptr;
+
+	Job* dueJob = m_heap.front();
+	Job* lastJob = m_heap.back();
+	m_heap.pop_back();
+
+	if( lastJob != dueJob )
+	{
+		PlaceJob( lastJob, 0 );
+		SiftDown( 0 );
+	}
+
+	dueJob->m_queueIndex = INVALID_JOB_QUEUE_INDEX;
+	return dueJob;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+bool JobPriorityQueue::Remove( Job* job )
+{
+	if( !Contains( job ) )
+		return false;
+
+	unsigned int heapIndex = job->m_queueIndex;
+	Job* lastJob = m_heap.back();
+	m_heap.pop_back();
+
+	if( lastJob != job )
+	{
+		PlaceJob( lastJob, heapIndex );
+		SiftUp( heapIndex );
+		SiftDown( lastJob->m_queueIndex );
+	}
+
+	job->m_queueIndex = INVALID_JOB_QUEUE_INDEX;
+	return true;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void JobPriorityQueue::ChangePriority( Job* job, priorityRating newPriority )
+{
+	job->m_priority = newPriority;
+	if( !Contains( job ) )
+		return;
+
+	// the deadline keeps counting from the original submission, so a job does not lose its age
+	unsigned int oldDeadline = job->m_deadline;
+	job->m_deadline = CalculateDeadline( job->m_submissionNumber, newPriority );
+
+	if( (int) ( job->m_deadline - oldDeadline ) < 0 )
+		SiftUp( job->m_queueIndex );
+	else
+		SiftDown( job->m_queueIndex );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+bool JobPriorityQueue::Contains( const Job* job ) const
+{
+	return job->m_queueIndex < m_heap.size() && m_heap[ job->m_queueIndex ] == job;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+//Submission numbers wrap, so deadlines are compared by their signed difference.
+STATIC bool JobPriorityQueue::IsDueBefore( const Job* first, const Job* second )
+{
+	int deadlineDifference = (int) ( first->m_deadline - second->m_deadline );
+	if( deadlineDifference != 0 )
+		return deadlineDifference < 0;
+
+	return (int) ( first->m_submissionNumber - second->m_submissionNumber ) < 0;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+STATIC unsigned int JobPriorityQueue::CalculateDeadline( unsigned int submissionNumber, priorityRating priority )
+{
+	return submissionNumber + ( HIGH_PRIORITY - priority ) * JOB_PRIORITY_AGING_STEP;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void JobPriorityQueue::SiftUp( unsigned int heapIndex )
+{
+	Job* job = m_heap[ heapIndex ];
+	while( heapIndex > 0 )
+	{
+		unsigned int parentIndex = ( heapIndex - 1 ) / 2;
+		if( !IsDueBefore( job, m_heap[ parentIndex ] ) )
+			break;
+
+		PlaceJob( m_heap[ parentIndex ], heapIndex );
+		heapIndex = parentIndex;
+	}
+
+	PlaceJob( job, heapIndex );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void JobPriorityQueue::SiftDown( unsigned int heapIndex )
+{
+	Job* job = m_heap[ heapIndex ];
+	unsigned int numJobs = (unsigned int) m_heap.size();
+	while( true )
+	{
+		unsigned int childIndex = heapIndex * 2 + 1;
+		if( childIndex >= numJobs )
+			break;
+
+		if( childIndex + 1 < numJobs && IsDueBefore( m_heap[ childIndex + 1 ], m_heap[ childIndex ] ) )
+			++childIndex;
+
+		if( !IsDueBefore( m_heap[ childIndex ], job ) )
+			break;
+
+		PlaceJob( m_heap[ childIndex ], heapIndex );
+		heapIndex = childIndex;
+	}
+
+	PlaceJob( job, heapIndex );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void JobPriorityQueue::PlaceJob( Job* job, unsigned int heapIndex )
+{
+	m_heap[ heapIndex ] = job;
+	job->m_queueIndex = heapIndex;
+}
\ No newline at end of file
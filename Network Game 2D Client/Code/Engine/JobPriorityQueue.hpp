@@ -0,0 +1,43 @@
+#ifndef include_JobPriorityQueue
+#define include_JobPriorityQueue
+#pragma once
+
+//-----------------------------------------------------------------------------------------------
+#include <vector>
+#include "Job.hpp"
+
+
+//-----------------------------------------------------------------------------------------------
+const unsigned int JOB_PRIORITY_AGING_STEP = 64;
+
+
+//-----------------------------------------------------------------------------------------------
+//Binary min-heap on each job's deadline: its submission number pushed back by
+//JOB_PRIORITY_AGING_STEP for every priority level below HIGH_PRIORITY. Jobs of equal priority
+//come out in submission order, and no job is overtaken by more than JOB_PRIORITY_AGING_STEP
+//newer jobs per level of priority they have over it, so low priority work cannot starve. Jobs
+//remember their slot in the heap, which makes changing a queued job's priority O(log n).
+class JobPriorityQueue
+{
+public:
+	void Push( Job* job, unsigned int submissionNumber );
+	Job* Pop();
+	bool Remove( Job* job );
+	Job* Peek() const { return m_heap.empty() ? nullptr : m_heap.front(); }
+	void ChangePriority( Job* job, priorityRating newPriority );
+	bool Contains( const Job* job ) const;
+	bool IsEmpty() const { return m_heap.empty(); }
+	size_t GetSize() const { return m_heap.size(); }
+	static bool IsDueBefore( const Job* first, const Job* second );
+
+private:
+	static unsigned int CalculateDeadline( unsigned int submissionNumber, priorityRating priority );
+	void SiftUp( unsigned int heapIndex );
+	void SiftDown( unsigned int heapIndex );
+	void PlaceJob( Job* job, unsigned int heapIndex );
+
+	std::vector< Job* >		m_heap;
+};
+
+
+#endif // include_JobPriorityQueue
\ No newline at end of file
@@ -0,0 +1,61 @@
+#include "JobStatistics.hpp"
+#include "NewMacroDef.hpp"
+
+
+//-----------------------------------------------------------------------------------------------
+void RecordJobTiming( JobTimingHistogram& histogram, double seconds )
+{
+	LONGLONG microseconds = ( seconds > 0.0 ) ? (LONGLONG) ( seconds * 1000000.0 ) : 0;
+
+	unsigned int bucketIndex = 0;
+	for( LONGLONG remainingMicroseconds = microseconds; remainingMicroseconds != 0 && bucketIndex < NUM_JOB_TIMING_BUCKETS - 1; remainingMicroseconds >>= 1 )
+		++bucketIndex;
+
+	InterlockedIncrement( &histogram.m_bucketCounts[ bucketIndex ] );
+	InterlockedExchangeAdd64( &histogram.m_totalMicroseconds, microseconds );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+unsigned int GetNumJobTimingSamples( const JobTimingHistogram& histogram )
+{
+	unsigned int numSamples = 0;
+	for( unsigned int bucketIndex = 0; bucketIndex < NUM_JOB_TIMING_BUCKETS; ++bucketIndex )
+		numSamples += histogram.m_bucketCounts[ bucketIndex ];
+
+	return numSamples;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+//Only as exact as the buckets: returns the upper bound of the bucket the percentile falls in.
+double GetJobTimingPercentileMicroseconds( const JobTimingHistogram& histogram, double fraction )
+{
+	unsigned int numSamples = GetNumJobTimingSamples( histogram );
+	if( numSamples == 0 )
+		return 0.0;
+
+	double numSamplesAtOrBelow = fraction * numSamples;
+	unsigned int numSamplesSoFar = 0;
+	for( unsigned int bucketIndex = 0; bucketIndex < NUM_JOB_TIMING_BUCKETS; ++bucketIndex )
+	{
+		numSamplesSoFar += histogram.m_bucketCounts[ bucketIndex ];
+		if( numSamplesSoFar >= numSamplesAtOrBelow )
+			return (double) ( 1U << bucketIndex );
+	}
+
+	return (double) ( 1U << ( NUM_JOB_TIMING_BUCKETS - 1 ) );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+const char* GetJobTypeName( jobType type )
+{
+	switch( type )
+	{
+		case JOB_TYPE_UNDEFINED:			return "generic";
+		case JOB_TYPE_FILE_IO:				return "file io";
+		case JOB_TYPE_HASH_ENCRYPTION:		return "hash";
+		default:							return "unknown";
+	}
+}
\ No newline at end of file
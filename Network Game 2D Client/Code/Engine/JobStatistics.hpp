@@ -0,0 +1,57 @@
+#ifndef include_JobStatistics
+#define include_JobStatistics
+#pragma once
+
+//-----------------------------------------------------------------------------------------------
+#include <windows.h>
+#include "Job.hpp"
+
+
+//-----------------------------------------------------------------------------------------------
+const unsigned int NUM_JOB_TIMING_BUCKETS = 20;
+const char* const DEFAULT_JOB_STATISTICS_FILE_PATH = "JobStatistics.csv";
+
+
+//-----------------------------------------------------------------------------------------------
+//Bucket 0 counts times under a microsecond, bucket N times from 2^(N-1) up to 2^N microseconds,
+//and the last one collects everything slower. Workers record into it with interlocked adds only.
+struct JobTimingHistogram
+{
+	volatile LONG		m_bucketCounts[ NUM_JOB_TIMING_BUCKETS ];
+	volatile LONGLONG	m_totalMicroseconds;
+};
+
+
+//-----------------------------------------------------------------------------------------------
+//Waits run from the job being queued, which is after its prerequisites finished, to a worker
+//starting it. Execute times include any time a fiber job spent suspended in WaitFor. The queue
+//depth is live; its maximum is only sampled once a frame by JobManager::Update.
+struct JobTypeStatistics
+{
+	volatile LONG		m_numJobsQueued;
+	LONG				m_maxNumJobsQueued;
+	volatile LONG		m_numJobsStarted;
+	JobTimingHistogram	m_waitTimes;
+	JobTimingHistogram	m_executeTimes;
+	JobTimingHistogram	m_callbackLatencies;
+};
+
+
+//-----------------------------------------------------------------------------------------------
+//Only ever written by the worker it belongs to.
+struct WorkerThreadStatistics
+{
+	double			m_secondsBusy;
+	unsigned int	m_numJobsRun;
+	unsigned int	m_numJobsStolen;
+};
+
+
+//-----------------------------------------------------------------------------------------------
+void RecordJobTiming( JobTimingHistogram& histogram, double seconds );
+unsigned int GetNumJobTimingSamples( const JobTimingHistogram& histogram );
+double GetJobTimingPercentileMicroseconds( const JobTimingHistogram& histogram, double fraction );
+const char* GetJobTypeName( jobType type );
+
+
+#endif // include_JobStatistics
\ No newline at end of file
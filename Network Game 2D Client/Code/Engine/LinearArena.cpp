@@ -0,0 +1,68 @@
+#include "LinearArena.hpp"
+#include "NewMacroDef.hpp"
+
+
+//-----------------------------------------------------------------------------------------------
+STATIC LinearArena* FrameAllocator::s_frameArenas[ 2 ] = { nullptr, nullptr };
+STATIC LinearArena* FrameAllocator::s_scratchStack = nullptr;
+STATIC unsigned int FrameAllocator::s_currentFrameArenaIndex = 0;
+
+
+//-----------------------------------------------------------------------------------------------
+LinearArena::LinearArena( size_t capacityInBytes )
+	: m_buffer( new byte_t[ capacityInBytes ] )
+	, m_capacityInBytes( capacityInBytes )
+	, m_numBytesUsed( 0 )
+	, m_highWaterMark( 0 )
+{
+
+}
+
+
+//-----------------------------------------------------------------------------------------------
+LinearArena::~LinearArena()
+{
+	delete[] m_buffer;
+	m_buffer = nullptr;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+STATIC void FrameAllocator::SwapFrames()
+{
+	s_currentFrameArenaIndex = 1 - s_currentFrameArenaIndex;
+	GetCurrentFrameArena().Reset();
+}
+
+
+//-----------------------------------------------------------------------------------------------
+STATIC void FrameAllocator::Shutdown()
+{
+	delete s_frameArenas[ 0 ];
+	delete s_frameArenas[ 1 ];
+	delete s_scratchStack;
+	s_frameArenas[ 0 ] = nullptr;
+	s_frameArenas[ 1 ] = nullptr;
+	s_scratchStack = nullptr;
+	s_currentFrameArenaIndex = 0;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+STATIC LinearArena& FrameAllocator::GetCurrentFrameArena()
+{
+	if( s_frameArenas[ s_currentFrameArenaIndex ] == nullptr )
+		s_frameArenas[ s_currentFrameArenaIndex ] = new LinearArena( FRAME_ARENA_SIZE_IN_BYTES );
+
+	return *s_frameArenas[ s_currentFrameArenaIndex ];
+}
+
+
+//-----------------------------------------------------------------------------------------------
+STATIC LinearArena& FrameAllocator::GetScratchStack()
+{
+	if( s_scratchStack == nullptr )
+		s_scratchStack = new LinearArena( SCRATCH_STACK_SIZE_IN_BYTES );
+
+	return *s_scratchStack;
+}
\ No newline at end of file
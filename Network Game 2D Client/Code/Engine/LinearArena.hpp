@@ -0,0 +1,189 @@
+#ifndef include_LinearArena
+#define include_LinearArena
+#pragma once
+
+//-----------------------------------------------------------------------------------------------
+#include <new>
+#include <limits>
+#include <string>
+#include <vector>
+#include <stddef.h>
+#include "EngineCommon.hpp"
+#include "MemoryManager.hpp"
+
+
+//-----------------------------------------------------------------------------------------------
+const size_t FRAME_ARENA_SIZE_IN_BYTES = 1024 * 1024;
+const size_t SCRATCH_STACK_SIZE_IN_BYTES = 1024 * 256;
+
+
+//-----------------------------------------------------------------------------------------------
+//A bump allocator over one fixed buffer. Individual allocations are never freed; the whole arena is
+//reset at once, or rewound to a marker taken earlier so that it can be used as a stack.
+class LinearArena
+{
+public:
+	LinearArena( size_t capacityInBytes );
+	~LinearArena();
+	void* Allocate( size_t numBytes, size_t alignment = MEMORY_ALIGNMENT );
+	void Reset() { m_numBytesUsed = 0; }
+	size_t GetMarker() const { return m_numBytesUsed; }
+	void RewindToMarker( size_t marker ) { m_numBytesUsed = marker; }
+	bool Owns( const void* data ) const { return data >= m_buffer && data < m_buffer + m_capacityInBytes; }
+	size_t GetNumBytesUsed() const { return m_numBytesUsed; }
+	size_t GetHighWaterMark() const { return m_highWaterMark; }
+	size_t GetCapacity() const { return m_capacityInBytes; }
+
+private:
+	LinearArena( const LinearArena& );
+	void operator=( const LinearArena& );
+
+	byte_t*		m_buffer;
+	size_t		m_capacityInBytes;
+	size_t		m_numBytesUsed;
+	size_t		m_highWaterMark;
+};
+
+
+//-----------------------------------------------------------------------------------------------
+inline void* LinearArena::Allocate( size_t numBytes, size_t alignment )
+{
+	// the buffer itself is only aligned to what the heap gives, so align the address, not the offset
+	uintptr_t nextAddress = reinterpret_cast< uintptr_t >( m_buffer + m_numBytesUsed );
+	uintptr_t alignedAddress = ( nextAddress + alignment - 1 ) & ~( (uintptr_t) alignment - 1 );
+	size_t alignedOffset = (size_t) ( alignedAddress - reinterpret_cast< uintptr_t >( m_buffer ) );
+	if( alignedOffset + numBytes > m_capacityInBytes )
+		return nullptr;
+
+	m_numBytesUsed = alignedOffset + numBytes;
+	if( m_numBytesUsed > m_highWaterMark )
+		m_highWaterMark = m_numBytesUsed;
+
+	return m_buffer + alignedOffset;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+class ScopedArenaMarker
+{
+public:
+	ScopedArenaMarker( LinearArena& arena ) : m_arena( arena ), m_marker( arena.GetMarker() ) {}
+	~ScopedArenaMarker() { m_arena.RewindToMarker( m_marker ); }
+
+private:
+	void operator=( const ScopedArenaMarker& );
+
+	LinearArena&	m_arena;
+	size_t			m_marker;
+};
+
+
+//-----------------------------------------------------------------------------------------------
+//Main thread only. Frame memory stays valid until the end of the frame after the one it was
+//allocated in. The scratch stack is for temporaries that die with a ScopedArenaMarker.
+class FrameAllocator
+{
+public:
+	static void* Allocate( size_t numBytes, size_t alignment = MEMORY_ALIGNMENT );
+	static void SwapFrames();
+	static void Shutdown();
+	static LinearArena& GetCurrentFrameArena();
+	static LinearArena& GetScratchStack();
+
+private:
+	static LinearArena*		s_frameArenas[ 2 ];
+	static LinearArena*		s_scratchStack;
+	static unsigned int		s_currentFrameArenaIndex;
+};
+
+
+//-----------------------------------------------------------------------------------------------
+inline STATIC void* FrameAllocator::Allocate( size_t numBytes, size_t alignment )
+{
+	return GetCurrentFrameArena().Allocate( numBytes, alignment );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+//Lets standard containers live in an arena. When the arena is full it falls back to the general
+//heap, and deallocate only frees memory the arena does not own. There is no default constructor:
+//the arena, and so how long the container's memory lives, is always named where it is built.
+template< typename T >
+class ArenaAllocator
+{
+public:
+	typedef T					value_type;
+	typedef T*					pointer;
+	typedef const T*			const_pointer;
+	typedef T&					reference;
+	typedef const T&			const_reference;
+	typedef size_t				size_type;
+	typedef ptrdiff_t			difference_type;
+
+	template< typename T_Other >
+	struct rebind { typedef ArenaAllocator< T_Other > other; };
+
+	ArenaAllocator( LinearArena& arena ) : m_arena( &arena ) {}
+	template< typename T_Other >
+		ArenaAllocator( const ArenaAllocator< T_Other >& other ) : m_arena( other.m_arena ) {}
+
+	pointer address( reference value ) const { return &value; }
+	const_pointer address( const_reference value ) const { return &value; }
+	pointer allocate( size_type numObjects, const void* = nullptr );
+	void deallocate( pointer data, size_type );
+	void construct( pointer data, const T& value ) { ::new( static_cast< void* >( data ) ) T( value ); }
+	void destroy( pointer data ) { data->~T(); }
+	size_type max_size() const { return ( std::numeric_limits< size_type >::max )() / sizeof( T ); }
+
+	LinearArena*	m_arena;
+};
+
+
+//-----------------------------------------------------------------------------------------------
+template< typename T >
+inline typename ArenaAllocator< T >::pointer ArenaAllocator< T >::allocate( size_type numObjects, const void* )
+{
+	void* data = m_arena->Allocate( numObjects * sizeof( T ), __alignof( T ) > MEMORY_ALIGNMENT ? __alignof( T ) : MEMORY_ALIGNMENT );
+	if( data == nullptr )
+		data = ::operator new( numObjects * sizeof( T ) );
+
+	return static_cast< pointer >( data );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+template< typename T >
+inline void ArenaAllocator< T >::deallocate( pointer data, size_type )
+{
+	if( !m_arena->Owns( data ) )
+		::operator delete( data );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+template< typename T, typename T_Other >
+inline bool operator==( const ArenaAllocator< T >& first, const ArenaAllocator< T_Other >& second )
+{
+	return first.m_arena == second.m_arena;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+template< typename T, typename T_Other >
+inline bool operator!=( const ArenaAllocator< T >& first, const ArenaAllocator< T_Other >& second )
+{
+	return first.m_arena != second.m_arena;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+template< typename T >
+struct ArenaVector
+{
+	typedef std::vector< T, ArenaAllocator< T > > Type;
+};
+
+typedef std::basic_string< char, std::char_traits< char >, ArenaAllocator< char > > ArenaString;
+
+
+#endif // include_LinearArena
\ No newline at end of file
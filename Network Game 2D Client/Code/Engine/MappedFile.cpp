@@ -0,0 +1,136 @@
+#include "MappedFile.hpp"
+#include "NewMacroDef.hpp"
+
+
+//-----------------------------------------------------------------------------------------------
+//PrefetchVirtualMemory is only exported from Windows 8 on, and only declared by newer SDKs.
+struct PrefetchMemoryRange
+{
+	void*	m_virtualAddress;
+	SIZE_T	m_numBytes;
+};
+
+typedef BOOL ( WINAPI *PrefetchVirtualMemoryFunc ) ( HANDLE, ULONG_PTR, PrefetchMemoryRange*, ULONG );
+
+
+//-----------------------------------------------------------------------------------------------
+MappedFile::MappedFile()
+	: m_fileHandle( INVALID_HANDLE_VALUE )
+	, m_mappingHandle( nullptr )
+	, m_view( nullptr )
+	, m_viewSizeInBytes( 0 )
+	, m_fileSizeInBytes( 0 )
+{
+
+}
+
+
+//-----------------------------------------------------------------------------------------------
+MappedFile::~MappedFile()
+{
+	Close();
+}
+
+
+//-----------------------------------------------------------------------------------------------
+//Prefetching reads the whole view in now, on the calling thread, instead of one page fault at a
+//time wherever the data is first touched.
+bool MappedFile::Open( const std::string& filePath, bool shouldPrefetch )
+{
+	Close();
+
+	m_fileHandle = CreateFileA( filePath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr );
+	if( m_fileHandle == INVALID_HANDLE_VALUE )
+		return false;
+
+	LARGE_INTEGER fileSize;
+	if( !GetFileSizeEx( m_fileHandle, &fileSize ) )
+	{
+		Close();
+		return false;
+	}
+
+	// an empty file can not be mapped, but it opened fine
+	m_fileSizeInBytes = (unsigned long long) fileSize.QuadPart;
+	if( m_fileSizeInBytes == 0 )
+		return true;
+
+	m_mappingHandle = CreateFileMappingA( m_fileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr );
+	if( m_mappingHandle == nullptr )
+	{
+		Close();
+		return false;
+	}
+
+	if( m_fileSizeInBytes > MAX_MAPPED_FILE_VIEW_SIZE_IN_BYTES )
+		return true;
+
+	m_viewSizeInBytes = (size_t) m_fileSizeInBytes;
+	m_view = MapView( 0, m_viewSizeInBytes );
+	if( m_view == nullptr )
+	{
+		Close();
+		return false;
+	}
+
+	if( shouldPrefetch )
+		Prefetch( m_view, m_viewSizeInBytes );
+
+	return true;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void MappedFile::Close()
+{
+	if( m_view != nullptr )
+		UnmapViewOfFile( m_view );
+
+	if( m_mappingHandle != nullptr )
+		CloseHandle( m_mappingHandle );
+
+	if( m_fileHandle != INVALID_HANDLE_VALUE )
+		CloseHandle( m_fileHandle );
+
+	m_fileHandle = INVALID_HANDLE_VALUE;
+	m_mappingHandle = nullptr;
+	m_view = nullptr;
+	m_viewSizeInBytes = 0;
+	m_fileSizeInBytes = 0;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+const byte_t* MappedFile::MapView( unsigned long long offset, size_t numBytes ) const
+{
+	if( m_mappingHandle == nullptr )
+		return nullptr;
+
+	DWORD offsetHigh = (DWORD) ( offset >> 32 );
+	DWORD offsetLow = (DWORD) ( offset & 0xffffffff );
+	return static_cast< const byte_t* >( MapViewOfFile( m_mappingHandle, FILE_MAP_READ, offsetHigh, offsetLow, numBytes ) );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+//Without PrefetchVirtualMemory, touching a byte of every page faults the view in, still in big
+//sequential reads thanks to the file system's read ahead.
+STATIC void MappedFile::Prefetch( const byte_t* data, size_t numBytes )
+{
+	static PrefetchVirtualMemoryFunc prefetchVirtualMemory = reinterpret_cast< PrefetchVirtualMemoryFunc >( GetProcAddress( GetModuleHandleA( "kernel32.dll" ), "PrefetchVirtualMemory" ) );
+	if( prefetchVirtualMemory != nullptr )
+	{
+		PrefetchMemoryRange range;
+		range.m_virtualAddress = const_cast< byte_t* >( data );
+		range.m_numBytes = numBytes;
+		if( prefetchVirtualMemory( GetCurrentProcess(), 1, &range, 0 ) )
+			return;
+	}
+
+	SYSTEM_INFO systemInfo;
+	GetSystemInfo( &systemInfo );
+
+	volatile byte_t touchedBytes = 0;
+	for( size_t byteIndex = 0; byteIndex < numBytes; byteIndex += systemInfo.dwPageSize )
+		touchedBytes ^= data[ byteIndex ];
+}
\ No newline at end of file
@@ -0,0 +1,78 @@
+#ifndef include_MappedFile
+#define include_MappedFile
+#pragma once
+
+//-----------------------------------------------------------------------------------------------
+#include <string>
+#include <windows.h>
+#include "EngineCommon.hpp"
+
+
+//-----------------------------------------------------------------------------------------------
+const unsigned long long MAX_MAPPED_FILE_VIEW_SIZE_IN_BYTES = 256 * 1024 * 1024;
+const size_t DEFAULT_MAPPED_FILE_CHUNK_SIZE_IN_BYTES = 4 * 1024 * 1024;
+
+
+//-----------------------------------------------------------------------------------------------
+//Read only view of a file straight out of the system file cache, so loading it never copies it
+//into a buffer of our own. Files too big to map in one view in a 32 bit address space are left
+//unmapped; read those a chunk at a time with ForEachChunk, which only ever maps one chunk.
+class MappedFile
+{
+public:
+	MappedFile();
+	~MappedFile();
+	bool Open( const std::string& filePath, bool shouldPrefetch = false );
+	void Close();
+	bool IsOpen() const { return m_fileHandle != INVALID_HANDLE_VALUE; }
+	const byte_t* GetData() const { return m_view; }
+	size_t GetSize() const { return m_viewSizeInBytes; }
+	unsigned long long GetFileSize() const { return m_fileSizeInBytes; }
+	template< typename T_Function >
+		bool ForEachChunk( T_Function& function, size_t chunkSizeInBytes = DEFAULT_MAPPED_FILE_CHUNK_SIZE_IN_BYTES );
+
+private:
+	MappedFile( const MappedFile& );
+	void operator=( const MappedFile& );
+	const byte_t* MapView( unsigned long long offset, size_t numBytes ) const;
+	static void Prefetch( const byte_t* data, size_t numBytes );
+
+	HANDLE				m_fileHandle;
+	HANDLE				m_mappingHandle;
+	const byte_t*		m_view;
+	size_t				m_viewSizeInBytes;
+	unsigned long long	m_fileSizeInBytes;
+};
+
+
+//-----------------------------------------------------------------------------------------------
+//Calls function( data, numBytes, offset ) for each chunk in file order. The chunk is unmapped as
+//soon as the function returns, so it must not hold on to the data.
+template< typename T_Function >
+inline bool MappedFile::ForEachChunk( T_Function& function, size_t chunkSizeInBytes )
+{
+	if( !IsOpen() )
+		return false;
+
+	// views have to start on an allocation granularity boundary
+	SYSTEM_INFO systemInfo;
+	GetSystemInfo( &systemInfo );
+	size_t granularity = systemInfo.dwAllocationGranularity;
+	chunkSizeInBytes = ( ( chunkSizeInBytes + granularity - 1 ) / granularity ) * granularity;
+
+	for( unsigned long long offset = 0; offset < m_fileSizeInBytes; offset += chunkSizeInBytes )
+	{
+		size_t numBytes = ( m_fileSizeInBytes - offset < chunkSizeInBytes ) ? (size_t) ( m_fileSizeInBytes - offset ) : chunkSizeInBytes;
+		const byte_t* chunk = MapView( offset, numBytes );
+		if( chunk == nullptr )
+			return false;
+
+		function( chunk, numBytes, offset );
+		UnmapViewOfFile( chunk );
+	}
+
+	return true;
+}
+
+
+#endif // include_MappedFile
\ No newline at end of file
@@ -1,17 +1,106 @@
 #include "MemoryManager.hpp"
 #include <string>
-#include <malloc.h>
+#include <intrin.h>
 #include <Windows.h>
 #include "StringFunctions.hpp"
+#include "AllocationProfiler.hpp"
+
+
+//-----------------------------------------------------------------------------------------------
+#pragma intrinsic( _BitScanForward )
+#pragma intrinsic( _BitScanReverse )
+
+
+//-----------------------------------------------------------------------------------------------
+static const size_t BLOCK_HEADER_SIZE = ( sizeof( MetaData ) + MEMORY_ALIGNMENT - 1 ) & ~( MEMORY_ALIGNMENT - 1 );
+static const size_t MIN_BLOCK_DATA_SIZE = ( sizeof( FreeBlockLinks ) + sizeof( MetaData* ) + MEMORY_ALIGNMENT - 1 ) & ~( MEMORY_ALIGNMENT - 1 );
+static const size_t MAX_BLOCK_DATA_SIZE = (size_t) 1 << ( FIRST_LEVEL_INDEX_SHIFT + FIRST_LEVEL_INDEX_COUNT - 1 );
+static const DWORD CENTRAL_HEAP_SPIN_COUNT = 4000;
 
 
 //-----------------------------------------------------------------------------------------------
 STATIC byte_t* MemoryManager::m_pool;
-STATIC size_t MemoryManager::m_poolSizeInBytes;
+STATIC size_t MemoryManager::m_reservedSizeInBytes;
+STATIC size_t MemoryManager::m_committedSizeInBytes;
+STATIC bool MemoryManager::m_isLastBlockFree;
+STATIC bool MemoryManager::m_areLargePagesInUse;
 STATIC size_t MemoryManager::m_numAllocationsRequested;
 STATIC size_t MemoryManager::m_totalNumBytesAllocated;
 STATIC size_t MemoryManager::m_currentNumBytesAllocated;
 STATIC size_t MemoryManager::m_largestAllocation;
+STATIC unsigned int MemoryManager::m_smallFreeListBitmap;
+STATIC unsigned int MemoryManager::m_firstLevelBitmap;
+STATIC unsigned int MemoryManager::m_secondLevelBitmaps[ FIRST_LEVEL_INDEX_COUNT ];
+STATIC MetaData* MemoryManager::m_smallFreeLists[ NUM_SMALL_SIZE_CLASSES ];
+STATIC MetaData* MemoryManager::m_freeLists[ FIRST_LEVEL_INDEX_COUNT ][ SECOND_LEVEL_INDEX_COUNT ];
+STATIC CRITICAL_SECTION MemoryManager::m_centralHeapCS;
+STATIC ThreadAllocationCache* MemoryManager::m_threadCaches;
+STATIC ObjectPoolStatistics* MemoryManager::m_objectPools;
+
+
+//-----------------------------------------------------------------------------------------------
+//Jobs on fibers can move between threads at any JobManager::WaitFor, so the cache is never read
+//straight from thread local storage, whose address the compiler may keep from before the switch.
+static __declspec( thread ) ThreadAllocationCache* g_threadAllocationCache = nullptr;
+
+
+//-----------------------------------------------------------------------------------------------
+static __declspec( noinline ) ThreadAllocationCache* GetThreadAllocationCache()
+{
+	return g_threadAllocationCache;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+static __declspec( noinline ) void SetThreadAllocationCache( ThreadAllocationCache* cache )
+{
+	g_threadAllocationCache = cache;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+static inline unsigned int FindFirstSetBit( unsigned int bitmap )
+{
+	unsigned long bitIndex;
+	_BitScanForward( &bitIndex, bitmap );
+	return bitIndex;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+static inline unsigned int FindLastSetBit( size_t value )
+{
+	unsigned long bitIndex;
+	_BitScanReverse( &bitIndex, (unsigned long) value );
+	return bitIndex;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+static inline void GetLargeFreeListIndices( size_t blockDataSize, unsigned int& firstLevelIndex_out, unsigned int& secondLevelIndex_out )
+{
+	unsigned int lastSetBit = FindLastSetBit( blockDataSize );
+	secondLevelIndex_out = (unsigned int) ( blockDataSize >> ( lastSetBit - SECOND_LEVEL_INDEX_COUNT_LOG2 ) ) ^ SECOND_LEVEL_INDEX_COUNT;
+	firstLevelIndex_out = lastSetBit - FIRST_LEVEL_INDEX_SHIFT;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+static inline size_t GetBlockDataSizeForRequest( size_t objectSizeInBytes )
+{
+	size_t blockDataSize = ( objectSizeInBytes + MEMORY_ALIGNMENT - 1 ) & ~( MEMORY_ALIGNMENT - 1 );
+	if( blockDataSize < MIN_BLOCK_DATA_SIZE )
+		blockDataSize = MIN_BLOCK_DATA_SIZE;
+
+	return blockDataSize;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+static inline FreeBlockLinks* GetFreeBlockLinks( MetaData* block )
+{
+	return (FreeBlockLinks*) ( reinterpret_cast< byte_t* >( block ) + BLOCK_HEADER_SIZE );
+}
 
 
 //-----------------------------------------------------------------------------------------------
@@ -29,8 +118,48 @@ STATIC void MemoryManager::Initialize( size_t poolSizeInBytes )
 	m_currentNumBytesAllocated = 0;
 	m_largestAllocation = 0;
 
-	m_poolSizeInBytes = poolSizeInBytes;
-	m_pool = static_cast< byte_t* >( malloc( m_poolSizeInBytes ) );
+	m_smallFreeListBitmap = 0;
+	m_firstLevelBitmap = 0;
+	memset( m_secondLevelBitmaps, 0, sizeof( m_secondLevelBitmaps ) );
+	memset( m_smallFreeLists, 0, sizeof( m_smallFreeLists ) );
+	memset( m_freeLists, 0, sizeof( m_freeLists ) );
+	m_threadCaches = nullptr;
+	m_objectPools = nullptr;
+	InitializeCriticalSectionAndSpinCount( &m_centralHeapCS, CENTRAL_HEAP_SPIN_COUNT );
+
+	m_reservedSizeInBytes = poolSizeInBytes & ~( POOL_COMMIT_CHUNK_SIZE - 1 );
+	m_committedSizeInBytes = 0;
+	m_isLastBlockFree = false;
+	m_areLargePagesInUse = false;
+	m_pool = nullptr;
+
+#ifdef MEMORY_MANAGER_USE_LARGE_PAGES
+	// large pages can not be committed piecemeal, so the whole pool is committed up front
+	size_t largePageSize = GetLargePageMinimum();
+	if( largePageSize != 0 )
+	{
+		size_t largePagePoolSize = ( m_reservedSizeInBytes + largePageSize - 1 ) & ~( largePageSize - 1 );
+		m_pool = static_cast< byte_t* >( VirtualAlloc( nullptr, largePagePoolSize, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE ) );
+		if( m_pool != nullptr )
+		{
+			m_reservedSizeInBytes = largePagePoolSize;
+			m_committedSizeInBytes = largePagePoolSize;
+			m_areLargePagesInUse = true;
+		}
+	}
+#endif
+
+	if( m_pool == nullptr )
+	{
+		m_committedSizeInBytes = ( POOL_INITIAL_COMMIT_IN_BYTES < m_reservedSizeInBytes ) ? POOL_INITIAL_COMMIT_IN_BYTES : m_reservedSizeInBytes;
+		m_pool = static_cast< byte_t* >( VirtualAlloc( nullptr, m_reservedSizeInBytes, MEM_RESERVE, PAGE_NOACCESS ) );
+		if( m_pool != nullptr && VirtualAlloc( m_pool, m_committedSizeInBytes, MEM_COMMIT, PAGE_READWRITE ) == nullptr )
+		{
+			VirtualFree( m_pool, 0, MEM_RELEASE );
+			m_pool = nullptr;
+		}
+	}
+
 	if( m_pool == nullptr )
 	{
 		static const std::bad_alloc nomem;
@@ -39,17 +168,27 @@ STATIC void MemoryManager::Initialize( size_t poolSizeInBytes )
 
 	MetaData* topMeta = (MetaData*) m_pool;
 	topMeta->m_isOccupied = false;
-	topMeta->m_blockDataSegmentSize = m_poolSizeInBytes - sizeof( MetaData );
+	topMeta->m_isPreviousBlockFree = false;
+	topMeta->m_isCached = false;
+	topMeta->m_blockDataSegmentSize = m_committedSizeInBytes - BLOCK_HEADER_SIZE;
+	topMeta->m_requestedSize = 0;
+	topMeta->m_fileName = nullptr;
+	topMeta->m_lineNumber = 0;
+	InsertFreeBlock( topMeta );
 }
 
 
 //-----------------------------------------------------------------------------------------------
 STATIC void MemoryManager::Destruct()
 {
-	free( m_pool );
+	VirtualFree( m_pool, 0, MEM_RELEASE );
 	m_pool = nullptr;
-	m_poolSizeInBytes = 0;
+	m_reservedSizeInBytes = 0;
+	m_committedSizeInBytes = 0;
 	m_currentNumBytesAllocated = 0;
+	m_threadCaches = nullptr;
+	SetThreadAllocationCache( nullptr );
+	DeleteCriticalSection( &m_centralHeapCS );
 }
 
 
@@ -63,51 +202,61 @@ STATIC void* MemoryManager::AllocateMemory( size_t objectSizeInBytes )
 //-----------------------------------------------------------------------------------------------
 STATIC void* MemoryManager::AllocateMemory( size_t objectSizeInBytes, const char* file, unsigned int line )
 {
-	++m_numAllocationsRequested;
-	m_totalNumBytesAllocated += objectSizeInBytes;
-	m_currentNumBytesAllocated += objectSizeInBytes;
-	if( objectSizeInBytes > m_largestAllocation )
-		m_largestAllocation = objectSizeInBytes;
+	if( objectSizeInBytes > MAX_BLOCK_DATA_SIZE )
+		return nullptr;
 
-	//size_t numBytesPassed = 0;
-	size_t bytesNeeded = objectSizeInBytes + sizeof( MetaData );
-	//MetaData* block = (MetaData*) m_pool;
+	size_t blockDataSize = GetBlockDataSizeForRequest( objectSizeInBytes );
+	ThreadAllocationCache* cache = nullptr;
+	if( blockDataSize < SMALL_BLOCK_SIZE_LIMIT )
+		cache = GetOrCreateThreadCache();
 
-	MetaData* freeBlock = GetSmallestFreeBlock( bytesNeeded );
-	if( freeBlock )
+	MetaData* block = nullptr;
+	if( cache != nullptr )
 	{
-		MetaData* newMeta = (MetaData*) ( reinterpret_cast< byte_t* >( freeBlock ) + bytesNeeded );
-		newMeta->m_isOccupied = false;
-		newMeta->m_blockDataSegmentSize = freeBlock->m_blockDataSegmentSize - bytesNeeded;
-		freeBlock->m_isOccupied = true;
-		freeBlock->m_blockDataSegmentSize = objectSizeInBytes;
-		freeBlock->m_fileName = file;
-		freeBlock->m_lineNumber = line;
-		return ( reinterpret_cast< byte_t* >( freeBlock ) + sizeof( MetaData ) );
+		unsigned int sizeClassIndex = (unsigned int) ( blockDataSize / MEMORY_ALIGNMENT );
+		if( cache->m_numCachedBlocks[ sizeClassIndex ] == 0 )
+			RefillThreadCache( cache, blockDataSize );
+
+		++cache->m_numAllocationsRequested;
+		block = cache->m_cachedBlocks[ sizeClassIndex ];
+		if( block == nullptr )
+			return nullptr;
+
+		cache->m_cachedBlocks[ sizeClassIndex ] = GetFreeBlockLinks( block )->m_nextFreeBlock;
+		--cache->m_numCachedBlocks[ sizeClassIndex ];
+		block->m_isCached = false;
+
+		cache->m_totalNumBytesAllocated += objectSizeInBytes;
+		cache->m_currentNumBytesAllocated += objectSizeInBytes;
+		if( objectSizeInBytes > cache->m_largestAllocation )
+			cache->m_largestAllocation = objectSizeInBytes;
 	}
-
-	/*while( numBytesPassed < m_poolSizeInBytes )
+	else
 	{
-		if( !block->m_isOccupied && block->m_blockDataSegmentSize >= bytesNeeded )
-		{
-			MetaData* newMeta = (MetaData*) ( reinterpret_cast< byte_t* >( block ) + bytesNeeded );
-			newMeta->m_isOccupied = false;
-			newMeta->m_blockDataSegmentSize = block->m_blockDataSegmentSize - bytesNeeded;
-			block->m_isOccupied = true;
-			block->m_blockDataSegmentSize = objectSizeInBytes;
-			block->m_fileName = file;
-			block->m_lineNumber = line;
-			return ( reinterpret_cast< byte_t* >( block ) + sizeof( MetaData ) );
-		}
-		else
+		EnterCriticalSection( &m_centralHeapCS );
+		++m_numAllocationsRequested;
+		block = AllocateBlock( blockDataSize );
+		if( block != nullptr )
 		{
-			size_t bytesToNextBlock = block->m_blockDataSegmentSize + sizeof( MetaData );
-			block = (MetaData*) ( reinterpret_cast< byte_t* >( block ) + bytesToNextBlock );
-			numBytesPassed += bytesToNextBlock;
+			m_totalNumBytesAllocated += objectSizeInBytes;
+			m_currentNumBytesAllocated += objectSizeInBytes;
+			if( objectSizeInBytes > m_largestAllocation )
+				m_largestAllocation = objectSizeInBytes;
 		}
-	}*/
+		LeaveCriticalSection( &m_centralHeapCS );
+
+		if( block == nullptr )
+			return nullptr;
+	}
 
-	return nullptr;
+	block->m_requestedSize = objectSizeInBytes;
+	block->m_fileName = file;
+	block->m_lineNumber = line;
+	block->m_isSampled = false;
+	if( AllocationProfiler::IsRunning() )
+		AllocationProfiler::RecordAllocation( block );
+
+	return ( reinterpret_cast< byte_t* >( block ) + BLOCK_HEADER_SIZE );
 }
 
 
@@ -117,37 +266,76 @@ STATIC void MemoryManager::FreeMemory( void* data )
 	if( data == nullptr )
 		return;
 
-	MetaData* block = (MetaData*) ( reinterpret_cast< byte_t* >( data ) - sizeof( MetaData ) );
-	block->m_isOccupied = false;
-	block->m_fileName = nullptr;
-	block->m_lineNumber = 0;
+	MetaData* block = (MetaData*) ( reinterpret_cast< byte_t* >( data ) - BLOCK_HEADER_SIZE );
+	if( block->m_isSampled )
+		AllocationProfiler::RecordFree( block );
 
-	m_currentNumBytesAllocated -= block->m_blockDataSegmentSize;
+	ThreadAllocationCache* cache = nullptr;
+	if( block->m_blockDataSegmentSize < SMALL_BLOCK_SIZE_LIMIT )
+		cache = GetOrCreateThreadCache();
 
-	size_t numBytesPassed = 0;
-	MetaData* blockBefore = (MetaData*) m_pool;
-	while( blockBefore != block && numBytesPassed < m_poolSizeInBytes )
+	// blocks freed on a different thread than they were allocated on simply join this thread's cache
+	if( cache != nullptr )
 	{
-		size_t bytesToNextBlock = blockBefore->m_blockDataSegmentSize + sizeof( MetaData );
-		numBytesPassed += bytesToNextBlock;
-		MetaData* nextBlock = (MetaData*) ( reinterpret_cast< byte_t* >( blockBefore ) + bytesToNextBlock );
-		if( nextBlock == block )
-			break;
+		cache->m_currentNumBytesAllocated -= block->m_requestedSize;
+		block->m_requestedSize = 0;
+		block->m_fileName = nullptr;
+		block->m_lineNumber = 0;
+		block->m_isCached = true;
+
+		unsigned int sizeClassIndex = (unsigned int) ( block->m_blockDataSegmentSize / MEMORY_ALIGNMENT );
+		GetFreeBlockLinks( block )->m_nextFreeBlock = cache->m_cachedBlocks[ sizeClassIndex ];
+		cache->m_cachedBlocks[ sizeClassIndex ] = block;
+		++cache->m_numCachedBlocks[ sizeClassIndex ];
+		if( cache->m_numCachedBlocks[ sizeClassIndex ] > THREAD_CACHE_MAX_BLOCKS_PER_CLASS )
+			ReturnCachedBlocks( cache, sizeClassIndex, THREAD_CACHE_BATCH_SIZE );
 
-		blockBefore = nextBlock;
+		return;
 	}
-	numBytesPassed += block->m_blockDataSegmentSize + sizeof( MetaData );
 
-	if( numBytesPassed < m_poolSizeInBytes )
+	EnterCriticalSection( &m_centralHeapCS );
+	m_currentNumBytesAllocated -= block->m_requestedSize;
+	ReleaseBlock( block );
+	LeaveCriticalSection( &m_centralHeapCS );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+STATIC void MemoryManager::FlushThreadCache()
+{
+	ThreadAllocationCache* cache = GetThreadAllocationCache();
+	if( cache == nullptr )
+		return;
+
+	SetThreadAllocationCache( nullptr );
+
+	EnterCriticalSection( &m_centralHeapCS );
+	for( unsigned int sizeClassIndex = 0; sizeClassIndex < NUM_SMALL_SIZE_CLASSES; ++sizeClassIndex )
 	{
-		size_t bytesToNextBlock = block->m_blockDataSegmentSize + sizeof( MetaData );
-		MetaData* blockAfter = (MetaData*) ( reinterpret_cast< byte_t* >( block ) + bytesToNextBlock );
-		if( !blockAfter->m_isOccupied )
-			block->m_blockDataSegmentSize += sizeof( MetaData ) + blockAfter->m_blockDataSegmentSize;
+		while( cache->m_cachedBlocks[ sizeClassIndex ] != nullptr )
+		{
+			MetaData* block = cache->m_cachedBlocks[ sizeClassIndex ];
+			cache->m_cachedBlocks[ sizeClassIndex ] = GetFreeBlockLinks( block )->m_nextFreeBlock;
+			ReleaseBlock( block );
+		}
 	}
 
-	if( blockBefore != block && !blockBefore->m_isOccupied )
-		blockBefore->m_blockDataSegmentSize += sizeof( MetaData ) + block->m_blockDataSegmentSize;
+	m_numAllocationsRequested += cache->m_numAllocationsRequested;
+	m_totalNumBytesAllocated += cache->m_totalNumBytesAllocated;
+	m_currentNumBytesAllocated += cache->m_currentNumBytesAllocated;
+	if( cache->m_largestAllocation > m_largestAllocation )
+		m_largestAllocation = cache->m_largestAllocation;
+
+	if( cache->m_previousCache != nullptr )
+		cache->m_previousCache->m_nextCache = cache->m_nextCache;
+	else
+		m_threadCaches = cache->m_nextCache;
+
+	if( cache->m_nextCache != nullptr )
+		cache->m_nextCache->m_previousCache = cache->m_previousCache;
+
+	ReleaseBlock( (MetaData*) ( reinterpret_cast< byte_t* >( cache ) - BLOCK_HEADER_SIZE ) );
+	LeaveCriticalSection( &m_centralHeapCS );
 }
 
 
@@ -162,12 +350,12 @@ STATIC bool MemoryManager::IsMemoryManagerAvailable()
 STATIC void MemoryManager::CheckForMemoryLeaks()
 {
 	bool memoryLeakFound = false;
-	size_t numBytesPassed = 0;
 	MetaData* block = (MetaData*) m_pool;
 
-	while( numBytesPassed < m_poolSizeInBytes )
+	EnterCriticalSection( &m_centralHeapCS );
+	while( block != nullptr )
 	{
-		if( block->m_isOccupied )
+		if( block->m_isOccupied && !block->m_isCached )
 		{
 			if( !memoryLeakFound )
 			{
@@ -182,14 +370,13 @@ STATIC void MemoryManager::CheckForMemoryLeaks()
 			else
 				debugString = "<file not given>(0): ";
 
-			debugString += "normal block at " + ConvertAddressToString( block ) + ", " + ConvertNumberToString( block->m_blockDataSegmentSize ) + " bytes long\n";
+			debugString += "normal block at " + ConvertAddressToString( block ) + ", " + ConvertNumberToString( block->m_requestedSize ) + " bytes long\n";
 			OutputDebugStringA( debugString.c_str() );
 		}
 
-		size_t bytesToNextBlock = block->m_blockDataSegmentSize + sizeof( MetaData );
-		block = (MetaData*) ( reinterpret_cast< byte_t* >( block ) + bytesToNextBlock );
-		numBytesPassed += bytesToNextBlock;
+		block = GetNextPhysicalBlock( block );
 	}
+	LeaveCriticalSection( &m_centralHeapCS );
 
 	if( !memoryLeakFound )
 		OutputDebugStringA( "No memory leaks detected!" );
@@ -198,151 +385,583 @@ STATIC void MemoryManager::CheckForMemoryLeaks()
 }
 
 
+#ifdef _DEBUG
+//-----------------------------------------------------------------------------------------------
+static bool ReportHeapError( const char* errorMessage, const void* block )
+{
+	std::string debugString = "MemoryManager heap is corrupt: " + std::string( errorMessage ) + " at " + ConvertAddressToString( const_cast< void* >( block ) ) + "\n";
+	OutputDebugStringA( debugString.c_str() );
+	return false;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+STATIC bool MemoryManager::ValidateHeap()
+{
+	EnterCriticalSection( &m_centralHeapCS );
+	bool isHeapConsistent = IsHeapConsistent();
+	LeaveCriticalSection( &m_centralHeapCS );
+	return isHeapConsistent;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+STATIC bool MemoryManager::IsHeapConsistent()
+{
+	size_t numPhysicalFreeBlocks = 0;
+	size_t numBytesPassed = 0;
+	bool wasPreviousBlockFree = false;
+	for( MetaData* block = (MetaData*) m_pool; block != nullptr; block = GetNextPhysicalBlock( block ) )
+	{
+		if( ( block->m_blockDataSegmentSize & ( MEMORY_ALIGNMENT - 1 ) ) != 0 || block->m_blockDataSegmentSize < MIN_BLOCK_DATA_SIZE )
+			return ReportHeapError( "block size is misaligned or too small", block );
+
+		numBytesPassed += BLOCK_HEADER_SIZE + block->m_blockDataSegmentSize;
+		if( numBytesPassed > m_committedSizeInBytes )
+			return ReportHeapError( "block runs past the end of the pool", block );
+
+		if( block->m_isPreviousBlockFree != wasPreviousBlockFree )
+			return ReportHeapError( "previous block free flag does not match the previous block", block );
+
+		if( !block->m_isOccupied )
+		{
+			if( wasPreviousBlockFree )
+				return ReportHeapError( "two adjacent free blocks were not coalesced", block );
+
+			MetaData** footer = (MetaData**) ( reinterpret_cast< byte_t* >( block ) + BLOCK_HEADER_SIZE + block->m_blockDataSegmentSize - sizeof( MetaData* ) );
+			if( *footer != block )
+				return ReportHeapError( "free block footer does not point at its header", block );
+
+			++numPhysicalFreeBlocks;
+		}
+
+		wasPreviousBlockFree = !block->m_isOccupied;
+	}
+
+	if( numBytesPassed != m_committedSizeInBytes )
+		return ReportHeapError( "blocks do not cover the committed pool", m_pool );
+
+	if( wasPreviousBlockFree != m_isLastBlockFree )
+		return ReportHeapError( "last block free flag does not match the last block", m_pool );
+
+	size_t numListedFreeBlocks = 0;
+	for( unsigned int freeListIndex = 0; freeListIndex < NUM_FREE_LISTS; ++freeListIndex )
+	{
+		MetaData* freeListHead = GetFreeListHeadByIndex( freeListIndex );
+		for( MetaData* block = freeListHead; block != nullptr; block = GetFreeBlockLinks( block )->m_nextFreeBlock )
+		{
+			FreeBlockLinks* links = GetFreeBlockLinks( block );
+			if( block->m_isOccupied )
+				return ReportHeapError( "occupied block found in a free list", block );
+
+			if( *GetFreeListHead( block->m_blockDataSegmentSize ) != freeListHead )
+				return ReportHeapError( "free block is in the wrong size class list", block );
+
+			if( links->m_nextFreeBlock != nullptr && GetFreeBlockLinks( links->m_nextFreeBlock )->m_previousFreeBlock != block )
+				return ReportHeapError( "free list links are inconsistent", block );
+
+			++numListedFreeBlocks;
+			if( numListedFreeBlocks > numPhysicalFreeBlocks )
+				return ReportHeapError( "free lists hold more blocks than the pool", block );
+		}
+	}
+
+	if( numListedFreeBlocks != numPhysicalFreeBlocks )
+		return ReportHeapError( "free blocks are missing from the free lists", m_pool );
+
+	for( unsigned int smallClassIndex = 0; smallClassIndex < NUM_SMALL_SIZE_CLASSES; ++smallClassIndex )
+	{
+		bool isBitSet = ( m_smallFreeListBitmap & ( 1U << smallClassIndex ) ) != 0;
+		if( isBitSet != ( m_smallFreeLists[ smallClassIndex ] != nullptr ) )
+			return ReportHeapError( "small size class bitmap does not match its free list", &m_smallFreeLists[ smallClassIndex ] );
+	}
+
+	for( unsigned int firstLevelIndex = 0; firstLevelIndex < FIRST_LEVEL_INDEX_COUNT; ++firstLevelIndex )
+	{
+		bool isFirstLevelBitSet = ( m_firstLevelBitmap & ( 1U << firstLevelIndex ) ) != 0;
+		if( isFirstLevelBitSet != ( m_secondLevelBitmaps[ firstLevelIndex ] != 0 ) )
+			return ReportHeapError( "first level bitmap does not match the second level bitmap", &m_secondLevelBitmaps[ firstLevelIndex ] );
+
+		for( unsigned int secondLevelIndex = 0; secondLevelIndex < SECOND_LEVEL_INDEX_COUNT; ++secondLevelIndex )
+		{
+			bool isBitSet = ( m_secondLevelBitmaps[ firstLevelIndex ] & ( 1U << secondLevelIndex ) ) != 0;
+			if( isBitSet != ( m_freeLists[ firstLevelIndex ][ secondLevelIndex ] != nullptr ) )
+				return ReportHeapError( "second level bitmap does not match its free list", &m_freeLists[ firstLevelIndex ][ secondLevelIndex ] );
+		}
+	}
+
+	return true;
+}
+#endif
+
+
 //-----------------------------------------------------------------------------------------------
 STATIC size_t MemoryManager::GetNumberOfAllocationRequest()
 {
-	return m_numAllocationsRequested;
+	size_t numAllocationsRequested, totalNumBytesAllocated, currentNumBytesAllocated, largestAllocation;
+	GatherStatistics( numAllocationsRequested, totalNumBytesAllocated, currentNumBytesAllocated, largestAllocation );
+	return numAllocationsRequested;
 }
 
 
 //-----------------------------------------------------------------------------------------------
 STATIC size_t MemoryManager::GetTotalNumberOfBytesAllocated()
 {
-	return m_totalNumBytesAllocated;
+	size_t numAllocationsRequested, totalNumBytesAllocated, currentNumBytesAllocated, largestAllocation;
+	GatherStatistics( numAllocationsRequested, totalNumBytesAllocated, currentNumBytesAllocated, largestAllocation );
+	return totalNumBytesAllocated;
 }
 
 
 //-----------------------------------------------------------------------------------------------
 STATIC size_t MemoryManager::GetCurrentNumberOfBytesAllocated()
 {
-	return m_currentNumBytesAllocated;
+	size_t numAllocationsRequested, totalNumBytesAllocated, currentNumBytesAllocated, largestAllocation;
+	GatherStatistics( numAllocationsRequested, totalNumBytesAllocated, currentNumBytesAllocated, largestAllocation );
+	return currentNumBytesAllocated;
 }
 
 
 //-----------------------------------------------------------------------------------------------
 STATIC size_t MemoryManager::GetLargestAllocationSize()
 {
-	return m_largestAllocation;
+	size_t numAllocationsRequested, totalNumBytesAllocated, currentNumBytesAllocated, largestAllocation;
+	GatherStatistics( numAllocationsRequested, totalNumBytesAllocated, currentNumBytesAllocated, largestAllocation );
+	return largestAllocation;
 }
 
 
 //-----------------------------------------------------------------------------------------------
 STATIC float MemoryManager::GetAverageAllocationSize()
 {
-	return (float) ( m_totalNumBytesAllocated ) / (float) ( m_numAllocationsRequested );
+	size_t numAllocationsRequested, totalNumBytesAllocated, currentNumBytesAllocated, largestAllocation;
+	GatherStatistics( numAllocationsRequested, totalNumBytesAllocated, currentNumBytesAllocated, largestAllocation );
+	return (float) ( totalNumBytesAllocated ) / (float) ( numAllocationsRequested );
 }
 
 
 //-----------------------------------------------------------------------------------------------
 STATIC size_t MemoryManager::GetLargestFreeBlockSize()
 {
-	MetaData* largestBlock = GetLargestFreeBlock();
-	if( largestBlock == nullptr )
-		return 0;
-
-	return largestBlock->m_blockDataSegmentSize;
+	return GetLargestFreeBlockSize( (size_t) -1 );
 }
 
 
 //-----------------------------------------------------------------------------------------------
 STATIC size_t MemoryManager::GetSmallestFreeBlockSize()
 {
-	MetaData* smallestBlock = GetSmallestFreeBlock();
-	if( smallestBlock == nullptr )
-		return 0;
-
-	return smallestBlock->m_blockDataSegmentSize;
+	return GetSmallestFreeBlockSize( 0 );
 }
 
 
 //-----------------------------------------------------------------------------------------------
 STATIC size_t MemoryManager::GetLargestFreeBlockSize( size_t maxBlockSize )
 {
+	EnterCriticalSection( &m_centralHeapCS );
 	MetaData* largestBlock = GetLargestFreeBlock( maxBlockSize );
-	if( largestBlock == nullptr )
-		return 0;
-
-	return largestBlock->m_blockDataSegmentSize;
+	size_t largestBlockSize = ( largestBlock == nullptr ) ? 0 : largestBlock->m_blockDataSegmentSize;
+	LeaveCriticalSection( &m_centralHeapCS );
+	return largestBlockSize;
 }
 
 
 //-----------------------------------------------------------------------------------------------
 STATIC size_t MemoryManager::GetSmallestFreeBlockSize( size_t minBlockSize )
 {
+	EnterCriticalSection( &m_centralHeapCS );
 	MetaData* smallestBlock = GetSmallestFreeBlock( minBlockSize );
-	if( smallestBlock == nullptr )
-		return 0;
+	size_t smallestBlockSize = ( smallestBlock == nullptr ) ? 0 : smallestBlock->m_blockDataSegmentSize;
+	LeaveCriticalSection( &m_centralHeapCS );
+	return smallestBlockSize;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+STATIC size_t MemoryManager::GetCommittedSizeInBytes()
+{
+	return m_committedSizeInBytes;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+STATIC void MemoryManager::RegisterObjectPool( ObjectPoolStatistics* poolStatistics )
+{
+	if( !IsMemoryManagerAvailable() )
+		Initialize( POOL_MEMORY_IN_BYTES );
+
+	EnterCriticalSection( &m_centralHeapCS );
+	poolStatistics->m_previousPool = nullptr;
+	poolStatistics->m_nextPool = m_objectPools;
+	if( m_objectPools != nullptr )
+		m_objectPools->m_previousPool = poolStatistics;
 
-	return smallestBlock->m_blockDataSegmentSize;
+	m_objectPools = poolStatistics;
+	LeaveCriticalSection( &m_centralHeapCS );
 }
 
 
 //-----------------------------------------------------------------------------------------------
-STATIC MetaData* MemoryManager::GetLargestFreeBlock()
+STATIC void MemoryManager::UnregisterObjectPool( ObjectPoolStatistics* poolStatistics )
 {
-	size_t numBytesPassed = 0;
-	MetaData* block = (MetaData*) m_pool;
-	MetaData* largestBlock = block;
+	if( !IsMemoryManagerAvailable() )
+		return;
 
-	while( numBytesPassed < m_poolSizeInBytes )
+	EnterCriticalSection( &m_centralHeapCS );
+	if( poolStatistics->m_previousPool != nullptr )
+		poolStatistics->m_previousPool->m_nextPool = poolStatistics->m_nextPool;
+	else
+		m_objectPools = poolStatistics->m_nextPool;
+
+	if( poolStatistics->m_nextPool != nullptr )
+		poolStatistics->m_nextPool->m_previousPool = poolStatistics->m_previousPool;
+	LeaveCriticalSection( &m_centralHeapCS );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+//Destroying a pool unregisters it, so look the next one up again each time rather than walking a
+//list that changes underneath.
+STATIC void MemoryManager::DestroySharedObjectPools()
+{
+	if( !IsMemoryManagerAvailable() )
+		return;
+
+	for( ;; )
 	{
-		if( largestBlock == nullptr && !block->m_isOccupied )
-			largestBlock = block;
-		else if( largestBlock != nullptr && !block->m_isOccupied && block->m_blockDataSegmentSize > largestBlock->m_blockDataSegmentSize )
-			largestBlock = block;
-
-		size_t bytesToNextBlock = block->m_blockDataSegmentSize + sizeof( MetaData );
-		block = (MetaData*) ( reinterpret_cast< byte_t* >( block ) + bytesToNextBlock );
-		numBytesPassed += bytesToNextBlock;
+		void (*destroySharedPoolFunction)() = nullptr;
+
+		EnterCriticalSection( &m_centralHeapCS );
+		for( ObjectPoolStatistics* pool = m_objectPools; pool != nullptr && destroySharedPoolFunction == nullptr; pool = pool->m_nextPool )
+			destroySharedPoolFunction = pool->m_destroySharedPoolFunction;
+		LeaveCriticalSection( &m_centralHeapCS );
+
+		if( destroySharedPoolFunction == nullptr )
+			return;
+
+		destroySharedPoolFunction();
 	}
+}
 
-	return largestBlock;
+
+//-----------------------------------------------------------------------------------------------
+STATIC size_t MemoryManager::GetNumPooledBytesInUse()
+{
+	size_t numPooledBytesInUse = 0;
+
+	EnterCriticalSection( &m_centralHeapCS );
+	for( ObjectPoolStatistics* pool = m_objectPools; pool != nullptr; pool = pool->m_nextPool )
+		numPooledBytesInUse += pool->m_numLiveObjects * pool->m_objectSizeInBytes;
+	LeaveCriticalSection( &m_centralHeapCS );
+
+	return numPooledBytesInUse;
 }
 
 
 //-----------------------------------------------------------------------------------------------
-STATIC MetaData* MemoryManager::GetSmallestFreeBlock()
+STATIC size_t MemoryManager::GetNumPooledBytesReserved()
 {
-	size_t numBytesPassed = 0;
-	MetaData* block = (MetaData*) m_pool;
-	MetaData* smallestBlock = block;
+	size_t numPooledBytesReserved = 0;
+
+	EnterCriticalSection( &m_centralHeapCS );
+	for( ObjectPoolStatistics* pool = m_objectPools; pool != nullptr; pool = pool->m_nextPool )
+		numPooledBytesReserved += pool->m_numSlots * pool->m_objectSizeInBytes;
+	LeaveCriticalSection( &m_centralHeapCS );
 
-	while( numBytesPassed < m_poolSizeInBytes )
+	return numPooledBytesReserved;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+STATIC void MemoryManager::ReportObjectPoolOccupancy()
+{
+	EnterCriticalSection( &m_centralHeapCS );
+	for( ObjectPoolStatistics* pool = m_objectPools; pool != nullptr; pool = pool->m_nextPool )
 	{
-		if( smallestBlock == nullptr && !block->m_isOccupied )
-			smallestBlock = block;
-		else if( smallestBlock != nullptr && !block->m_isOccupied && block->m_blockDataSegmentSize < smallestBlock->m_blockDataSegmentSize && block->m_blockDataSegmentSize > 0 )
-			smallestBlock = block;
-
-		size_t bytesToNextBlock = block->m_blockDataSegmentSize + sizeof( MetaData );
-		block = (MetaData*) ( reinterpret_cast< byte_t* >( block ) + bytesToNextBlock );
-		numBytesPassed += bytesToNextBlock;
+		std::string debugString = std::string( pool->m_poolName ) + ": " + ConvertNumberToString( pool->m_numLiveObjects ) + " / " + ConvertNumberToString( pool->m_numSlots ) + " objects of " + ConvertNumberToString( pool->m_objectSizeInBytes ) + " bytes\n";
+		OutputDebugStringA( debugString.c_str() );
 	}
+	LeaveCriticalSection( &m_centralHeapCS );
+}
 
-	return smallestBlock;
+
+//-----------------------------------------------------------------------------------------------
+STATIC MetaData* MemoryManager::AllocateBlock( size_t blockDataSize )
+{
+	MetaData* block = FindFreeBlock( blockDataSize );
+	if( block == nullptr )
+	{
+		if( !CommitMoreMemory( blockDataSize ) )
+			return nullptr;
+
+		block = FindFreeBlock( blockDataSize );
+		if( block == nullptr )
+			return nullptr;
+	}
+
+	RemoveFreeBlock( block );
+	SplitBlock( block, blockDataSize );
+	block->m_isOccupied = true;
+	block->m_isCached = false;
+	MetaData* blockAfter = GetNextPhysicalBlock( block );
+	if( blockAfter != nullptr )
+		blockAfter->m_isPreviousBlockFree = false;
+	else
+		m_isLastBlockFree = false;
+
+	return block;
 }
 
 
 //-----------------------------------------------------------------------------------------------
-STATIC MetaData* MemoryManager::GetLargestFreeBlock( size_t maxBlockSize )
+STATIC void MemoryManager::ReleaseBlock( MetaData* block )
 {
-	size_t numBytesPassed = 0;
-	MetaData* block = (MetaData*) m_pool;
-	MetaData* largestBlock = block;
+	block->m_isOccupied = false;
+	block->m_isCached = false;
+	block->m_requestedSize = 0;
+	block->m_fileName = nullptr;
+	block->m_lineNumber = 0;
+
+	byte_t* freedDataStart = reinterpret_cast< byte_t* >( block ) + BLOCK_HEADER_SIZE;
+	byte_t* freedDataEnd = freedDataStart + block->m_blockDataSegmentSize;
+
+	MetaData* blockAfter = GetNextPhysicalBlock( block );
+	if( blockAfter != nullptr && !blockAfter->m_isOccupied )
+	{
+		RemoveFreeBlock( blockAfter );
+		block->m_blockDataSegmentSize += BLOCK_HEADER_SIZE + blockAfter->m_blockDataSegmentSize;
+	}
+
+	MetaData* blockBefore = GetPreviousFreePhysicalBlock( block );
+	if( blockBefore != nullptr )
+	{
+		RemoveFreeBlock( blockBefore );
+		blockBefore->m_blockDataSegmentSize += BLOCK_HEADER_SIZE + block->m_blockDataSegmentSize;
+		block = blockBefore;
+	}
+
+	if( GetNextPhysicalBlock( block ) == nullptr )
+		DecommitFreeTail( block );
+
+	if( (size_t) ( freedDataEnd - freedDataStart ) >= POOL_RESET_THRESHOLD )
+		ResetFreedPages( freedDataStart, freedDataEnd );
+
+	InsertFreeBlock( block );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+STATIC bool MemoryManager::CommitMoreMemory( size_t blockDataSize )
+{
+	if( m_areLargePagesInUse )
+		return false;
+
+	// the free list search rounds sizes up to the next second level step, so the new block has to be big enough on its own
+	size_t numBytesNeeded = BLOCK_HEADER_SIZE + blockDataSize + ( blockDataSize >> SECOND_LEVEL_INDEX_COUNT_LOG2 );
+	size_t numBytesToCommit = ( numBytesNeeded + POOL_COMMIT_CHUNK_SIZE - 1 ) & ~( POOL_COMMIT_CHUNK_SIZE - 1 );
+	if( numBytesToCommit > m_reservedSizeInBytes - m_committedSizeInBytes )
+		return false;
+
+	if( VirtualAlloc( m_pool + m_committedSizeInBytes, numBytesToCommit, MEM_COMMIT, PAGE_READWRITE ) == nullptr )
+		return false;
+
+	MetaData* newBlock = (MetaData*) ( m_pool + m_committedSizeInBytes );
+	newBlock->m_isOccupied = false;
+	newBlock->m_isPreviousBlockFree = m_isLastBlockFree;
+	newBlock->m_isCached = false;
+	newBlock->m_blockDataSegmentSize = numBytesToCommit - BLOCK_HEADER_SIZE;
+	newBlock->m_requestedSize = 0;
+	newBlock->m_fileName = nullptr;
+	newBlock->m_lineNumber = 0;
+	m_committedSizeInBytes += numBytesToCommit;
+
+	MetaData* blockBefore = GetPreviousFreePhysicalBlock( newBlock );
+	if( blockBefore != nullptr )
+	{
+		RemoveFreeBlock( blockBefore );
+		blockBefore->m_blockDataSegmentSize += BLOCK_HEADER_SIZE + newBlock->m_blockDataSegmentSize;
+		newBlock = blockBefore;
+	}
+
+	InsertFreeBlock( newBlock );
+	return true;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+STATIC void MemoryManager::DecommitFreeTail( MetaData* lastBlock )
+{
+	if( m_areLargePagesInUse )
+		return;
+
+	// one chunk of slack past the last block keeps a block freed and reallocated at the edge from committing every time
+	size_t numBytesToKeep = (size_t) ( reinterpret_cast< byte_t* >( lastBlock ) - m_pool ) + BLOCK_HEADER_SIZE + MIN_BLOCK_DATA_SIZE;
+	numBytesToKeep = ( numBytesToKeep + POOL_COMMIT_CHUNK_SIZE - 1 ) & ~( POOL_COMMIT_CHUNK_SIZE - 1 );
+	numBytesToKeep += POOL_COMMIT_CHUNK_SIZE;
+	if( numBytesToKeep < POOL_INITIAL_COMMIT_IN_BYTES )
+		numBytesToKeep = POOL_INITIAL_COMMIT_IN_BYTES;
+
+	if( numBytesToKeep >= m_committedSizeInBytes || m_committedSizeInBytes - numBytesToKeep < POOL_DECOMMIT_THRESHOLD )
+		return;
+
+	size_t numBytesToDecommit = m_committedSizeInBytes - numBytesToKeep;
+	if( !VirtualFree( m_pool + numBytesToKeep, numBytesToDecommit, MEM_DECOMMIT ) )
+		return;
+
+	m_committedSizeInBytes = numBytesToKeep;
+	lastBlock->m_blockDataSegmentSize -= numBytesToDecommit;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+STATIC void MemoryManager::ResetFreedPages( byte_t* freedDataStart, byte_t* freedDataEnd )
+{
+	if( m_areLargePagesInUse )
+		return;
+
+	// only whole pages strictly inside the freed data are reset, so neighbouring headers are never touched
+	static size_t s_pageSize = 0;
+	if( s_pageSize == 0 )
+	{
+		SYSTEM_INFO systemInfo;
+		GetSystemInfo( &systemInfo );
+		s_pageSize = systemInfo.dwPageSize;
+	}
+
+	if( freedDataEnd > m_pool + m_committedSizeInBytes )
+		freedDataEnd = m_pool + m_committedSizeInBytes;
+
+	size_t firstPage = ( (size_t) freedDataStart + s_pageSize - 1 ) & ~( s_pageSize - 1 );
+	size_t lastPage = (size_t) freedDataEnd & ~( s_pageSize - 1 );
+	if( firstPage >= lastPage )
+		return;
+
+	VirtualAlloc( (void*) firstPage, lastPage - firstPage, MEM_RESET, PAGE_READWRITE );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+STATIC ThreadAllocationCache* MemoryManager::GetOrCreateThreadCache()
+{
+	ThreadAllocationCache* cache = GetThreadAllocationCache();
+	if( cache != nullptr )
+		return cache;
+
+	EnterCriticalSection( &m_centralHeapCS );
+	MetaData* cacheBlock = AllocateBlock( GetBlockDataSizeForRequest( sizeof( ThreadAllocationCache ) ) );
+	if( cacheBlock != nullptr )
+	{
+		// marked as cached so that threads which never flush are not reported as leaks
+		cacheBlock->m_isCached = true;
+		cacheBlock->m_requestedSize = sizeof( ThreadAllocationCache );
+		cacheBlock->m_fileName = __FILE__;
+		cacheBlock->m_lineNumber = __LINE__;
+
+		cache = (ThreadAllocationCache*) ( reinterpret_cast< byte_t* >( cacheBlock ) + BLOCK_HEADER_SIZE );
+		memset( cache, 0, sizeof( ThreadAllocationCache ) );
+		cache->m_nextCache = m_threadCaches;
+		if( m_threadCaches != nullptr )
+			m_threadCaches->m_previousCache = cache;
+
+		m_threadCaches = cache;
+	}
+	LeaveCriticalSection( &m_centralHeapCS );
+
+	SetThreadAllocationCache( cache );
+	return cache;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+STATIC void MemoryManager::RefillThreadCache( ThreadAllocationCache* cache, size_t blockDataSize )
+{
+	unsigned int sizeClassIndex = (unsigned int) ( blockDataSize / MEMORY_ALIGNMENT );
+
+	EnterCriticalSection( &m_centralHeapCS );
+	for( unsigned int blockIndex = 0; blockIndex < THREAD_CACHE_BATCH_SIZE; ++blockIndex )
+	{
+		MetaData* block = AllocateBlock( blockDataSize );
+		if( block == nullptr )
+			break;
+
+		block->m_isCached = true;
+		block->m_requestedSize = 0;
+		block->m_fileName = nullptr;
+		block->m_lineNumber = 0;
+		GetFreeBlockLinks( block )->m_nextFreeBlock = cache->m_cachedBlocks[ sizeClassIndex ];
+		cache->m_cachedBlocks[ sizeClassIndex ] = block;
+		++cache->m_numCachedBlocks[ sizeClassIndex ];
+	}
+	LeaveCriticalSection( &m_centralHeapCS );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+STATIC void MemoryManager::ReturnCachedBlocks( ThreadAllocationCache* cache, unsigned int sizeClassIndex, unsigned int numBlocksToReturn )
+{
+	EnterCriticalSection( &m_centralHeapCS );
+	for( unsigned int blockIndex = 0; blockIndex < numBlocksToReturn && cache->m_cachedBlocks[ sizeClassIndex ] != nullptr; ++blockIndex )
+	{
+		MetaData* block = cache->m_cachedBlocks[ sizeClassIndex ];
+		cache->m_cachedBlocks[ sizeClassIndex ] = GetFreeBlockLinks( block )->m_nextFreeBlock;
+		--cache->m_numCachedBlocks[ sizeClassIndex ];
+		ReleaseBlock( block );
+	}
+	LeaveCriticalSection( &m_centralHeapCS );
+}
 
-	while( numBytesPassed < m_poolSizeInBytes )
+
+//-----------------------------------------------------------------------------------------------
+STATIC void MemoryManager::GatherStatistics( size_t& numAllocationsRequested_out, size_t& totalNumBytesAllocated_out, size_t& currentNumBytesAllocated_out, size_t& largestAllocation_out )
+{
+	EnterCriticalSection( &m_centralHeapCS );
+	numAllocationsRequested_out = m_numAllocationsRequested;
+	totalNumBytesAllocated_out = m_totalNumBytesAllocated;
+	ptrdiff_t currentNumBytesAllocated = (ptrdiff_t) m_currentNumBytesAllocated;
+	largestAllocation_out = m_largestAllocation;
+
+	// other threads update their own counters without the lock, so this is a close snapshot rather than an exact one
+	for( ThreadAllocationCache* cache = m_threadCaches; cache != nullptr; cache = cache->m_nextCache )
 	{
-		if( largestBlock == nullptr && !block->m_isOccupied && block->m_blockDataSegmentSize < maxBlockSize )
-			largestBlock = block;
-		else if( largestBlock != nullptr && !block->m_isOccupied && block->m_blockDataSegmentSize > largestBlock->m_blockDataSegmentSize && block->m_blockDataSegmentSize < maxBlockSize )
-			largestBlock = block;
+		numAllocationsRequested_out += cache->m_numAllocationsRequested;
+		totalNumBytesAllocated_out += cache->m_totalNumBytesAllocated;
+		currentNumBytesAllocated += cache->m_currentNumBytesAllocated;
+		if( cache->m_largestAllocation > largestAllocation_out )
+			largestAllocation_out = cache->m_largestAllocation;
+	}
+	LeaveCriticalSection( &m_centralHeapCS );
+
+	currentNumBytesAllocated_out = (size_t) currentNumBytesAllocated;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+STATIC MetaData* MemoryManager::GetLargestFreeBlock()
+{
+	return GetLargestFreeBlock( (size_t) -1 );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+STATIC MetaData* MemoryManager::GetSmallestFreeBlock()
+{
+	return GetSmallestFreeBlock( 0 );
+}
+
 
-		if( largestBlock != nullptr && largestBlock->m_blockDataSegmentSize == maxBlockSize )
-			return largestBlock;
+//-----------------------------------------------------------------------------------------------
+STATIC MetaData* MemoryManager::GetLargestFreeBlock( size_t maxBlockSize )
+{
+	MetaData* largestBlock = nullptr;
+	for( unsigned int freeListIndex = 0; freeListIndex < NUM_FREE_LISTS; ++freeListIndex )
+	{
+		for( MetaData* block = GetFreeListHeadByIndex( freeListIndex ); block != nullptr; block = GetFreeBlockLinks( block )->m_nextFreeBlock )
+		{
+			if( block->m_blockDataSegmentSize > maxBlockSize )
+				continue;
 
-		size_t bytesToNextBlock = block->m_blockDataSegmentSize + sizeof( MetaData );
-		block = (MetaData*) ( reinterpret_cast< byte_t* >( block ) + bytesToNextBlock );
-		numBytesPassed += bytesToNextBlock;
+			if( largestBlock == nullptr || block->m_blockDataSegmentSize > largestBlock->m_blockDataSegmentSize )
+				largestBlock = block;
+		}
 	}
 
 	return largestBlock;
@@ -352,24 +971,199 @@ STATIC MetaData* MemoryManager::GetLargestFreeBlock( size_t maxBlockSize )
 //-----------------------------------------------------------------------------------------------
 STATIC MetaData* MemoryManager::GetSmallestFreeBlock( size_t minBlockSize )
 {
-	size_t numBytesPassed = 0;
-	MetaData* block = (MetaData*) m_pool;
 	MetaData* smallestBlock = nullptr;
+	for( unsigned int freeListIndex = 0; freeListIndex < NUM_FREE_LISTS; ++freeListIndex )
+	{
+		for( MetaData* block = GetFreeListHeadByIndex( freeListIndex ); block != nullptr; block = GetFreeBlockLinks( block )->m_nextFreeBlock )
+		{
+			if( block->m_blockDataSegmentSize < minBlockSize )
+				continue;
+
+			if( smallestBlock == nullptr || block->m_blockDataSegmentSize < smallestBlock->m_blockDataSegmentSize )
+				smallestBlock = block;
+		}
+	}
+
+	return smallestBlock;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+STATIC MetaData** MemoryManager::GetFreeListHead( size_t blockDataSize )
+{
+	if( blockDataSize < SMALL_BLOCK_SIZE_LIMIT )
+		return &m_smallFreeLists[ blockDataSize / MEMORY_ALIGNMENT ];
+
+	unsigned int firstLevelIndex;
+	unsigned int secondLevelIndex;
+	GetLargeFreeListIndices( blockDataSize, firstLevelIndex, secondLevelIndex );
+	return &m_freeLists[ firstLevelIndex ][ secondLevelIndex ];
+}
+
+
+//-----------------------------------------------------------------------------------------------
+STATIC MetaData* MemoryManager::GetFreeListHeadByIndex( unsigned int freeListIndex )
+{
+	if( freeListIndex < NUM_SMALL_SIZE_CLASSES )
+		return m_smallFreeLists[ freeListIndex ];
+
+	freeListIndex -= NUM_SMALL_SIZE_CLASSES;
+	return m_freeLists[ freeListIndex / SECOND_LEVEL_INDEX_COUNT ][ freeListIndex % SECOND_LEVEL_INDEX_COUNT ];
+}
+
 
-	while( numBytesPassed < m_poolSizeInBytes )
+//-----------------------------------------------------------------------------------------------
+STATIC void MemoryManager::UpdateFreeListBitmaps( size_t blockDataSize, bool isFreeListEmpty )
+{
+	if( blockDataSize < SMALL_BLOCK_SIZE_LIMIT )
 	{
-		if( smallestBlock == nullptr && !block->m_isOccupied && block->m_blockDataSegmentSize > minBlockSize )
-			smallestBlock = block;
-		else if( smallestBlock != nullptr && !block->m_isOccupied && block->m_blockDataSegmentSize < smallestBlock->m_blockDataSegmentSize && block->m_blockDataSegmentSize > minBlockSize )
-			smallestBlock = block;
+		unsigned int classBit = 1U << ( blockDataSize / MEMORY_ALIGNMENT );
+		if( isFreeListEmpty )
+			m_smallFreeListBitmap &= ~classBit;
+		else
+			m_smallFreeListBitmap |= classBit;
 
-		if( smallestBlock != nullptr && smallestBlock->m_blockDataSegmentSize == minBlockSize )
-			return smallestBlock;
+		return;
+	}
 
-		size_t bytesToNextBlock = block->m_blockDataSegmentSize + sizeof( MetaData );
-		block = (MetaData*) ( reinterpret_cast< byte_t* >( block ) + bytesToNextBlock );
-		numBytesPassed += bytesToNextBlock;
+	unsigned int firstLevelIndex;
+	unsigned int secondLevelIndex;
+	GetLargeFreeListIndices( blockDataSize, firstLevelIndex, secondLevelIndex );
+	if( isFreeListEmpty )
+	{
+		m_secondLevelBitmaps[ firstLevelIndex ] &= ~( 1U << secondLevelIndex );
+		if( m_secondLevelBitmaps[ firstLevelIndex ] == 0 )
+			m_firstLevelBitmap &= ~( 1U << firstLevelIndex );
 	}
+	else
+	{
+		m_secondLevelBitmaps[ firstLevelIndex ] |= 1U << secondLevelIndex;
+		m_firstLevelBitmap |= 1U << firstLevelIndex;
+	}
+}
 
-	return smallestBlock;
-}
\ No newline at end of file
+
+//-----------------------------------------------------------------------------------------------
+STATIC MetaData* MemoryManager::FindFreeBlock( size_t blockDataSize )
+{
+	unsigned int firstLevelIndex = 0;
+	unsigned int secondLevelIndex = 0;
+	if( blockDataSize < SMALL_BLOCK_SIZE_LIMIT )
+	{
+		unsigned int smallBitmap = m_smallFreeListBitmap & ( ~0U << ( blockDataSize / MEMORY_ALIGNMENT ) );
+		if( smallBitmap != 0 )
+			return m_smallFreeLists[ FindFirstSetBit( smallBitmap ) ];
+	}
+	else
+	{
+		// round up to the next second level step so that every block in the list found is big enough
+		size_t roundedSize = blockDataSize + ( (size_t) 1 << ( FindLastSetBit( blockDataSize ) - SECOND_LEVEL_INDEX_COUNT_LOG2 ) ) - 1;
+		GetLargeFreeListIndices( roundedSize, firstLevelIndex, secondLevelIndex );
+		if( firstLevelIndex >= FIRST_LEVEL_INDEX_COUNT )
+			return nullptr;
+	}
+
+	unsigned int secondLevelBitmap = m_secondLevelBitmaps[ firstLevelIndex ] & ( ~0U << secondLevelIndex );
+	if( secondLevelBitmap == 0 )
+	{
+		unsigned int firstLevelBitmap = 0;
+		if( firstLevelIndex + 1 < FIRST_LEVEL_INDEX_COUNT )
+			firstLevelBitmap = m_firstLevelBitmap & ( ~0U << ( firstLevelIndex + 1 ) );
+
+		if( firstLevelBitmap == 0 )
+			return nullptr;
+
+		firstLevelIndex = FindFirstSetBit( firstLevelBitmap );
+		secondLevelBitmap = m_secondLevelBitmaps[ firstLevelIndex ];
+	}
+
+	return m_freeLists[ firstLevelIndex ][ FindFirstSetBit( secondLevelBitmap ) ];
+}
+
+
+//-----------------------------------------------------------------------------------------------
+STATIC void MemoryManager::InsertFreeBlock( MetaData* block )
+{
+	MetaData** freeListHead = GetFreeListHead( block->m_blockDataSegmentSize );
+	FreeBlockLinks* links = GetFreeBlockLinks( block );
+	links->m_previousFreeBlock = nullptr;
+	links->m_nextFreeBlock = *freeListHead;
+	if( *freeListHead != nullptr )
+		GetFreeBlockLinks( *freeListHead )->m_previousFreeBlock = block;
+
+	*freeListHead = block;
+	UpdateFreeListBitmaps( block->m_blockDataSegmentSize, false );
+	WriteFreeBlockFooter( block );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+STATIC void MemoryManager::RemoveFreeBlock( MetaData* block )
+{
+	MetaData** freeListHead = GetFreeListHead( block->m_blockDataSegmentSize );
+	FreeBlockLinks* links = GetFreeBlockLinks( block );
+	if( links->m_previousFreeBlock != nullptr )
+		GetFreeBlockLinks( links->m_previousFreeBlock )->m_nextFreeBlock = links->m_nextFreeBlock;
+	else
+		*freeListHead = links->m_nextFreeBlock;
+
+	if( links->m_nextFreeBlock != nullptr )
+		GetFreeBlockLinks( links->m_nextFreeBlock )->m_previousFreeBlock = links->m_previousFreeBlock;
+
+	if( *freeListHead == nullptr )
+		UpdateFreeListBitmaps( block->m_blockDataSegmentSize, true );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+STATIC void MemoryManager::SplitBlock( MetaData* block, size_t blockDataSize )
+{
+	if( block->m_blockDataSegmentSize < blockDataSize + BLOCK_HEADER_SIZE + MIN_BLOCK_DATA_SIZE )
+		return;
+
+	MetaData* remainder = (MetaData*) ( reinterpret_cast< byte_t* >( block ) + BLOCK_HEADER_SIZE + blockDataSize );
+	remainder->m_isOccupied = false;
+	remainder->m_isPreviousBlockFree = false;
+	remainder->m_isCached = false;
+	remainder->m_blockDataSegmentSize = block->m_blockDataSegmentSize - blockDataSize - BLOCK_HEADER_SIZE;
+	remainder->m_requestedSize = 0;
+	remainder->m_fileName = nullptr;
+	remainder->m_lineNumber = 0;
+	block->m_blockDataSegmentSize = blockDataSize;
+	InsertFreeBlock( remainder );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+STATIC MetaData* MemoryManager::GetNextPhysicalBlock( MetaData* block )
+{
+	byte_t* nextBlock = reinterpret_cast< byte_t* >( block ) + BLOCK_HEADER_SIZE + block->m_blockDataSegmentSize;
+	if( nextBlock >= m_pool + m_committedSizeInBytes )
+		return nullptr;
+
+	return (MetaData*) nextBlock;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+STATIC MetaData* MemoryManager::GetPreviousFreePhysicalBlock( MetaData* block )
+{
+	if( !block->m_isPreviousBlockFree )
+		return nullptr;
+
+	MetaData** footerOfBlockBefore = (MetaData**) ( reinterpret_cast< byte_t* >( block ) - sizeof( MetaData* ) );
+	return *footerOfBlockBefore;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+STATIC void MemoryManager::WriteFreeBlockFooter( MetaData* block )
+{
+	MetaData* blockAfter = GetNextPhysicalBlock( block );
+	MetaData** footer = (MetaData**) ( reinterpret_cast< byte_t* >( block ) + BLOCK_HEADER_SIZE + block->m_blockDataSegmentSize - sizeof( MetaData* ) );
+	*footer = block;
+	if( blockAfter != nullptr )
+		blockAfter->m_isPreviousBlockFree = true;
+	else
+		m_isLastBlockFree = true;
+}
@@ -3,23 +3,96 @@
 #pragma once
 
 //-----------------------------------------------------------------------------------------------
+#include <windows.h>
 #include "EngineCommon.hpp"
 
 
 //-----------------------------------------------------------------------------------------------
+//The pool is only address space until it is needed. It is committed in chunks as the heap grows,
+//a free tail is decommitted again and the pages of large freed blocks are reset so the OS can drop them.
 const size_t POOL_MEMORY_IN_BYTES = 1024 * 1024 * 512;
+const size_t POOL_COMMIT_CHUNK_SIZE = 1024 * 1024;
+const size_t POOL_INITIAL_COMMIT_IN_BYTES = POOL_COMMIT_CHUNK_SIZE * 4;
+const size_t POOL_DECOMMIT_THRESHOLD = POOL_COMMIT_CHUNK_SIZE * 4;
+const size_t POOL_RESET_THRESHOLD = 1024 * 64;
+const size_t MEMORY_ALIGNMENT = 2 * sizeof( void* );
+
+//Free blocks smaller than SMALL_BLOCK_SIZE_LIMIT live in exact size class lists, one per
+//MEMORY_ALIGNMENT step. Larger blocks are indexed two-level segregated fit style: the first level
+//is the power of two range of the size and the second level splits that range into linear steps.
+const size_t SMALL_BLOCK_SIZE_LIMIT = 256;
+const unsigned int NUM_SMALL_SIZE_CLASSES = SMALL_BLOCK_SIZE_LIMIT / MEMORY_ALIGNMENT;
+const unsigned int FIRST_LEVEL_INDEX_SHIFT = 8;
+const unsigned int FIRST_LEVEL_INDEX_COUNT = 32 - FIRST_LEVEL_INDEX_SHIFT;
+const unsigned int SECOND_LEVEL_INDEX_COUNT_LOG2 = 4;
+const unsigned int SECOND_LEVEL_INDEX_COUNT = 1 << SECOND_LEVEL_INDEX_COUNT_LOG2;
+const unsigned int NUM_FREE_LISTS = NUM_SMALL_SIZE_CLASSES + FIRST_LEVEL_INDEX_COUNT * SECOND_LEVEL_INDEX_COUNT;
+
+static_assert( ( (size_t) 1 << FIRST_LEVEL_INDEX_SHIFT ) == SMALL_BLOCK_SIZE_LIMIT, "The first level index must start where the small size classes end" );
+static_assert( NUM_SMALL_SIZE_CLASSES <= 32, "Small size classes must fit in a 32 bit bitmap" );
+
+//Each thread keeps its own lists of small blocks, moved to and from the locked central heap in batches.
+const unsigned int THREAD_CACHE_BATCH_SIZE = 32;
+const unsigned int THREAD_CACHE_MAX_BLOCKS_PER_CLASS = THREAD_CACHE_BATCH_SIZE * 2;
 
 
 //-----------------------------------------------------------------------------------------------
 struct MetaData
 {
 	size_t			m_blockDataSegmentSize;
+	size_t			m_requestedSize;
 	bool			m_isOccupied;
+	bool			m_isPreviousBlockFree;
+	bool			m_isCached;
+	bool			m_isSampled;
 	const char*		m_fileName;
 	unsigned int	m_lineNumber;
 };
 
 
+//-----------------------------------------------------------------------------------------------
+//Stored in the data segment of free blocks only. The last pointer sized word of a free block's data
+//segment is a footer pointing back at its MetaData, so the block after it can find it in O(1).
+struct FreeBlockLinks
+{
+	MetaData*		m_previousFreeBlock;
+	MetaData*		m_nextFreeBlock;
+};
+
+
+//-----------------------------------------------------------------------------------------------
+//Cached blocks stay occupied as far as the central heap is concerned and are linked through
+//FreeBlockLinks::m_nextFreeBlock. Statistics are only written by the owning thread; the statistics getters
+//add every live cache in, so they can trail that thread's latest allocations by a few updates.
+struct ThreadAllocationCache
+{
+	MetaData*				m_cachedBlocks[ NUM_SMALL_SIZE_CLASSES ];
+	unsigned int			m_numCachedBlocks[ NUM_SMALL_SIZE_CLASSES ];
+	size_t					m_numAllocationsRequested;
+	size_t					m_totalNumBytesAllocated;
+	ptrdiff_t				m_currentNumBytesAllocated;
+	size_t					m_largestAllocation;
+	ThreadAllocationCache*	m_previousCache;
+	ThreadAllocationCache*	m_nextCache;
+};
+
+
+//-----------------------------------------------------------------------------------------------
+//Object pools carve their slabs out of the heap like any other allocation. They register one of
+//these so the memory statistics can also report how full those slabs are. Shared pools nobody owns
+//also leave a function that destroys them, for DestroySharedObjectPools at shutdown.
+struct ObjectPoolStatistics
+{
+	const char*				m_poolName;
+	size_t					m_objectSizeInBytes;
+	size_t					m_numLiveObjects;
+	size_t					m_numSlots;
+	void					(*m_destroySharedPoolFunction)();
+	ObjectPoolStatistics*	m_previousPool;
+	ObjectPoolStatistics*	m_nextPool;
+};
+
+
 //-----------------------------------------------------------------------------------------------
 class MemoryManager
 {
@@ -30,6 +103,7 @@ public:
 	static void* AllocateMemory( size_t objectSizeInBytes );
 	static void* AllocateMemory( size_t objectSizeInBytes, const char* file, unsigned int line );
 	static void FreeMemory( void* data );
+	static void FlushThreadCache();
 	static bool IsMemoryManagerAvailable();
 	static void CheckForMemoryLeaks();
 	static size_t GetNumberOfAllocationRequest();
@@ -41,19 +115,62 @@ public:
 	static size_t GetSmallestFreeBlockSize();
 	static size_t GetLargestFreeBlockSize( size_t maxBlockSize );
 	static size_t GetSmallestFreeBlockSize( size_t minBlockSize );
+	static size_t GetCommittedSizeInBytes();
+	static void RegisterObjectPool( ObjectPoolStatistics* poolStatistics );
+	static void UnregisterObjectPool( ObjectPoolStatistics* poolStatistics );
+	static void DestroySharedObjectPools();
+	static size_t GetNumPooledBytesInUse();
+	static size_t GetNumPooledBytesReserved();
+	static void ReportObjectPoolOccupancy();
+#ifdef _DEBUG
+	static bool ValidateHeap();
+#endif
 
 private:
+	static MetaData* AllocateBlock( size_t blockDataSize );
+	static void ReleaseBlock( MetaData* block );
+	static bool CommitMoreMemory( size_t blockDataSize );
+	static void DecommitFreeTail( MetaData* lastBlock );
+	static void ResetFreedPages( byte_t* freedDataStart, byte_t* freedDataEnd );
+	static ThreadAllocationCache* GetOrCreateThreadCache();
+	static void RefillThreadCache( ThreadAllocationCache* cache, size_t blockDataSize );
+	static void ReturnCachedBlocks( ThreadAllocationCache* cache, unsigned int sizeClassIndex, unsigned int numBlocksToReturn );
+	static void GatherStatistics( size_t& numAllocationsRequested_out, size_t& totalNumBytesAllocated_out, size_t& currentNumBytesAllocated_out, size_t& largestAllocation_out );
+#ifdef _DEBUG
+	static bool IsHeapConsistent();
+#endif
 	static MetaData* GetLargestFreeBlock();
 	static MetaData* GetSmallestFreeBlock();
 	static MetaData* GetLargestFreeBlock( size_t maxBlockSize );
 	static MetaData* GetSmallestFreeBlock( size_t minBlockSize );
+	static MetaData** GetFreeListHead( size_t blockDataSize );
+	static MetaData* GetFreeListHeadByIndex( unsigned int freeListIndex );
+	static void UpdateFreeListBitmaps( size_t blockDataSize, bool isFreeListEmpty );
+	static MetaData* FindFreeBlock( size_t blockDataSize );
+	static void InsertFreeBlock( MetaData* block );
+	static void RemoveFreeBlock( MetaData* block );
+	static void SplitBlock( MetaData* block, size_t blockDataSize );
+	static MetaData* GetNextPhysicalBlock( MetaData* block );
+	static MetaData* GetPreviousFreePhysicalBlock( MetaData* block );
+	static void WriteFreeBlockFooter( MetaData* block );
 
-	static byte_t*	m_pool;
-	static size_t	m_poolSizeInBytes;
-	static size_t	m_numAllocationsRequested;
-	static size_t	m_totalNumBytesAllocated;
-	static size_t	m_currentNumBytesAllocated;
-	static size_t	m_largestAllocation;
+	static byte_t*					m_pool;
+	static size_t					m_reservedSizeInBytes;
+	static size_t					m_committedSizeInBytes;
+	static bool						m_isLastBlockFree;
+	static bool						m_areLargePagesInUse;
+	static size_t					m_numAllocationsRequested;
+	static size_t					m_totalNumBytesAllocated;
+	static size_t					m_currentNumBytesAllocated;
+	static size_t					m_largestAllocation;
+	static unsigned int				m_smallFreeListBitmap;
+	static unsigned int				m_firstLevelBitmap;
+	static unsigned int				m_secondLevelBitmaps[ FIRST_LEVEL_INDEX_COUNT ];
+	static MetaData*				m_smallFreeLists[ NUM_SMALL_SIZE_CLASSES ];
+	static MetaData*				m_freeLists[ FIRST_LEVEL_INDEX_COUNT ][ SECOND_LEVEL_INDEX_COUNT ];
+	static CRITICAL_SECTION			m_centralHeapCS;
+	static ThreadAllocationCache*	m_threadCaches;
+	static ObjectPoolStatistics*	m_objectPools;
 };
 
 
@@ -5,6 +5,7 @@
 //-----------------------------------------------------------------------------------------------
 #include <map>
 #include <string>
+#include "ObjectPool.hpp"
 
 
 //-----------------------------------------------------------------------------------------------
@@ -27,7 +28,7 @@ public:
 
 //-----------------------------------------------------------------------------------------------
 template< typename T_PropertyDataType >
-class TypeNamedProperties : public NamedPropertiesBase
+class TypeNamedProperties : public NamedPropertiesBase, public PooledObject< TypeNamedProperties< T_PropertyDataType > >
 {
 public:
 	T_PropertyDataType	m_data;
@@ -73,10 +74,8 @@ inline void NamedProperties::SetProperty( const std::string& propertyName, const
 template< typename T_PropertyDataType >
 inline PropertyGetResult NamedProperties::GetProperty( const std::string& propertyName, T_PropertyDataType& typedData_out ) const
 {
-	std::map< std::string, NamedPropertiesBase* > tempProperties = m_properties;
-
-	std::map< std::string, NamedPropertiesBase* >::iterator mapIter = tempProperties.find( propertyName );
-	if( mapIter == tempProperties.end() )
+	std::map< std::string, NamedPropertiesBase* >::const_iterator mapIter = m_properties.find( propertyName );
+	if( mapIter == m_properties.end() )
 	{
 		return PROPERTY_GET_FAILED_NOT_FOUND;
 	}
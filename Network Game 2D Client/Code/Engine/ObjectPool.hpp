@@ -0,0 +1,338 @@
+#ifndef include_ObjectPool
+#define include_ObjectPool
+#pragma once
+
+//-----------------------------------------------------------------------------------------------
+#include <new>
+#include <vector>
+#include <typeinfo>
+#include <assert.h>
+#include <windows.h>
+#include "EngineCommon.hpp"
+#include "MemoryManager.hpp"
+
+
+//-----------------------------------------------------------------------------------------------
+const unsigned int DEFAULT_OBJECT_POOL_SLOTS_PER_SLAB = 64;
+const unsigned int INVALID_OBJECT_SLOT_INDEX = 0xffffffff;
+
+
+//-----------------------------------------------------------------------------------------------
+//A handle stays safe to keep after its object is destroyed: the slot's generation is bumped on
+//every destroy, so resolving a stale handle returns nullptr instead of whatever reused the slot.
+struct ObjectHandle
+{
+	ObjectHandle() : m_slotIndex( INVALID_OBJECT_SLOT_INDEX ), m_generation( 0 ) {}
+
+	unsigned int	m_slotIndex;
+	unsigned int	m_generation;
+};
+
+
+//-----------------------------------------------------------------------------------------------
+//Fixed size slots carved out of slabs that are never returned until the pool is destroyed. Free
+//slots form a singly linked list threaded through their own storage. Only thread safe if asked.
+template< typename T >
+class ObjectPool
+{
+public:
+	ObjectPool( const char* poolName, unsigned int numSlotsPerSlab = DEFAULT_OBJECT_POOL_SLOTS_PER_SLAB, bool isThreadSafe = false );
+	~ObjectPool();
+	T* Create();
+	template< typename T_Argument >
+		T* Create( const T_Argument& argument );
+	void Destroy( T* object );
+	void* AllocateSlot();
+	void FreeSlot( void* data );
+	ObjectHandle GetHandle( const T* object ) const;
+	T* Resolve( const ObjectHandle& handle ) const;
+	template< typename T_Function >
+		void ForEachLiveObject( T_Function function );
+	void SetDestroySharedPoolFunction( void (*destroySharedPoolFunction)() ) { m_statistics.m_destroySharedPoolFunction = destroySharedPoolFunction; }
+	size_t GetNumLiveObjects() const { return m_statistics.m_numLiveObjects; }
+	size_t GetNumSlots() const { return m_statistics.m_numSlots; }
+
+private:
+	struct Slot
+	{
+		union
+		{
+			byte_t		m_storage[ sizeof( T ) ];
+			Slot*		m_nextFreeSlot;
+			double		m_alignAsDouble;
+			long long	m_alignAsLongLong;
+		};
+		unsigned int	m_slotIndex;
+		unsigned int	m_generation;
+		bool			m_isLive;
+	};
+
+	ObjectPool( const ObjectPool& );
+	void operator=( const ObjectPool& );
+	void Lock() { if( m_isThreadSafe ) EnterCriticalSection( &m_cs ); }
+	void Unlock() { if( m_isThreadSafe ) LeaveCriticalSection( &m_cs ); }
+	void AddSlab();
+
+	std::vector< Slot* >	m_slabs;
+	Slot*					m_firstFreeSlot;
+	unsigned int			m_numSlotsPerSlab;
+	bool					m_isThreadSafe;
+	CRITICAL_SECTION		m_cs;
+	ObjectPoolStatistics	m_statistics;
+};
+
+
+//-----------------------------------------------------------------------------------------------
+template< typename T >
+inline ObjectPool< T >::ObjectPool( const char* poolName, unsigned int numSlotsPerSlab, bool isThreadSafe )
+	: m_firstFreeSlot( nullptr )
+	, m_numSlotsPerSlab( numSlotsPerSlab )
+	, m_isThreadSafe( isThreadSafe )
+{
+	if( m_isThreadSafe )
+		InitializeCriticalSection( &m_cs );
+
+	m_statistics.m_poolName = poolName;
+	m_statistics.m_objectSizeInBytes = sizeof( T );
+	m_statistics.m_numLiveObjects = 0;
+	m_statistics.m_numSlots = 0;
+	m_statistics.m_destroySharedPoolFunction = nullptr;
+	MemoryManager::RegisterObjectPool( &m_statistics );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+template< typename T >
+inline ObjectPool< T >::~ObjectPool()
+{
+	assert( m_statistics.m_numLiveObjects == 0 );
+	MemoryManager::UnregisterObjectPool( &m_statistics );
+
+	for( unsigned int slabIndex = 0; slabIndex < m_slabs.size(); ++slabIndex )
+		::operator delete( m_slabs[ slabIndex ] );
+
+	m_slabs.clear();
+	if( m_isThreadSafe )
+		DeleteCriticalSection( &m_cs );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+template< typename T >
+inline T* ObjectPool< T >::Create()
+{
+	return ::new( AllocateSlot() ) T();
+}
+
+
+//-----------------------------------------------------------------------------------------------
+template< typename T >
+template< typename T_Argument >
+inline T* ObjectPool< T >::Create( const T_Argument& argument )
+{
+	return ::new( AllocateSlot() ) T( argument );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+template< typename T >
+inline void ObjectPool< T >::Destroy( T* object )
+{
+	if( object == nullptr )
+		return;
+
+	object->~T();
+	FreeSlot( object );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+template< typename T >
+inline void* ObjectPool< T >::AllocateSlot()
+{
+	Lock();
+	if( m_firstFreeSlot == nullptr )
+		AddSlab();
+
+	Slot* slot = m_firstFreeSlot;
+	m_firstFreeSlot = slot->m_nextFreeSlot;
+	slot->m_isLive = true;
+	++m_statistics.m_numLiveObjects;
+	Unlock();
+
+	return slot->m_storage;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+template< typename T >
+inline void ObjectPool< T >::FreeSlot( void* data )
+{
+	Slot* slot = reinterpret_cast< Slot* >( data );
+	assert( slot->m_isLive );
+
+	Lock();
+	slot->m_isLive = false;
+	++slot->m_generation;
+	if( slot->m_generation == 0 )
+		slot->m_generation = 1;
+
+	slot->m_nextFreeSlot = m_firstFreeSlot;
+	m_firstFreeSlot = slot;
+	--m_statistics.m_numLiveObjects;
+	Unlock();
+}
+
+
+//-----------------------------------------------------------------------------------------------
+template< typename T >
+inline ObjectHandle ObjectPool< T >::GetHandle( const T* object ) const
+{
+	ObjectHandle handle;
+	if( object == nullptr )
+		return handle;
+
+	const Slot* slot = reinterpret_cast< const Slot* >( object );
+	handle.m_slotIndex = slot->m_slotIndex;
+	handle.m_generation = slot->m_generation;
+	return handle;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+template< typename T >
+inline T* ObjectPool< T >::Resolve( const ObjectHandle& handle ) const
+{
+	unsigned int slabIndex = handle.m_slotIndex / m_numSlotsPerSlab;
+	if( handle.m_slotIndex == INVALID_OBJECT_SLOT_INDEX || slabIndex >= m_slabs.size() )
+		return nullptr;
+
+	Slot* slot = &m_slabs[ slabIndex ][ handle.m_slotIndex % m_numSlotsPerSlab ];
+	if( !slot->m_isLive || slot->m_generation != handle.m_generation )
+		return nullptr;
+
+	return reinterpret_cast< T* >( slot->m_storage );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+//Visits live objects slab by slab in address order. Objects must not be created or destroyed by
+//the function while iterating.
+template< typename T >
+template< typename T_Function >
+inline void ObjectPool< T >::ForEachLiveObject( T_Function function )
+{
+	for( unsigned int slabIndex = 0; slabIndex < m_slabs.size(); ++slabIndex )
+	{
+		Slot* slab = m_slabs[ slabIndex ];
+		for( unsigned int slotIndex = 0; slotIndex < m_numSlotsPerSlab; ++slotIndex )
+		{
+			if( slab[ slotIndex ].m_isLive )
+				function( *reinterpret_cast< T* >( slab[ slotIndex ].m_storage ) );
+		}
+	}
+}
+
+
+//-----------------------------------------------------------------------------------------------
+template< typename T >
+inline void ObjectPool< T >::AddSlab()
+{
+	Slot* slab = static_cast< Slot* >( ::operator new( sizeof( Slot ) * m_numSlotsPerSlab ) );
+	unsigned int firstSlotIndex = (unsigned int) m_slabs.size() * m_numSlotsPerSlab;
+	m_slabs.push_back( slab );
+
+	// thread the free list in address order so fresh slabs fill front to back
+	for( unsigned int slotIndex = 0; slotIndex < m_numSlotsPerSlab; ++slotIndex )
+	{
+		Slot& slot = slab[ slotIndex ];
+		slot.m_slotIndex = firstSlotIndex + slotIndex;
+		slot.m_generation = 1;
+		slot.m_isLive = false;
+		slot.m_nextFreeSlot = ( slotIndex + 1 < m_numSlotsPerSlab ) ? &slab[ slotIndex + 1 ] : m_firstFreeSlot;
+	}
+
+	m_firstFreeSlot = slab;
+	m_statistics.m_numSlots += m_numSlotsPerSlab;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+//Routes a class's new and delete through a shared, thread safe pool. A class deriving further
+//from a pooled class without its own PooledObject base is bigger than a slot and falls back to
+//the general heap, which is why delete has to be given the size. The pool is destroyed by
+//MemoryManager::DestroySharedObjectPools, which asserts every object was deleted by then.
+template< typename T >
+class PooledObject
+{
+public:
+	static void* operator new( size_t size );
+	static void* operator new( size_t size, const char*, unsigned int ) { return operator new( size ); }
+	static void operator delete( void* data, size_t size );
+	static void operator delete( void* data, const char*, unsigned int ) { operator delete( data, sizeof( T ) ); }
+	static ObjectPool< T >& GetPool();
+
+private:
+	static void DestroyPool();
+
+	static ObjectPool< T >* volatile	s_pool;
+};
+
+
+//-----------------------------------------------------------------------------------------------
+template< typename T >
+ObjectPool< T >* volatile PooledObject< T >::s_pool = nullptr;
+
+
+//-----------------------------------------------------------------------------------------------
+template< typename T >
+inline STATIC void* PooledObject< T >::operator new( size_t size )
+{
+	if( size != sizeof( T ) )
+		return ::operator new( size );
+
+	return GetPool().AllocateSlot();
+}
+
+
+//-----------------------------------------------------------------------------------------------
+template< typename T >
+inline STATIC void PooledObject< T >::operator delete( void* data, size_t size )
+{
+	if( data == nullptr )
+		return;
+
+	if( size != sizeof( T ) )
+		::operator delete( data );
+	else
+		GetPool().FreeSlot( data );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+template< typename T >
+inline STATIC ObjectPool< T >& PooledObject< T >::GetPool()
+{
+	if( s_pool == nullptr )
+	{
+		ObjectPool< T >* newPool = ::new ObjectPool< T >( typeid( T ).name(), DEFAULT_OBJECT_POOL_SLOTS_PER_SLAB, true );
+		if( InterlockedCompareExchangePointer( reinterpret_cast< void* volatile* >( &s_pool ), newPool, nullptr ) != nullptr )
+			delete newPool;
+		else
+			newPool->SetDestroySharedPoolFunction( &DestroyPool );
+	}
+
+	return *s_pool;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+template< typename T >
+inline STATIC void PooledObject< T >::DestroyPool()
+{
+	ObjectPool< T >* pool = static_cast< ObjectPool< T >* >( InterlockedExchangePointer( reinterpret_cast< void* volatile* >( &s_pool ), nullptr ) );
+	delete pool;
+}
+
+
+#endif // include_ObjectPool
\ No newline at end of file
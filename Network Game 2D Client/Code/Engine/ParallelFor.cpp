@@ -0,0 +1,191 @@
+#include "ParallelFor.hpp"
+#include <math.h>
+#include <assert.h>
+#include "Time.hpp"
+#include "EngineCommon.hpp"
+#include "NewMacroDef.hpp"
+
+
+//-----------------------------------------------------------------------------------------------
+const unsigned int BENCHMARK_ITERATIONS_PER_ELEMENT = 16;
+
+
+//-----------------------------------------------------------------------------------------------
+//The cursor counts from beginIndex, so only the length of the range has to fit in a LONG.
+ParallelLoop::ParallelLoop( unsigned int beginIndex, unsigned int endIndex, unsigned int grainSize )
+	: m_beginIndex( beginIndex )
+	, m_nextOffset( 0 )
+	, m_numIndices( 0 )
+	, m_grainSize( ( grainSize == 0 || grainSize > MAXLONG ) ? 1 : (LONG) grainSize )
+	, m_numParticipants( 1 )
+	, m_numParticipantsJoined( 0 )
+{
+	if( endIndex <= beginIndex )
+		return;
+
+	assert( endIndex - beginIndex <= (unsigned int) MAXLONG );
+	m_numIndices = (LONG) ( endIndex - beginIndex );
+
+	unsigned int numChunks = (unsigned int) ( m_numIndices / m_grainSize ) + ( ( m_numIndices % m_grainSize != 0 ) ? 1 : 0 );
+	m_numParticipants = JobManager::GetNumGenericWorkerThreads() + 1;
+	if( m_numParticipants > numChunks )
+		m_numParticipants = numChunks;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void ParallelLoop::SetMaxNumParticipants( unsigned int maxNumParticipants )
+{
+	if( maxNumParticipants != 0 && m_numParticipants > maxNumParticipants )
+		m_numParticipants = maxNumParticipants;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+//Helpers belong to the loop rather than the JobManager, so they can be taken back and run here
+//once the range is used up; a helper that starts late finds no chunks left and returns at once.
+void ParallelLoop::Run()
+{
+	if( m_nextOffset >= m_numIndices )
+		return;
+
+	if( m_numParticipants == 1 )
+	{
+		RunParticipant();
+		return;
+	}
+
+	JobCounter helpersDone;
+	std::vector< ParallelLoopJob* > helperJobs;
+	helperJobs.reserve( m_numParticipants - 1 );
+	for( unsigned int helperIndex = 1; helperIndex < m_numParticipants; ++helperIndex )
+	{
+		ParallelLoopJob* helperJob = new ParallelLoopJob( this );
+		helperJob->m_isOwnedByWaiter = true;
+		helperJobs.push_back( helperJob );
+		JobManager::AddNewJob( helperJob, &helpersDone );
+	}
+
+	RunParticipant();
+	for( unsigned int helperIndex = 0; helperIndex < helperJobs.size(); ++helperIndex )
+		JobManager::RunQueuedJob( helperJobs[ helperIndex ] );
+
+	JobManager::WaitFor( &helpersDone );
+	for( unsigned int helperIndex = 0; helperIndex < helperJobs.size(); ++helperIndex )
+		delete helperJobs[ helperIndex ];
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void ParallelLoop::RunParticipant()
+{
+	unsigned int participantIndex = (unsigned int) InterlockedIncrement( &m_numParticipantsJoined ) - 1;
+
+	unsigned int chunkBeginIndex = 0;
+	unsigned int chunkEndIndex = 0;
+	while( ClaimChunk( chunkBeginIndex, chunkEndIndex ) )
+		RunChunk( chunkBeginIndex, chunkEndIndex, participantIndex );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+bool ParallelLoop::ClaimChunk( unsigned int& chunkBeginIndex_out, unsigned int& chunkEndIndex_out )
+{
+	while( true )
+	{
+		LONG beginOffset = m_nextOffset;
+		LONG numIndicesLeft = m_numIndices - beginOffset;
+		if( numIndicesLeft <= 0 )
+			return false;
+
+		LONG chunkSize = numIndicesLeft / (LONG) ( m_numParticipants * PARALLEL_CHUNKS_PER_PARTICIPANT );
+		if( chunkSize < m_grainSize )
+			chunkSize = m_grainSize;
+		if( chunkSize > numIndicesLeft )
+			chunkSize = numIndicesLeft;
+
+		if( InterlockedCompareExchange( &m_nextOffset, beginOffset + chunkSize, beginOffset ) == beginOffset )
+		{
+			chunkBeginIndex_out = m_beginIndex + (unsigned int) beginOffset;
+			chunkEndIndex_out = m_beginIndex + (unsigned int) ( beginOffset + chunkSize );
+			return true;
+		}
+	}
+}
+
+
+//-----------------------------------------------------------------------------------------------
+ParallelLoopJob::ParallelLoopJob( ParallelLoop* loop )
+	: Job( HIGH_PRIORITY )
+	, m_loop( loop )
+{
+
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void ParallelLoopJob::Execute()
+{
+	m_loop->RunParticipant();
+}
+
+
+//-----------------------------------------------------------------------------------------------
+struct BenchmarkTransform
+{
+	BenchmarkTransform( const float* inputs, float* outputs ) : m_inputs( inputs ), m_outputs( outputs ) {}
+
+	void operator()( unsigned int elementIndex ) const
+	{
+		float value = m_inputs[ elementIndex ];
+		for( unsigned int iteration = 0; iteration < BENCHMARK_ITERATIONS_PER_ELEMENT; ++iteration )
+			value = sqrtf( value * value + 1.f ) * 0.5f + sinf( value ) * 0.25f;
+
+		m_outputs[ elementIndex ] = value;
+	}
+
+	const float*	m_inputs;
+	float*			m_outputs;
+};
+
+
+//-----------------------------------------------------------------------------------------------
+struct BenchmarkElementValue
+{
+	BenchmarkElementValue( const float* values ) : m_values( values ) {}
+	double operator()( unsigned int elementIndex ) const { return m_values[ elementIndex ]; }
+
+	const float*	m_values;
+};
+
+
+//-----------------------------------------------------------------------------------------------
+static double AddBenchmarkValues( double first, double second )
+{
+	return first + second;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+ParallelForBenchmarkResults RunParallelForBenchmark( unsigned int numElements, unsigned int maxNumParticipants )
+{
+	ParallelForBenchmarkResults results;
+	results.m_numElements = numElements;
+
+	std::vector< float > inputs( numElements + 1 );
+	std::vector< float > outputs( numElements + 1 );
+	for( unsigned int elementIndex = 0; elementIndex < numElements; ++elementIndex )
+		inputs[ elementIndex ] = (float) ( elementIndex % 1000 ) * 0.001f;
+
+	BenchmarkTransform transform( &inputs[ 0 ], &outputs[ 0 ] );
+	ParallelForLoop< BenchmarkTransform > loop( 0, numElements, DEFAULT_PARALLEL_GRAIN_SIZE, transform );
+	loop.SetMaxNumParticipants( maxNumParticipants );
+	results.m_numParticipants = loop.GetNumParticipants();
+
+	double startTime = GetCurrentTimeSeconds();
+	loop.Run();
+	results.m_secondsElapsed = GetCurrentTimeSeconds() - startTime;
+
+	results.m_checksum = ParallelReduce( 0, numElements, DEFAULT_PARALLEL_GRAIN_SIZE * 16, 0.0, BenchmarkElementValue( &outputs[ 0 ] ), AddBenchmarkValues );
+	return results;
+}
\ No newline at end of file
@@ -0,0 +1,173 @@
+#ifndef include_ParallelFor
+#define include_ParallelFor
+#pragma once
+
+//-----------------------------------------------------------------------------------------------
+#include <vector>
+#include <windows.h>
+#include "JobManager.hpp"
+#include "EngineCommon.hpp"
+
+
+//-----------------------------------------------------------------------------------------------
+const unsigned int DEFAULT_PARALLEL_GRAIN_SIZE = 64;
+const unsigned int PARALLEL_CHUNKS_PER_PARTICIPANT = 2;
+
+
+//-----------------------------------------------------------------------------------------------
+//Splits [beginIndex, endIndex) between the calling thread and helper jobs on the generic workers.
+//Chunks are claimed from a shared cursor and shrink as the range runs out, each one a share of
+//what is left but never smaller than the grain size, so early chunks are big and cheap to hand
+//out while the last ones even out the finish. The caller runs chunks too, then runs any helper
+//job no worker has started yet itself and waits for the rest; inside a job that wait helps with
+//other jobs, so nesting a loop inside a job is safe. The range may hold at most MAXLONG indices.
+class ParallelLoop
+{
+public:
+	ParallelLoop( unsigned int beginIndex, unsigned int endIndex, unsigned int grainSize );
+	virtual ~ParallelLoop() {}
+	void SetMaxNumParticipants( unsigned int maxNumParticipants );
+	void Run();
+	void RunParticipant();
+	unsigned int GetNumParticipants() const { return m_numParticipants; }
+
+protected:
+	virtual void RunChunk( unsigned int chunkBeginIndex, unsigned int chunkEndIndex, unsigned int participantIndex ) = 0;
+
+private:
+	bool ClaimChunk( unsigned int& chunkBeginIndex_out, unsigned int& chunkEndIndex_out );
+
+	unsigned int		m_beginIndex;
+	volatile LONG		m_nextOffset;
+	LONG				m_numIndices;
+	LONG				m_grainSize;
+	unsigned int		m_numParticipants;
+	volatile LONG		m_numParticipantsJoined;
+};
+
+
+//-----------------------------------------------------------------------------------------------
+class ParallelLoopJob : public Job, public PooledObject< ParallelLoopJob >
+{
+public:
+	ParallelLoopJob( ParallelLoop* loop );
+	void Execute();
+
+private:
+	ParallelLoop*	m_loop;
+};
+
+
+//-----------------------------------------------------------------------------------------------
+template< typename T_Function >
+class ParallelForLoop : public ParallelLoop
+{
+public:
+	ParallelForLoop( unsigned int beginIndex, unsigned int endIndex, unsigned int grainSize, T_Function& function )
+		: ParallelLoop( beginIndex, endIndex, grainSize )
+		, m_function( function )
+	{}
+
+protected:
+	void RunChunk( unsigned int chunkBeginIndex, unsigned int chunkEndIndex, unsigned int )
+	{
+		for( unsigned int index = chunkBeginIndex; index < chunkEndIndex; ++index )
+			m_function( index );
+	}
+
+private:
+	void operator=( const ParallelForLoop& );
+
+	T_Function&		m_function;
+};
+
+
+//-----------------------------------------------------------------------------------------------
+//Every participant folds into its own cache line sized partial result, and the partials are
+//combined at the end. Which chunks land in which partial changes from run to run, so combine has
+//to be associative and commutative and identity has to leave any value unchanged; floating point
+//sums come out within rounding of each other rather than bit for bit the same.
+template< typename T_Value, typename T_Function, typename T_Combine >
+class ParallelReduceLoop : public ParallelLoop
+{
+public:
+	ParallelReduceLoop( unsigned int beginIndex, unsigned int endIndex, unsigned int grainSize, const T_Value& identity, T_Function& function, T_Combine& combine )
+		: ParallelLoop( beginIndex, endIndex, grainSize )
+		, m_identity( identity )
+		, m_function( function )
+		, m_combine( combine )
+		, m_partialResults( GetNumParticipants() )
+	{
+		for( unsigned int participantIndex = 0; participantIndex < m_partialResults.size(); ++participantIndex )
+			m_partialResults[ participantIndex ].m_value = identity;
+	}
+
+	T_Value CombinePartialResults()
+	{
+		T_Value result = m_identity;
+		for( unsigned int participantIndex = 0; participantIndex < m_partialResults.size(); ++participantIndex )
+			result = m_combine( result, m_partialResults[ participantIndex ].m_value );
+
+		return result;
+	}
+
+protected:
+	void RunChunk( unsigned int chunkBeginIndex, unsigned int chunkEndIndex, unsigned int participantIndex )
+	{
+		T_Value partialResult = m_partialResults[ participantIndex ].m_value;
+		for( unsigned int index = chunkBeginIndex; index < chunkEndIndex; ++index )
+			partialResult = m_combine( partialResult, m_function( index ) );
+
+		m_partialResults[ participantIndex ].m_value = partialResult;
+	}
+
+private:
+	struct PartialResult
+	{
+		T_Value		m_value;
+		byte_t		m_padding[ CACHE_LINE_SIZE_IN_BYTES ];
+	};
+
+	void operator=( const ParallelReduceLoop& );
+
+	T_Value							m_identity;
+	T_Function&						m_function;
+	T_Combine&						m_combine;
+	std::vector< PartialResult >	m_partialResults;
+};
+
+
+//-----------------------------------------------------------------------------------------------
+template< typename T_Function >
+inline void ParallelFor( unsigned int beginIndex, unsigned int endIndex, unsigned int grainSize, T_Function function )
+{
+	ParallelForLoop< T_Function > loop( beginIndex, endIndex, grainSize, function );
+	loop.Run();
+}
+
+
+//-----------------------------------------------------------------------------------------------
+template< typename T_Value, typename T_Function, typename T_Combine >
+inline T_Value ParallelReduce( unsigned int beginIndex, unsigned int endIndex, unsigned int grainSize, const T_Value& identity, T_Function function, T_Combine combine )
+{
+	ParallelReduceLoop< T_Value, T_Function, T_Combine > loop( beginIndex, endIndex, grainSize, identity, function, combine );
+	loop.Run();
+	return loop.CombinePartialResults();
+}
+
+
+//-----------------------------------------------------------------------------------------------
+struct ParallelForBenchmarkResults
+{
+	unsigned int	m_numElements;
+	unsigned int	m_numParticipants;
+	double			m_secondsElapsed;
+	double			m_checksum;
+};
+
+
+//-----------------------------------------------------------------------------------------------
+ParallelForBenchmarkResults RunParallelForBenchmark( unsigned int numElements, unsigned int maxNumParticipants );
+
+
+#endif // include_ParallelFor
\ No newline at end of file
@@ -1,5 +1,6 @@
 #include "ProfileSection.hpp"
 #include "Time.hpp"
+#include "JobManager.hpp"
 #include "EngineCommon.hpp"
 #include "OpenGLRenderer.hpp"
 #include "StringFunctions.hpp"
@@ -88,6 +89,15 @@ STATIC void ProfileSection::RenderProfileInfo( const Vector2& windowDimensions )
 	
 		++profileCount;
 	}
+
+	std::vector< std::string > jobReportLines;
+	JobManager::GetStatisticsReport( jobReportLines );
+	float jobReportPositionY = ( windowDimensions.y - 50.f ) - ( profileCount * 3.f * PROFILE_SECTION_FONT_CELL_HEIGHT );
+	for( unsigned int lineIndex = 0; lineIndex < jobReportLines.size(); ++lineIndex )
+	{
+		OpenGLRenderer::RenderText( jobReportLines[ lineIndex ], s_font, PROFILE_SECTION_DETAIL_FONT_CELL_HEIGHT, Vector2( 30.f, jobReportPositionY ) );
+		jobReportPositionY -= PROFILE_SECTION_DETAIL_FONT_CELL_HEIGHT;
+	}
 }
 
 
@@ -10,6 +10,7 @@
 
 //-----------------------------------------------------------------------------------------------
 const float PROFILE_SECTION_FONT_CELL_HEIGHT = 30.f;
+const float PROFILE_SECTION_DETAIL_FONT_CELL_HEIGHT = 15.f;
 const std::string PROFILE_SECTION_FONT_GLYPH_SHEET_FILE_NAME = "../Data/Fonts/MainFont_EN_00.png";
 const std::string PROFILE_SECTION_FONT_META_DATA_FILE_NAME = "../Data/Fonts/MainFont_EN.FontDef.xml";
 
@@ -71,6 +71,13 @@ std::string ConvertNumberToString( double number )
 }
 
 
+//-----------------------------------------------------------------------------------------------
+std::string ConvertNumberToHexString( unsigned long long number )
+{
+	return "0x" + static_cast< std::ostringstream* >( &( std::ostringstream() << std::hex << number ) )->str();
+}
+
+
 //-----------------------------------------------------------------------------------------------
 std::string ConvertAddressToString( void* ptr )
 {
@@ -16,6 +16,7 @@ std::string ConvertNumberToString( int number );
 std::string ConvertNumberToString( size_t number );
 std::string ConvertNumberToString( float number );
 std::string ConvertNumberToString( double number );
+std::string ConvertNumberToHexString( unsigned long long number );
 std::string ConvertAddressToString( void* ptr );
 std::vector<std::string> GetVectorOfStringsFromSingleString( const std::string& listString, const char separatorChar );
 std::string GetShortenedFileName( const std::string& fileName );
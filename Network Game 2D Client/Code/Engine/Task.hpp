@@ -0,0 +1,123 @@
+#ifndef include_Task
+#define include_Task
+#pragma once
+
+//-----------------------------------------------------------------------------------------------
+#include "Job.hpp"
+#include "JobManager.hpp"
+#include "ObjectPool.hpp"
+
+
+//-----------------------------------------------------------------------------------------------
+struct IgnoreTaskResult
+{
+	template< typename T_Result >
+		void operator()( const T_Result& ) const {}
+};
+
+
+//-----------------------------------------------------------------------------------------------
+//Runs a task's function as an ordinary job. The job keeps its own copy of the result for the
+//continuation, which is called on the main thread from JobManager::Update like any callback.
+template< typename T_Result, typename T_Function, typename T_Continuation >
+class TaskJob : public Job, public PooledObject< TaskJob< T_Result, T_Function, T_Continuation > >
+{
+public:
+	TaskJob( const T_Function& function, const T_Continuation& continuation, T_Result* result_out, priorityRating priority );
+	void Execute();
+	void FireCallbackEvent();
+
+private:
+	T_Function		m_function;
+	T_Continuation	m_continuation;
+	T_Result		m_result;
+	T_Result*		m_result_out;
+};
+
+
+//-----------------------------------------------------------------------------------------------
+//A multi step flow written as one function instead of a callback per step. The function awaits
+//each step through JobManager::AwaitJob, AwaitSeconds or WaitFor; with jobs on fibers that only
+//suspends the task, otherwise the worker helps with other jobs while it waits. The task object
+//owns the result and has to outlive the job, which Await guarantees. The await functions assert
+//that they run on a worker. Only await a task from the main thread if it never waits on timers or
+//packets, since both are signalled from there.
+template< typename T_Result >
+class Task
+{
+public:
+	Task() : m_result() {}
+	template< typename T_Function >
+		void Start( const T_Function& function, priorityRating priority = AVERAGE_PRIORITY );
+	bool IsDone() const { return m_completionCounter.IsDone(); }
+	const T_Result& Await();
+	JobCounter* GetCompletionCounter() { return &m_completionCounter; }
+
+private:
+	Task( const Task& );
+	void operator=( const Task& );
+
+	JobCounter		m_completionCounter;
+	T_Result		m_result;
+};
+
+
+//-----------------------------------------------------------------------------------------------
+template< typename T_Result, typename T_Function, typename T_Continuation >
+inline TaskJob< T_Result, T_Function, T_Continuation >::TaskJob( const T_Function& function, const T_Continuation& continuation, T_Result* result_out, priorityRating priority )
+	: Job( priority )
+	, m_function( function )
+	, m_continuation( continuation )
+	, m_result()
+	, m_result_out( result_out )
+{
+
+}
+
+
+//-----------------------------------------------------------------------------------------------
+template< typename T_Result, typename T_Function, typename T_Continuation >
+inline void TaskJob< T_Result, T_Function, T_Continuation >::Execute()
+{
+	m_result = m_function();
+	if( m_result_out != nullptr )
+		*m_result_out = m_result;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+template< typename T_Result, typename T_Function, typename T_Continuation >
+inline void TaskJob< T_Result, T_Function, T_Continuation >::FireCallbackEvent()
+{
+	m_continuation( m_result );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+template< typename T_Result >
+template< typename T_Function >
+inline void Task< T_Result >::Start( const T_Function& function, priorityRating priority )
+{
+	JobManager::AddNewJob( new TaskJob< T_Result, T_Function, IgnoreTaskResult >( function, IgnoreTaskResult(), &m_result, priority ), &m_completionCounter );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+template< typename T_Result >
+inline const T_Result& Task< T_Result >::Await()
+{
+	JobManager::WaitFor( &m_completionCounter );
+	return m_result;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+//Fire and forget: nothing waits on the task, and its result is only seen by the continuation.
+template< typename T_Result, typename T_Function, typename T_Continuation >
+inline void StartTask( const T_Function& function, const T_Continuation& continuation, priorityRating priority = AVERAGE_PRIORITY )
+{
+	JobManager::AddNewJob( new TaskJob< T_Result, T_Function, T_Continuation >( function, continuation, nullptr, priority ) );
+}
+
+
+#endif // include_Task
\ No newline at end of file
@@ -1,4 +1,5 @@
 #include "Texture.hpp"
+#include "MappedFile.hpp"
 #include "EngineCommon.hpp"
 #include "OpenGLRenderer.hpp"
 #include "NewMacroDef.hpp"
@@ -20,7 +21,13 @@ Texture::Texture( const std::string& imageFilePath )
 {
 	int numComponents = 0; // Filled in for us to indicate how many color/alpha components the image had (e.g. 3=RGB, 4=RGBA)
 	int numComponentsRequested = 0; // don't care; we support 3 (RGB) or 4 (RGBA)
-	unsigned char* imageData = stbi_load( imageFilePath.c_str(), &m_size.x, &m_size.y, &numComponents, numComponentsRequested );
+	MappedFile imageFile;
+	if( !imageFile.Open( imageFilePath ) || imageFile.GetData() == nullptr )
+		return;
+
+	// decoded straight out of the mapped file, with no buffered read of the compressed bytes
+	unsigned char* imageData = stbi_load_from_memory( imageFile.GetData(), (int) imageFile.GetSize(), &m_size.x, &m_size.y, &numComponents, numComponentsRequested );
+	imageFile.Close();
 	if( imageData == nullptr )
 		return;
 
@@ -0,0 +1,117 @@
+#include "WorkStealingDeque.hpp"
+#include "NewMacroDef.hpp"
+
+
+//-----------------------------------------------------------------------------------------------
+WorkStealingDeque::WorkStealingDeque( LONG initialCapacity )
+	: m_top( 0 )
+	, m_bottom( 0 )
+	, m_jobArray( nullptr )
+{
+	m_jobArray = CreateJobArray( initialCapacity, nullptr );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+WorkStealingDeque::~WorkStealingDeque()
+{
+	JobArray* jobArray = m_jobArray;
+	while( jobArray != nullptr )
+	{
+		JobArray* outgrownArray = jobArray->m_outgrownArray;
+		delete[] jobArray->m_jobs;
+		delete jobArray;
+		jobArray = outgrownArray;
+	}
+
+	m_jobArray = nullptr;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void WorkStealingDeque::Push( Job* job )
+{
+	LONG bottom = m_bottom;
+	LONG top = m_top;
+	JobArray* jobArray = m_jobArray;
+	if( bottom - top >= jobArray->m_capacity - 1 )
+		jobArray = Grow( jobArray, bottom, top );
+
+	jobArray->m_jobs[ bottom & ( jobArray->m_capacity - 1 ) ] = job;
+
+	// the job has to be visible before the new bottom that publishes it
+	_WriteBarrier();
+	m_bottom = bottom + 1;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+Job* WorkStealingDeque::Pop()
+{
+	LONG bottom = m_bottom - 1;
+	JobArray* jobArray = m_jobArray;
+
+	// full fence: the thieves have to see the reserved bottom before the top is read
+	InterlockedExchange( &m_bottom, bottom );
+	LONG top = m_top;
+
+	if( top > bottom )
+	{
+		m_bottom = bottom + 1;
+		return nullptr;
+	}
+
+	Job* job = jobArray->m_jobs[ bottom & ( jobArray->m_capacity - 1 ) ];
+	if( top == bottom )
+	{
+		// last job, race the thieves for it
+		if( InterlockedCompareExchange( &m_top, top + 1, top ) != top )
+			job = nullptr;
+
+		m_bottom = bottom + 1;
+	}
+
+	return job;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+Job* WorkStealingDeque::Steal()
+{
+	LONG top = m_top;
+	MemoryBarrier();
+	LONG bottom = m_bottom;
+	if( top >= bottom )
+		return nullptr;
+
+	JobArray* jobArray = m_jobArray;
+	Job* job = jobArray->m_jobs[ top & ( jobArray->m_capacity - 1 ) ];
+	if( InterlockedCompareExchange( &m_top, top + 1, top ) != top )
+		return nullptr;
+
+	return job;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+WorkStealingDeque::JobArray* WorkStealingDeque::CreateJobArray( LONG capacity, JobArray* outgrownArray )
+{
+	JobArray* jobArray = new JobArray();
+	jobArray->m_capacity = capacity;
+	jobArray->m_outgrownArray = outgrownArray;
+	jobArray->m_jobs = new Job*[ capacity ];
+	return jobArray;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+WorkStealingDeque::JobArray* WorkStealingDeque::Grow( JobArray* jobArray, LONG bottom, LONG top )
+{
+	JobArray* grownArray = CreateJobArray( jobArray->m_capacity * 2, jobArray );
+	for( LONG jobIndex = top; jobIndex < bottom; ++jobIndex )
+		grownArray->m_jobs[ jobIndex & ( grownArray->m_capacity - 1 ) ] = jobArray->m_jobs[ jobIndex & ( jobArray->m_capacity - 1 ) ];
+
+	_WriteBarrier();
+	m_jobArray = grownArray;
+	return grownArray;
+}
\ No newline at end of file
@@ -0,0 +1,51 @@
+#ifndef include_WorkStealingDeque
+#define include_WorkStealingDeque
+#pragma once
+
+//-----------------------------------------------------------------------------------------------
+#include <windows.h>
+
+
+//-----------------------------------------------------------------------------------------------
+class Job;
+
+
+//-----------------------------------------------------------------------------------------------
+const LONG DEFAULT_WORK_STEALING_DEQUE_CAPACITY = 256;
+
+
+//-----------------------------------------------------------------------------------------------
+//Chase-Lev deque. Only the owning worker pushes and pops, at the bottom, so it runs its newest
+//work first while it is still in cache; any other thread may steal the oldest job from the top.
+//The owner only synchronizes with thieves when a single job is left. Arrays outgrown while a
+//thief may still be reading them are kept until the deque is destroyed.
+class WorkStealingDeque
+{
+public:
+	WorkStealingDeque( LONG initialCapacity = DEFAULT_WORK_STEALING_DEQUE_CAPACITY );
+	~WorkStealingDeque();
+	void Push( Job* job );
+	Job* Pop();
+	Job* Steal();
+	bool IsEmpty() const { return m_bottom <= m_top; }
+
+private:
+	struct JobArray
+	{
+		LONG		m_capacity;
+		JobArray*	m_outgrownArray;
+		Job**		m_jobs;
+	};
+
+	WorkStealingDeque( const WorkStealingDeque& );
+	void operator=( const WorkStealingDeque& );
+	JobArray* CreateJobArray( LONG capacity, JobArray* outgrownArray );
+	JobArray* Grow( JobArray* jobArray, LONG bottom, LONG top );
+
+	volatile LONG			m_top;
+	volatile LONG			m_bottom;
+	JobArray* volatile		m_jobArray;
+};
+
+
+#endif // include_WorkStealingDeque
\ No newline at end of file
@@ -1,4 +1,5 @@
 #include "WorkerThread.hpp"
+#include <string.h>
 #include "NewMacroDef.hpp"
 
 
@@ -6,8 +7,14 @@
 WorkerThread::WorkerThread()
 	: m_status( OPEN )
 	, m_jobTypeToHandle( JOB_TYPE_UNDEFINED )
+	, m_localJobs( new WorkStealingDeque() )
+	, m_threadHandle( nullptr )
+	, m_randomSeed( (unsigned int) (size_t) this )
+	, m_schedulerFiber( nullptr )
+	, m_currentJobFiber( nullptr )
 {
-
+	memset( &m_statistics, 0, sizeof( m_statistics ) );
+	memset( &m_statisticsAtReset, 0, sizeof( m_statisticsAtReset ) );
 }
 
 
@@ -15,6 +22,37 @@ WorkerThread::WorkerThread()
 WorkerThread::WorkerThread( jobType jobTypesToHandle )
 	: m_status( OPEN )
 	, m_jobTypeToHandle( jobTypesToHandle )
+	, m_localJobs( nullptr )
+	, m_threadHandle( nullptr )
+	, m_randomSeed( (unsigned int) (size_t) this )
+	, m_schedulerFiber( nullptr )
+	, m_currentJobFiber( nullptr )
+{
+	memset( &m_statistics, 0, sizeof( m_statistics ) );
+	memset( &m_statisticsAtReset, 0, sizeof( m_statisticsAtReset ) );
+
+	if( IsGeneric() )
+		m_localJobs = new WorkStealingDeque();
+}
+
+
+//-----------------------------------------------------------------------------------------------
+WorkerThread::~WorkerThread()
 {
+	delete m_localJobs;
+	m_localJobs = nullptr;
+
+	if( m_threadHandle != nullptr )
+		CloseHandle( m_threadHandle );
+}
 
+
+//-----------------------------------------------------------------------------------------------
+unsigned int WorkerThread::GetNextRandomNumber()
+{
+	// xorshift, only used to spread steal attempts so it never needs to be good
+	m_randomSeed ^= m_randomSeed << 13;
+	m_randomSeed ^= m_randomSeed >> 17;
+	m_randomSeed ^= m_randomSeed << 5;
+	return m_randomSeed;
 }
\ No newline at end of file
@@ -3,7 +3,12 @@
 #pragma once
 
 //-----------------------------------------------------------------------------------------------
+#include <vector>
+#include <windows.h>
 #include "Job.hpp"
+#include "JobFiber.hpp"
+#include "JobStatistics.hpp"
+#include "WorkStealingDeque.hpp"
 
 
 //-----------------------------------------------------------------------------------------------
@@ -16,14 +21,27 @@ enum threadStatus
 
 
 //-----------------------------------------------------------------------------------------------
+//Workers created without a job type run jobs of every type and own a deque other workers can
+//steal from. Workers dedicated to a type only ever take that type's injected jobs.
 class WorkerThread
 {
 public:
 	WorkerThread();
 	WorkerThread( jobType jobTypesToHandle );
-
-	threadStatus	m_status;
-	jobType			m_jobTypeToHandle;
+	~WorkerThread();
+	bool IsGeneric() const { return m_jobTypeToHandle == JOB_TYPE_UNDEFINED; }
+	unsigned int GetNextRandomNumber();
+
+	threadStatus				m_status;
+	jobType						m_jobTypeToHandle;
+	WorkStealingDeque*			m_localJobs;
+	HANDLE						m_threadHandle;
+	unsigned int				m_randomSeed;
+	void*						m_schedulerFiber;
+	JobFiber*					m_currentJobFiber;
+	std::vector< JobFiber* >	m_freeJobFibers;
+	WorkerThreadStatistics		m_statistics;
+	WorkerThreadStatistics		m_statisticsAtReset;
 };
 
 
@@ -1,4 +1,5 @@
 #include "XMLDocument.hpp"
+#include "MappedFile.hpp"
 #include "NewMacroDef.hpp"
 
 
@@ -6,7 +7,12 @@
 XMLDocument::XMLDocument( const std::string xmlFileName )
 	: m_fileName( xmlFileName )
 {
-	pugi::xml_parse_result result = m_document.load_file( xmlFileName.c_str() );
+	MappedFile xmlFile;
+	if( !xmlFile.Open( xmlFileName ) || xmlFile.GetData() == nullptr )
+		return;
+
+	// pugixml copies the view into the buffer it parses in place, so that is the only copy made
+	pugi::xml_parse_result result = m_document.load_buffer( xmlFile.GetData(), xmlFile.GetSize() );
 	if( result.status != pugi::status_ok )
 		return;
 
@@ -1,7 +1,11 @@
 #include "Game.hpp"
 #include "../Engine/Time.hpp"
 #include "../Engine/JobManager.hpp"
+#include "../Engine/AsyncFileIO.hpp"
 #include "../Engine/EventSystem.hpp"
+#include "../Engine/DeferredEventQueue.hpp"
+#include "../Engine/AllocationProfiler.hpp"
+#include "../Engine/LinearArena.hpp"
 #include "../Engine/MemoryManager.hpp"
 #include "../Engine/ProfileSection.hpp"
 #include "../Engine/DeveloperConsole.hpp"
@@ -13,6 +17,7 @@ Game::Game( float gameWidth, float gameHeight )
 	: m_size( gameWidth, gameHeight )
 	, m_world( gameWidth, gameHeight )
 	, m_isPaused( false )
+	, m_isProfileOverlayVisible( false )
 {
 	
 }
@@ -21,6 +26,9 @@ Game::Game( float gameWidth, float gameHeight )
 //-----------------------------------------------------------------------------------------------
 void Game::Initialize()
 {
+	DeferredEventQueue::Startup();
+	JobManager::Startup( 0, SHOULD_RUN_JOBS_ON_FIBERS );
+	AsyncFileIO::Startup();
 	m_world.Initialize();
 	m_camera.m_position = Vector3( 0.f, 0.f, 0.f );
 	m_mouse = Mouse( CURSOR_TEXTURE_FILE_NAME );
@@ -30,7 +38,11 @@ void Game::Initialize()
 //-----------------------------------------------------------------------------------------------
 void Game::Destruct()
 {
+	AsyncFileIO::Shutdown();
+	JobManager::Shutdown();
 	m_world.Destruct();
+	DeferredEventQueue::Shutdown();
+	FrameAllocator::Shutdown();
 }
 
 
@@ -166,6 +178,9 @@ void Game::Update( HWND hWnd )
 	{
 		m_world.Update( deltaSeconds, m_keyboard, m_mouse );
 	}
+
+	JobManager::Update();
+	DeferredEventQueue::DispatchEvents();
 	
 	UpdateFromInput( deltaSeconds, hWnd );
 
@@ -208,6 +223,9 @@ void Game::RenderWorld2D()
 	m_world.RenderObjects2D();
 	//m_mouse.RenderCursor();
 
+	if( m_isProfileOverlayVisible )
+		ProfileSection::RenderProfileInfo( m_size );
+
 	if( g_developerConsole.m_drawConsole )
 		g_developerConsole.Render();
 
@@ -220,4 +238,7 @@ void Game::Render()
 {
 	RenderWorld3D();
 	RenderWorld2D();
+
+	FrameAllocator::SwapFrames();
+	AllocationProfiler::AdvanceFrame();
 }
\ No newline at end of file
@@ -24,6 +24,9 @@
 const float FIELD_OF_VIEW_Y = 45.f;
 const float MOVE_SPEED_POINTS_PER_SECOND = 5.f;
 const float ROTATION_DEGREES_PER_SECOND = 70.f;
+//Off until the WaitFor helping loop also resumes ready fibers and every thread local the jobs
+//touch is safe to read after a fiber moves threads, not just the JobManager's own.
+const bool SHOULD_RUN_JOBS_ON_FIBERS = false;
 const std::string CURSOR_TEXTURE_FILE_NAME = "../Data/Images/Cursor.png";
 
 
@@ -51,6 +54,7 @@ public:
 	Mouse		m_mouse;
 	Keyboard	m_keyboard;
 	bool		m_isPaused;
+	bool		m_isProfileOverlayVisible;
 	Vector2		m_size;
 };
 
@@ -4,10 +4,19 @@
 #include <crtdbg.h>
 #include "Game.hpp"
 #include "../Engine/Time.hpp"
+#include "../Engine/Task.hpp"
 #include "../Engine/Texture.hpp"
+#include "../Engine/BitStream.hpp"
 #include "../Engine/BitmapFont.hpp"
+#include "../Engine/AsyncFileIO.hpp"
+#include "../Engine/ParallelFor.hpp"
+#include "../Engine/HashFunctions.hpp"
+#include "../Engine/AllocationProfiler.hpp"
 #include "../Engine/EngineCommon.hpp"
+#include "../Engine/MemoryManager.hpp"
+#include "../Engine/StringFunctions.hpp"
 #include "../Engine/OpenGLRenderer.hpp"
+#include "../Engine/DeferredEventQueue.hpp"
 #include "../Engine/DeveloperConsole.hpp"
 #include "../Engine/NewMacroDef.hpp"
 #pragma comment( lib, "opengl32" ) // Link in the OpenGL32.lib static library
@@ -206,6 +215,35 @@ bool ConsoleFunctionQuit( const ConsoleCommandArgs& )
 }
 
 
+//-----------------------------------------------------------------------------------------------
+//The server answers a join with a reset, which the main thread handles as usual before this sees it.
+//The awaiter is registered by the console command itself, before the join goes out.
+struct AwaitServerJoinFunction
+{
+	AwaitServerJoinFunction( World::PacketAwaiter* joinReplyAwaiter ) : m_joinReplyAwaiter( joinReplyAwaiter ) {}
+	bool operator()() const
+	{
+		CS6Packet resetPacket;
+		return g_game.m_world.AwaitExpectedPacket( m_joinReplyAwaiter, SECONDS_BEFORE_JOIN_TIMEOUT, resetPacket );
+	}
+
+	World::PacketAwaiter*	m_joinReplyAwaiter;
+};
+
+
+//-----------------------------------------------------------------------------------------------
+struct PrintServerJoinFunction
+{
+	void operator()( const bool& hasJoined ) const
+	{
+		if( hasJoined )
+			g_developerConsole.m_consoleLogLines.push_back( ConsoleLogLine( "Joined the server", Color::White ) );
+		else
+			g_developerConsole.m_consoleLogLines.push_back( ConsoleLogLine( "No reply from the server after " + ConvertNumberToString( SECONDS_BEFORE_JOIN_TIMEOUT ) + " seconds", Color::Red ) );
+	}
+};
+
+
 //-----------------------------------------------------------------------------------------------
 bool ConsoleFunctionChangeIP( const ConsoleCommandArgs& params )
 {
@@ -213,6 +251,7 @@ bool ConsoleFunctionChangeIP( const ConsoleCommandArgs& params )
 		return false;
 
 	g_game.m_world.ChangeIPAddress( params.m_argsList[ 0 ] );
+	StartTask< bool >( AwaitServerJoinFunction( g_game.m_world.ExpectJoinReply() ), PrintServerJoinFunction() );
 	return true;
 }
 
@@ -225,10 +264,434 @@ bool ConsoleFunctionChangePortNumber( const ConsoleCommandArgs& params )
 
 	unsigned short portNumber = (unsigned short) atoi( params.m_argsList[ 0 ].c_str() );
 	g_game.m_world.ChangePortNumber( portNumber );
+	StartTask< bool >( AwaitServerJoinFunction( g_game.m_world.ExpectJoinReply() ), PrintServerJoinFunction() );
+	return true;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+bool ConsoleFunctionBenchmarkBitStream( const ConsoleCommandArgs& params )
+{
+	int numRecords = 100000;
+	if( params.m_argsList.size() > 0 )
+		numRecords = atoi( params.m_argsList[ 0 ].c_str() );
+
+	if( numRecords <= 0 )
+		return false;
+
+	BitStreamBenchmarkResults results = RunBitStreamBenchmark( (unsigned int) numRecords );
+	double nanosecondsPerWrite = ( results.m_secondsWriting * 1000000000.0 ) / results.m_numRecords;
+	double nanosecondsPerRead = ( results.m_secondsReading * 1000000000.0 ) / results.m_numRecords;
+	Color lineColor = results.m_didRoundTripMatch ? Color::White : Color::Red;
+
+	g_developerConsole.m_consoleLogLines.push_back( ConsoleLogLine( "Records: " + ConvertNumberToString( numRecords ) + "  Bits/record: " + ConvertNumberToString( (int) results.m_numBitsPerRecord ) + "  Raw bytes/record: " + ConvertNumberToString( (int) results.m_numRawBytesPerRecord ), lineColor ) );
+	g_developerConsole.m_consoleLogLines.push_back( ConsoleLogLine( "Write ns/record: " + ConvertNumberToString( nanosecondsPerWrite ) + "  Read ns/record: " + ConvertNumberToString( nanosecondsPerRead ), lineColor ) );
+	return results.m_didRoundTripMatch;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+bool ConsoleFunctionBenchmarkParallelFor( const ConsoleCommandArgs& params )
+{
+	int numElements = 1000000;
+	if( params.m_argsList.size() > 0 )
+		numElements = atoi( params.m_argsList[ 0 ].c_str() );
+
+	if( numElements <= 0 )
+		return false;
+
+	unsigned int maxNumParticipants = JobManager::GetNumGenericWorkerThreads() + 1;
+	double singleThreadSeconds = 0.0;
+	for( unsigned int numParticipants = 1; numParticipants <= maxNumParticipants; ++numParticipants )
+	{
+		ParallelForBenchmarkResults results = RunParallelForBenchmark( (unsigned int) numElements, numParticipants );
+		if( numParticipants == 1 )
+			singleThreadSeconds = results.m_secondsElapsed;
+
+		double speedup = ( results.m_secondsElapsed > 0.0 ) ? singleThreadSeconds / results.m_secondsElapsed : 0.0;
+		g_developerConsole.m_consoleLogLines.push_back( ConsoleLogLine( "Threads: " + ConvertNumberToString( (int) results.m_numParticipants ) + "  ms: " + ConvertNumberToString( results.m_secondsElapsed * 1000.0 ) + "  Speedup: " + ConvertNumberToString( speedup ) + "  Checksum: " + ConvertNumberToString( results.m_checksum ), Color::White ) );
+	}
+
+	return true;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+//Reads the whole file as chunks that are all in flight at once, then waits for the lot.
+bool ConsoleFunctionBenchmarkFileIO( const ConsoleCommandArgs& params )
+{
+	const DWORD BENCHMARK_CHUNK_SIZE_IN_BYTES = 64 * 1024;
+
+	if( params.m_argsList.size() < 1 )
+		return false;
+
+	const std::string& filePath = params.m_argsList[ 0 ];
+	HANDLE fileHandle = AsyncFileIO::OpenFileForReading( filePath );
+	LARGE_INTEGER fileSize;
+	if( fileHandle == INVALID_HANDLE_VALUE || !GetFileSizeEx( fileHandle, &fileSize ) || fileSize.QuadPart == 0 )
+	{
+		AsyncFileIO::CloseFile( fileHandle );
+		g_developerConsole.m_consoleLogLines.push_back( ConsoleLogLine( "Could not read " + filePath, Color::Red ) );
+		return false;
+	}
+
+	size_t numChunks = (size_t) ( ( fileSize.QuadPart + BENCHMARK_CHUNK_SIZE_IN_BYTES - 1 ) / BENCHMARK_CHUNK_SIZE_IN_BYTES );
+	std::vector< AsyncFileRequest > requests( numChunks );
+	std::vector< byte_t > fileBytes( numChunks * BENCHMARK_CHUNK_SIZE_IN_BYTES );
+	JobCounter chunksRead;
+
+	double secondsAtStart = GetCurrentTimeSeconds();
+	for( size_t chunkIndex = 0; chunkIndex < numChunks; ++chunkIndex )
+		AsyncFileIO::SubmitRead( &requests[ chunkIndex ], fileHandle, &fileBytes[ chunkIndex * BENCHMARK_CHUNK_SIZE_IN_BYTES ], BENCHMARK_CHUNK_SIZE_IN_BYTES, (unsigned long long) chunkIndex * BENCHMARK_CHUNK_SIZE_IN_BYTES, &chunksRead );
+
+	JobManager::WaitFor( &chunksRead );
+	double secondsElapsed = GetCurrentTimeSeconds() - secondsAtStart;
+	AsyncFileIO::CloseFile( fileHandle );
+
+	size_t numBytesRead = 0;
+	for( size_t chunkIndex = 0; chunkIndex < numChunks; ++chunkIndex )
+		numBytesRead += requests[ chunkIndex ].m_numBytesTransferred;
+
+	double megabytesPerSecond = ( secondsElapsed > 0.0 ) ? ( numBytesRead / ( 1024.0 * 1024.0 ) ) / secondsElapsed : 0.0;
+	std::string modeText = AsyncFileIO::IsUsingCompletionPort() ? "completion port" : "file io jobs";
+	g_developerConsole.m_consoleLogLines.push_back( ConsoleLogLine( "Read " + ConvertNumberToString( numBytesRead ) + " bytes in " + ConvertNumberToString( (int) numChunks ) + " requests (" + modeText + ")  ms: " + ConvertNumberToString( secondsElapsed * 1000.0 ) + "  MB/s: " + ConvertNumberToString( megabytesPerSecond ), Color::White ) );
+	return true;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+bool ConsoleFunctionIOStats( const ConsoleCommandArgs& params )
+{
+	std::string subCommand = ( params.m_argsList.size() > 0 ) ? params.m_argsList[ 0 ] : "";
+	if( subCommand == "reset" )
+	{
+		AsyncFileIO::ResetStatistics();
+		return true;
+	}
+
+	const AsyncFileIOStatistics& statistics = AsyncFileIO::GetStatistics();
+	g_developerConsole.m_consoleLogLines.push_back( ConsoleLogLine( "In flight: " + ConvertNumberToString( (int) statistics.m_numRequestsInFlight ) + "  Failed: " + ConvertNumberToString( (int) statistics.m_numRequestsFailed ), Color::White ) );
+	g_developerConsole.m_consoleLogLines.push_back( ConsoleLogLine( "Reads: " + ConvertNumberToString( (int) statistics.m_numReadsCompleted ) + "  MB read: " + ConvertNumberToString( statistics.m_numBytesRead / ( 1024.0 * 1024.0 ) ), Color::White ) );
+	g_developerConsole.m_consoleLogLines.push_back( ConsoleLogLine( "Writes: " + ConvertNumberToString( (int) statistics.m_numWritesCompleted ) + "  MB written: " + ConvertNumberToString( statistics.m_numBytesWritten / ( 1024.0 * 1024.0 ) ), Color::White ) );
+	return true;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+struct FileHashResult
+{
+	bool				m_wasLoaded;
+	bool				m_isTreeHash;
+	unsigned long long	m_fileSizeInBytes;
+	unsigned long long	m_hashValue;
+};
+
+
+//-----------------------------------------------------------------------------------------------
+//Feeds a file too big to map in one view to a tree hash, a chunk at a time.
+struct AddChunkToTreeHash
+{
+	AddChunkToTreeHash( TreeHashBuilder* treeHashBuilder ) : m_treeHashBuilder( treeHashBuilder ) {}
+	void operator()( const byte_t* chunk, size_t numBytes, unsigned long long ) const
+	{
+		m_treeHashBuilder->AddData( chunk, numBytes );
+	}
+
+	TreeHashBuilder*	m_treeHashBuilder;
+};
+
+
+//-----------------------------------------------------------------------------------------------
+//Maps the file and then hashes the mapped view, one awaited job after the other. Files too big to
+//map in one view are tree hashed a chunk at a time instead, since a flat hash needs all of it.
+struct LoadAndHashFileFunction
+{
+	LoadAndHashFileFunction( const std::string& filePath, hashAlgorithm algorithm, bool shouldUseTreeHash ) : m_filePath( filePath ), m_algorithm( algorithm ), m_shouldUseTreeHash( shouldUseTreeHash ) {}
+	FileHashResult operator()() const
+	{
+		FileHashResult result;
+		MapFileJob* mapFileJob = new MapFileJob( nullptr, m_filePath, true );
+		JobManager::AwaitJob( mapFileJob );
+		MappedFile* mappedFile = mapFileJob->TakeMappedFile();
+		delete mapFileJob;
+
+		result.m_wasLoaded = ( mappedFile != nullptr );
+		result.m_isTreeHash = m_shouldUseTreeHash;
+		result.m_fileSizeInBytes = result.m_wasLoaded ? mappedFile->GetFileSize() : 0;
+		result.m_hashValue = 0;
+		if( result.m_wasLoaded && mappedFile->GetData() == nullptr && result.m_fileSizeInBytes > 0 )
+		{
+			// whole leaves per chunk, so the chunks hash the same as the file would in one piece
+			TreeHashBuilder treeHashBuilder( m_algorithm );
+			AddChunkToTreeHash addChunkToTreeHash( &treeHashBuilder );
+			result.m_isTreeHash = true;
+			result.m_wasLoaded = mappedFile->ForEachChunk( addChunkToTreeHash, 16 * HASH_TREE_LEAF_SIZE_IN_BYTES );
+			result.m_hashValue = result.m_wasLoaded ? treeHashBuilder.Finish() : 0;
+		}
+		else if( result.m_wasLoaded )
+		{
+			// the hash job only reads the buffer it is given, and a mapped view is never over MAX_MAPPED_FILE_VIEW_SIZE_IN_BYTES
+			HashBufferJob* hashBufferJob = new HashBufferJob( nullptr, (char*) mappedFile->GetData(), (long) mappedFile->GetSize(), m_algorithm, m_shouldUseTreeHash, AVERAGE_PRIORITY );
+			JobManager::AwaitJob( hashBufferJob );
+			result.m_hashValue = hashBufferJob->GetHashValue();
+			delete hashBufferJob;
+		}
+
+		delete mappedFile;
+		return result;
+	}
+
+	std::string		m_filePath;
+	hashAlgorithm	m_algorithm;
+	bool			m_shouldUseTreeHash;
+};
+
+
+//-----------------------------------------------------------------------------------------------
+struct PrintFileHashFunction
+{
+	PrintFileHashFunction( const std::string& filePath ) : m_filePath( filePath ) {}
+	void operator()( const FileHashResult& result ) const
+	{
+		if( !result.m_wasLoaded )
+		{
+			g_developerConsole.m_consoleLogLines.push_back( ConsoleLogLine( "Could not load " + m_filePath, Color::Red ) );
+			return;
+		}
+
+		g_developerConsole.m_consoleLogLines.push_back( ConsoleLogLine( m_filePath + "  size: " + ConvertNumberToString( result.m_fileSizeInBytes / ( 1024.0 * 1024.0 ) ) + " MB  hash: " + ConvertNumberToHexString( result.m_hashValue ) + ( result.m_isTreeHash ? " (tree)" : "" ), Color::White ) );
+	}
+
+	std::string		m_filePath;
+};
+
+
+//-----------------------------------------------------------------------------------------------
+bool ConsoleFunctionHashFile( const ConsoleCommandArgs& params )
+{
+	if( params.m_argsList.size() < 1 )
+		return false;
+
+	hashAlgorithm algorithm = HASH_ALGORITHM_LEGACY;
+	if( params.m_argsList.size() > 1 && !GetHashAlgorithmFromName( params.m_argsList[ 1 ], algorithm ) )
+		return false;
+
+	bool shouldUseTreeHash = ( params.m_argsList.size() > 2 && params.m_argsList[ 2 ] == "tree" );
+	const std::string& filePath = params.m_argsList[ 0 ];
+	StartTask< FileHashResult >( LoadAndHashFileFunction( filePath, algorithm, shouldUseTreeHash ), PrintFileHashFunction( filePath ) );
 	return true;
 }
 
 
+//-----------------------------------------------------------------------------------------------
+//Hashes the same pseudo random buffer with every algorithm, flat and as a tree, against the
+//legacy hash HashBufferJob always used.
+bool ConsoleFunctionBenchmarkHash( const ConsoleCommandArgs& params )
+{
+	int numMegabytes = 64;
+	if( params.m_argsList.size() > 0 )
+		numMegabytes = atoi( params.m_argsList[ 0 ].c_str() );
+
+	if( numMegabytes <= 0 )
+		return false;
+
+	size_t numBytes = (size_t) numMegabytes * 1024 * 1024;
+	std::vector< byte_t > buffer( numBytes );
+	unsigned int randomState = 12345;
+	for( size_t byteIndex = 0; byteIndex < numBytes; ++byteIndex )
+	{
+		randomState = randomState * 1664525 + 1013904223;
+		buffer[ byteIndex ] = (byte_t) ( randomState >> 24 );
+	}
+
+	double legacySeconds = 0.0;
+	for( int algorithmIndex = 0; algorithmIndex < NUMBER_OF_HASH_ALGORITHMS * 2; ++algorithmIndex )
+	{
+		hashAlgorithm algorithm = static_cast< hashAlgorithm >( algorithmIndex % NUMBER_OF_HASH_ALGORITHMS );
+		bool isTreeHash = ( algorithmIndex >= NUMBER_OF_HASH_ALGORITHMS );
+		HashBenchmarkResults results = RunHashBenchmark( algorithm, isTreeHash, &buffer[ 0 ], numBytes );
+		if( algorithmIndex == 0 )
+			legacySeconds = results.m_secondsElapsed;
+
+		double megabytesPerSecond = ( results.m_secondsElapsed > 0.0 ) ? numMegabytes / results.m_secondsElapsed : 0.0;
+		double speedup = ( results.m_secondsElapsed > 0.0 ) ? legacySeconds / results.m_secondsElapsed : 0.0;
+		std::string name = std::string( GetHashAlgorithmName( algorithm ) ) + ( isTreeHash ? " tree" : "" );
+		g_developerConsole.m_consoleLogLines.push_back( ConsoleLogLine( name + "  MB/s: " + ConvertNumberToString( megabytesPerSecond ) + "  Speedup: " + ConvertNumberToString( speedup ) + "  Hash: " + ConvertNumberToHexString( results.m_hashValue ), Color::White ) );
+	}
+
+	g_developerConsole.m_consoleLogLines.push_back( ConsoleLogLine( std::string( "crc32c uses " ) + ( IsSSE42Supported() ? "SSE4.2" : "the lookup table" ), Color::White ) );
+	return true;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+bool ConsoleFunctionEventStats( const ConsoleCommandArgs& )
+{
+	const DeferredEventFrameStatistics& frameStatistics = DeferredEventQueue::GetLastFrameStatistics();
+	g_developerConsole.m_consoleLogLines.push_back( ConsoleLogLine( "Last frame  dispatched: " + ConvertNumberToString( (int) frameStatistics.m_numDispatched ) + "  dropped: " + ConvertNumberToString( (int) frameStatistics.m_numDropped ) + "  ms: " + ConvertNumberToString( frameStatistics.m_secondsDispatching * 1000.0 ) + "  Posting threads: " + ConvertNumberToString( (int) frameStatistics.m_numProducerThreads ), Color::White ) );
+
+	for( unsigned int typeIndex = 0; typeIndex < DeferredEventQueue::GetNumEventTypes(); ++typeIndex )
+	{
+		const DeferredEventTypeStatistics& typeStatistics = DeferredEventQueue::GetEventTypeStatistics( typeIndex );
+		if( typeStatistics.m_name == nullptr )
+			continue;
+
+		g_developerConsole.m_consoleLogLines.push_back( ConsoleLogLine( std::string( typeStatistics.m_name ) + "  posted: " + ConvertNumberToString( (int) typeStatistics.m_numPosted ) + "  dispatched: " + ConvertNumberToString( (int) typeStatistics.m_numDispatched ) + "  last frame: " + ConvertNumberToString( (int) typeStatistics.m_numDispatchedLastFrame ) + "  dropped: " + ConvertNumberToString( (int) typeStatistics.m_numDropped ), Color::White ) );
+	}
+
+	return true;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+bool ConsoleFunctionJobStats( const ConsoleCommandArgs& params )
+{
+	std::string subCommand = ( params.m_argsList.size() > 0 ) ? params.m_argsList[ 0 ] : "";
+	if( subCommand == "reset" )
+	{
+		JobManager::ResetStatistics();
+		return true;
+	}
+
+	if( subCommand == "dump" )
+	{
+		std::string filePath = ( params.m_argsList.size() > 1 ) ? params.m_argsList[ 1 ] : DEFAULT_JOB_STATISTICS_FILE_PATH;
+		bool didDump = JobManager::DumpStatisticsToFile( filePath.c_str() );
+		g_developerConsole.m_consoleLogLines.push_back( ConsoleLogLine( didDump ? "Job statistics written to " + filePath : "Could not write " + filePath, didDump ? Color::White : Color::Red ) );
+		return didDump;
+	}
+
+	if( subCommand == "overlay" )
+	{
+		g_game.m_isProfileOverlayVisible = !g_game.m_isProfileOverlayVisible;
+		return true;
+	}
+
+	if( subCommand == "budget" )
+	{
+		if( params.m_argsList.size() < 2 )
+			return false;
+
+		double budgetMilliseconds = atof( params.m_argsList[ 1 ].c_str() );
+		if( budgetMilliseconds < 0.0 )
+			return false;
+
+		JobManager::SetCallbackBudgetSecondsPerFrame( budgetMilliseconds / 1000.0 );
+		g_developerConsole.m_consoleLogLines.push_back( ConsoleLogLine( "Job callback budget: " + ConvertNumberToString( budgetMilliseconds ) + " ms per frame", Color::White ) );
+		return true;
+	}
+
+	const JobLatencyStatistics& statistics = JobManager::GetLatencyStatistics();
+	double numJobsFinished = ( statistics.m_numJobsFinished == 0 ) ? 1.0 : (double) statistics.m_numJobsFinished;
+	g_developerConsole.m_consoleLogLines.push_back( ConsoleLogLine( "Jobs finished: " + ConvertNumberToString( (int) statistics.m_numJobsFinished ) + "  Frames over callback budget: " + ConvertNumberToString( (int) statistics.m_numFramesOverBudget ), Color::White ) );
+	g_developerConsole.m_consoleLogLines.push_back( ConsoleLogLine( "Added to callback ms  avg: " + ConvertNumberToString( statistics.m_totalSecondsAddedToCallback * 1000.0 / numJobsFinished ) + "  max: " + ConvertNumberToString( statistics.m_maxSecondsAddedToCallback * 1000.0 ), Color::White ) );
+	g_developerConsole.m_consoleLogLines.push_back( ConsoleLogLine( "Completed to callback ms  avg: " + ConvertNumberToString( statistics.m_totalSecondsCompletedToCallback * 1000.0 / numJobsFinished ) + "  max: " + ConvertNumberToString( statistics.m_maxSecondsCompletedToCallback * 1000.0 ), Color::White ) );
+
+	std::vector< std::string > reportLines;
+	JobManager::GetStatisticsReport( reportLines );
+	for( unsigned int lineIndex = 0; lineIndex < reportLines.size(); ++lineIndex )
+		g_developerConsole.m_consoleLogLines.push_back( ConsoleLogLine( reportLines[ lineIndex ], Color::White ) );
+
+	return true;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+bool ConsoleFunctionPoolStats( const ConsoleCommandArgs& )
+{
+	std::string pooledBytesText = "Pooled bytes in use: " + ConvertNumberToString( MemoryManager::GetNumPooledBytesInUse() ) + " of " + ConvertNumberToString( MemoryManager::GetNumPooledBytesReserved() ) + " (per pool occupancy in debug output)";
+	g_developerConsole.m_consoleLogLines.push_back( ConsoleLogLine( pooledBytesText, Color::White ) );
+	MemoryManager::ReportObjectPoolOccupancy();
+	return true;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+bool ConsoleFunctionMemoryProfile( const ConsoleCommandArgs& params )
+{
+	const unsigned int MAX_MEMORY_PROFILE_LINES = 32;
+
+	std::string subCommand = ( params.m_argsList.size() > 0 ) ? params.m_argsList[ 0 ] : "live";
+	if( subCommand == "start" )
+	{
+		int sampleRate = 1;
+		if( params.m_argsList.size() > 1 )
+			sampleRate = atoi( params.m_argsList[ 1 ].c_str() );
+
+		if( sampleRate <= 0 )
+			return false;
+
+		AllocationProfiler::Start( (unsigned int) sampleRate );
+		g_developerConsole.m_consoleLogLines.push_back( ConsoleLogLine( "Allocation profiling started, sampling 1 in " + ConvertNumberToString( sampleRate ), Color::White ) );
+		return true;
+	}
+
+	if( subCommand == "stop" )
+	{
+		AllocationProfiler::Stop();
+		g_developerConsole.m_consoleLogLines.push_back( ConsoleLogLine( "Allocation profiling stopped", Color::White ) );
+		return true;
+	}
+
+	if( subCommand == "dump" )
+	{
+		std::string filePath = ( params.m_argsList.size() > 1 ) ? params.m_argsList[ 1 ] : DEFAULT_ALLOCATION_PROFILE_FILE_PATH;
+		bool wasDumped = AllocationProfiler::DumpToFile( filePath.c_str() );
+		if( wasDumped )
+			g_developerConsole.m_consoleLogLines.push_back( ConsoleLogLine( "Allocation profile written to " + filePath, Color::White ) );
+		else
+			g_developerConsole.m_consoleLogLines.push_back( ConsoleLogLine( "Could not write allocation profile to " + filePath, Color::Red ) );
+
+		return wasDumped;
+	}
+
+	AllocationSiteSortKey sortKey = SORT_BY_LIVE_BYTES;
+	if( subCommand == "churn" )
+		sortKey = SORT_BY_TOTAL_ALLOCATIONS;
+	else if( subCommand == "bytes" )
+		sortKey = SORT_BY_TOTAL_BYTES;
+	else if( subCommand != "live" )
+		return false;
+
+	int numSitesToShow = 10;
+	if( params.m_argsList.size() > 1 )
+		numSitesToShow = atoi( params.m_argsList[ 1 ].c_str() );
+
+	if( numSitesToShow <= 0 || numSitesToShow > (int) MAX_MEMORY_PROFILE_LINES )
+		numSitesToShow = MAX_MEMORY_PROFILE_LINES;
+
+	AllocationSiteStatistics sites[ MAX_MEMORY_PROFILE_LINES ];
+	unsigned int numSites = AllocationProfiler::GetSortedSites( sites, (unsigned int) numSitesToShow, sortKey );
+	float numFramesProfiled = (float) ( AllocationProfiler::GetNumFramesProfiled() > 0 ? AllocationProfiler::GetNumFramesProfiled() : 1 );
+
+	g_developerConsole.m_consoleLogLines.push_back( ConsoleLogLine( "Allocs/frame | Live bytes | Live allocs | Total bytes | Site  (sampling 1 in " + ConvertNumberToString( (int) AllocationProfiler::GetSampleRate() ) + ")", Color::White ) );
+	for( unsigned int siteIndex = 0; siteIndex < numSites; ++siteIndex )
+	{
+		const AllocationSiteStatistics& site = sites[ siteIndex ];
+		std::string siteName = ( site.m_fileName != nullptr ) ? std::string( site.m_fileName ) + "(" + ConvertNumberToString( (int) site.m_lineNumber ) + ")" : "<file not given>";
+		std::string siteText = ConvertNumberToString( (float) site.m_numTotalAllocations / numFramesProfiled ) + " | " + ConvertNumberToString( site.m_numLiveBytes ) + " | " + ConvertNumberToString( site.m_numLiveAllocations ) + " | " + ConvertNumberToString( site.m_numTotalBytes ) + " | " + siteName;
+		g_developerConsole.m_consoleLogLines.push_back( ConsoleLogLine( siteText, Color::White ) );
+	}
+
+	return true;
+}
+
+
+#ifdef _DEBUG
+//-----------------------------------------------------------------------------------------------
+bool ConsoleFunctionValidateHeap( const ConsoleCommandArgs& )
+{
+	bool isHeapValid = MemoryManager::ValidateHeap();
+	if( isHeapValid )
+		g_developerConsole.m_consoleLogLines.push_back( ConsoleLogLine( "Heap is consistent", Color::White ) );
+	else
+		g_developerConsole.m_consoleLogLines.push_back( ConsoleLogLine( "Heap is corrupt, see debug output", Color::Red ) );
+
+	return isHeapValid;
+}
+#endif
+
+
 //-----------------------------------------------------------------------------------------------
 void Update()
 {
@@ -289,6 +752,19 @@ void LoadDeveloperConsole()
 	g_developerConsole.AddCommandFuncPtr( "quit", ConsoleFunctionQuit );
 	g_developerConsole.AddCommandFuncPtr( "changeIP", ConsoleFunctionChangeIP );
 	g_developerConsole.AddCommandFuncPtr( "changePort", ConsoleFunctionChangePortNumber );
+	g_developerConsole.AddCommandFuncPtr( "benchBitStream", ConsoleFunctionBenchmarkBitStream );
+	g_developerConsole.AddCommandFuncPtr( "benchParallelFor", ConsoleFunctionBenchmarkParallelFor );
+	g_developerConsole.AddCommandFuncPtr( "benchFileIO", ConsoleFunctionBenchmarkFileIO );
+	g_developerConsole.AddCommandFuncPtr( "ioStats", ConsoleFunctionIOStats );
+	g_developerConsole.AddCommandFuncPtr( "hashFile", ConsoleFunctionHashFile );
+	g_developerConsole.AddCommandFuncPtr( "benchHash", ConsoleFunctionBenchmarkHash );
+	g_developerConsole.AddCommandFuncPtr( "jobStats", ConsoleFunctionJobStats );
+	g_developerConsole.AddCommandFuncPtr( "eventStats", ConsoleFunctionEventStats );
+	g_developerConsole.AddCommandFuncPtr( "poolStats", ConsoleFunctionPoolStats );
+	g_developerConsole.AddCommandFuncPtr( "memProfile", ConsoleFunctionMemoryProfile );
+#ifdef _DEBUG
+	g_developerConsole.AddCommandFuncPtr( "validateHeap", ConsoleFunctionValidateHeap );
+#endif
 }
 
 
@@ -418,9 +894,14 @@ int WINAPI WinMain( HINSTANCE applicationInstanceHandle, HINSTANCE, LPSTR comman
 
 	UnloadTextures();
 	g_game.Destruct();
+	MemoryManager::DestroySharedObjectPools();
+
+	// hand this thread's cached blocks back so the heap checks below see the real state of the heap
+	MemoryManager::FlushThreadCache();
 
 #if defined( _WIN32 ) && defined( _DEBUG )
 	assert( _CrtCheckMemory() );
+	assert( MemoryManager::ValidateHeap() );
 	_CrtDumpMemoryLeaks();
 #endif
 
@@ -0,0 +1,142 @@
+#ifndef include_PacketBatch
+#define include_PacketBatch
+#pragma once
+
+//-----------------------------------------------------------------------------------------------
+#include "CS6Packet.hpp"
+#include "CS6PacketSchema.hpp"
+
+//Datagram Layout:
+//   [1 byte]  number of messages in the datagram
+//   ------Per Message------
+//		[2 bytes] message size in bytes (little endian)
+//		[N bytes] message, encoded by CS6PacketSchema
+//   ----End Per Message----
+
+
+//-----------------------------------------------------------------------------------------------
+const unsigned short DATAGRAM_MTU_IN_BYTES = 1200;
+const unsigned short DATAGRAM_HEADER_SIZE_IN_BYTES = 1;
+const unsigned short DATAGRAM_MESSAGE_HEADER_SIZE_IN_BYTES = 2;
+const unsigned char DATAGRAM_MAX_MESSAGES = 255;
+
+static_assert( DATAGRAM_HEADER_SIZE_IN_BYTES + DATAGRAM_MESSAGE_HEADER_SIZE_IN_BYTES + MAX_CS6_PACKET_WIRE_SIZE <= DATAGRAM_MTU_IN_BYTES, "The largest packet must fit in a single datagram" );
+
+
+//-----------------------------------------------------------------------------------------------
+struct PacketBatch
+{
+	PacketBatch() { Clear(); }
+	void Clear();
+	bool IsEmpty() const;
+	bool CanFitMessage( unsigned short messageSizeInBytes ) const;
+	bool AddMessage( const CS6Packet& pkt );
+
+	unsigned char	m_numMessages;
+	unsigned short	m_numBytesUsed;
+	char			m_buffer[ DATAGRAM_MTU_IN_BYTES ];
+};
+
+
+//-----------------------------------------------------------------------------------------------
+inline void PacketBatch::Clear()
+{
+	m_numMessages = 0;
+	m_numBytesUsed = DATAGRAM_HEADER_SIZE_IN_BYTES;
+	m_buffer[ 0 ] = 0;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+inline bool PacketBatch::IsEmpty() const
+{
+	return ( m_numMessages == 0 );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+inline bool PacketBatch::CanFitMessage( unsigned short messageSizeInBytes ) const
+{
+	if( m_numMessages == DATAGRAM_MAX_MESSAGES )
+		return false;
+
+	return ( m_numBytesUsed + DATAGRAM_MESSAGE_HEADER_SIZE_IN_BYTES + messageSizeInBytes ) <= DATAGRAM_MTU_IN_BYTES;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+inline bool PacketBatch::AddMessage( const CS6Packet& pkt )
+{
+	unsigned short messageSizeInBytes = (unsigned short) GetCS6PacketWireSize( pkt.packetType );
+	if( messageSizeInBytes == 0 || !CanFitMessage( messageSizeInBytes ) )
+		return false;
+
+	unsigned int messagePosition = m_numBytesUsed + DATAGRAM_MESSAGE_HEADER_SIZE_IN_BYTES;
+	if( WriteCS6Packet( pkt, &m_buffer[ messagePosition ], DATAGRAM_MTU_IN_BYTES - messagePosition ) != messageSizeInBytes )
+		return false;
+
+	m_buffer[ m_numBytesUsed ] = (char) ( messageSizeInBytes & 0xff );
+	m_buffer[ m_numBytesUsed + 1 ] = (char) ( messageSizeInBytes >> 8 );
+
+	m_numBytesUsed += DATAGRAM_MESSAGE_HEADER_SIZE_IN_BYTES + messageSizeInBytes;
+	++m_numMessages;
+	m_buffer[ 0 ] = (char) m_numMessages;
+	return true;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+class PacketBatchReader
+{
+public:
+	PacketBatchReader( const char* datagram, int datagramSizeInBytes );
+	bool GetNextMessage( CS6Packet& pkt_out );
+
+private:
+	const char*		m_datagram;
+	int				m_datagramSizeInBytes;
+	int				m_readPosition;
+	unsigned char	m_numMessagesRemaining;
+};
+
+
+//-----------------------------------------------------------------------------------------------
+inline PacketBatchReader::PacketBatchReader( const char* datagram, int datagramSizeInBytes )
+	: m_datagram( datagram )
+	, m_datagramSizeInBytes( datagramSizeInBytes )
+	, m_readPosition( DATAGRAM_HEADER_SIZE_IN_BYTES )
+	, m_numMessagesRemaining( 0 )
+{
+	if( datagramSizeInBytes >= DATAGRAM_HEADER_SIZE_IN_BYTES )
+		m_numMessagesRemaining = (unsigned char) datagram[ 0 ];
+}
+
+
+//-----------------------------------------------------------------------------------------------
+inline bool PacketBatchReader::GetNextMessage( CS6Packet& pkt_out )
+{
+	while( m_numMessagesRemaining > 0 )
+	{
+		--m_numMessagesRemaining;
+		if( m_readPosition + DATAGRAM_MESSAGE_HEADER_SIZE_IN_BYTES > m_datagramSizeInBytes )
+			break;
+
+		unsigned short messageSizeInBytes = (unsigned char) m_datagram[ m_readPosition ];
+		messageSizeInBytes |= ( (unsigned char) m_datagram[ m_readPosition + 1 ] ) << 8;
+		m_readPosition += DATAGRAM_MESSAGE_HEADER_SIZE_IN_BYTES;
+		if( m_readPosition + messageSizeInBytes > m_datagramSizeInBytes )
+			break;
+
+		const char* message = &m_datagram[ m_readPosition ];
+		m_readPosition += messageSizeInBytes;
+		// messages we don't understand are skipped instead of dropping the whole datagram
+		if( ReadCS6Packet( message, messageSizeInBytes, pkt_out ) )
+			return true;
+	}
+
+	m_numMessagesRemaining = 0;
+	return false;
+}
+
+
+#endif // include_PacketBatch
\ No newline at end of file
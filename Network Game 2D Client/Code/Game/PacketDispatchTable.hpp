@@ -0,0 +1,52 @@
+#ifndef include_PacketDispatchTable
+#define include_PacketDispatchTable
+#pragma once
+
+//-----------------------------------------------------------------------------------------------
+#include "CS6Packet.hpp"
+
+
+//-----------------------------------------------------------------------------------------------
+const unsigned int NUMBER_OF_PACKET_TYPES = 256;
+
+
+//-----------------------------------------------------------------------------------------------
+template< typename T_HandlerType >
+class PacketDispatchTable
+{
+public:
+	PacketDispatchTable();
+	void RegisterHandler( PacketType packetType, T_HandlerType handler );
+	T_HandlerType GetHandler( PacketType packetType ) const;
+
+private:
+	T_HandlerType	m_handlers[ NUMBER_OF_PACKET_TYPES ];
+};
+
+
+//-----------------------------------------------------------------------------------------------
+template< typename T_HandlerType >
+inline PacketDispatchTable< T_HandlerType >::PacketDispatchTable()
+{
+	for( unsigned int typeIndex = 0; typeIndex < NUMBER_OF_PACKET_TYPES; ++typeIndex )
+		m_handlers[ typeIndex ] = T_HandlerType();
+}
+
+
+//-----------------------------------------------------------------------------------------------
+template< typename T_HandlerType >
+inline void PacketDispatchTable< T_HandlerType >::RegisterHandler( PacketType packetType, T_HandlerType handler )
+{
+	m_handlers[ packetType ] = handler;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+template< typename T_HandlerType >
+inline T_HandlerType PacketDispatchTable< T_HandlerType >::GetHandler( PacketType packetType ) const
+{
+	return m_handlers[ packetType ];
+}
+
+
+#endif // include_PacketDispatchTable
\ No newline at end of file
@@ -0,0 +1,297 @@
+#ifndef include_PacketSerialization
+#define include_PacketSerialization
+#pragma once
+
+//-----------------------------------------------------------------------------------------------
+#include <string.h>
+
+//Every value is written little endian, one byte at a time, so the wire format does not depend
+//on the compiler's struct padding or on the host's byte order.
+
+
+//-----------------------------------------------------------------------------------------------
+class PacketWriteStream
+{
+public:
+	PacketWriteStream( char* buffer, unsigned int bufferSizeInBytes ) : m_buffer( buffer ), m_bufferSizeInBytes( bufferSizeInBytes ), m_numBytesUsed( 0 ), m_hasOverflowed( false ) {}
+	bool SerializeUInt8( unsigned char& value );
+	bool SerializeUInt32( unsigned int& value );
+	bool SerializeUInt64( unsigned long long& value );
+	unsigned int GetNumBytesUsed() const { return m_numBytesUsed; }
+	bool HasOverflowed() const { return m_hasOverflowed; }
+
+private:
+	bool ReserveBytes( unsigned int numBytes );
+
+	char*			m_buffer;
+	unsigned int	m_bufferSizeInBytes;
+	unsigned int	m_numBytesUsed;
+	bool			m_hasOverflowed;
+};
+
+
+//-----------------------------------------------------------------------------------------------
+inline bool PacketWriteStream::ReserveBytes( unsigned int numBytes )
+{
+	if( m_hasOverflowed || ( m_bufferSizeInBytes - m_numBytesUsed ) < numBytes )
+	{
+		m_hasOverflowed = true;
+		return false;
+	}
+
+	return true;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+inline bool PacketWriteStream::SerializeUInt8( unsigned char& value )
+{
+	if( !ReserveBytes( 1 ) )
+		return false;
+
+	m_buffer[ m_numBytesUsed++ ] = (char) value;
+	return true;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+inline bool PacketWriteStream::SerializeUInt32( unsigned int& value )
+{
+	if( !ReserveBytes( 4 ) )
+		return false;
+
+	for( unsigned int byteIndex = 0; byteIndex < 4; ++byteIndex )
+		m_buffer[ m_numBytesUsed++ ] = (char) ( ( value >> ( byteIndex * 8 ) ) & 0xff );
+
+	return true;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+inline bool PacketWriteStream::SerializeUInt64( unsigned long long& value )
+{
+	if( !ReserveBytes( 8 ) )
+		return false;
+
+	for( unsigned int byteIndex = 0; byteIndex < 8; ++byteIndex )
+		m_buffer[ m_numBytesUsed++ ] = (char) ( ( value >> ( byteIndex * 8 ) ) & 0xff );
+
+	return true;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+class PacketReadStream
+{
+public:
+	PacketReadStream( const char* buffer, unsigned int bufferSizeInBytes ) : m_buffer( buffer ), m_bufferSizeInBytes( bufferSizeInBytes ), m_numBytesUsed( 0 ), m_hasOverflowed( false ) {}
+	bool SerializeUInt8( unsigned char& value );
+	bool SerializeUInt32( unsigned int& value );
+	bool SerializeUInt64( unsigned long long& value );
+	unsigned int GetNumBytesUsed() const { return m_numBytesUsed; }
+	bool HasOverflowed() const { return m_hasOverflowed; }
+
+private:
+	bool ReserveBytes( unsigned int numBytes );
+
+	const char*		m_buffer;
+	unsigned int	m_bufferSizeInBytes;
+	unsigned int	m_numBytesUsed;
+	bool			m_hasOverflowed;
+};
+
+
+//-----------------------------------------------------------------------------------------------
+inline bool PacketReadStream::ReserveBytes( unsigned int numBytes )
+{
+	if( m_hasOverflowed || ( m_bufferSizeInBytes - m_numBytesUsed ) < numBytes )
+	{
+		m_hasOverflowed = true;
+		return false;
+	}
+
+	return true;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+inline bool PacketReadStream::SerializeUInt8( unsigned char& value )
+{
+	if( !ReserveBytes( 1 ) )
+		return false;
+
+	value = (unsigned char) m_buffer[ m_numBytesUsed++ ];
+	return true;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+inline bool PacketReadStream::SerializeUInt32( unsigned int& value )
+{
+	if( !ReserveBytes( 4 ) )
+		return false;
+
+	value = 0;
+	for( unsigned int byteIndex = 0; byteIndex < 4; ++byteIndex )
+		value |= ( (unsigned int) (unsigned char) m_buffer[ m_numBytesUsed++ ] ) << ( byteIndex * 8 );
+
+	return true;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+inline bool PacketReadStream::SerializeUInt64( unsigned long long& value )
+{
+	if( !ReserveBytes( 8 ) )
+		return false;
+
+	value = 0;
+	for( unsigned int byteIndex = 0; byteIndex < 8; ++byteIndex )
+		value |= ( (unsigned long long) (unsigned char) m_buffer[ m_numBytesUsed++ ] ) << ( byteIndex * 8 );
+
+	return true;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+template< typename T_Value >
+struct WireFormat;
+
+
+//-----------------------------------------------------------------------------------------------
+template<>
+struct WireFormat< unsigned char >
+{
+	static const unsigned int WIRE_SIZE = 1;
+	template< typename T_Stream >
+		static bool Serialize( T_Stream& stream, unsigned char& value ) { return stream.SerializeUInt8( value ); }
+};
+
+
+//-----------------------------------------------------------------------------------------------
+template<>
+struct WireFormat< unsigned int >
+{
+	static const unsigned int WIRE_SIZE = 4;
+	template< typename T_Stream >
+		static bool Serialize( T_Stream& stream, unsigned int& value ) { return stream.SerializeUInt32( value ); }
+};
+
+
+//-----------------------------------------------------------------------------------------------
+template<>
+struct WireFormat< float >
+{
+	static const unsigned int WIRE_SIZE = 4;
+	template< typename T_Stream >
+		static bool Serialize( T_Stream& stream, float& value );
+};
+
+
+//-----------------------------------------------------------------------------------------------
+template< typename T_Stream >
+inline bool WireFormat< float >::Serialize( T_Stream& stream, float& value )
+{
+	unsigned int bits;
+	memcpy( &bits, &value, sizeof( bits ) );
+	if( !stream.SerializeUInt32( bits ) )
+		return false;
+
+	memcpy( &value, &bits, sizeof( value ) );
+	return true;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+template<>
+struct WireFormat< double >
+{
+	static const unsigned int WIRE_SIZE = 8;
+	template< typename T_Stream >
+		static bool Serialize( T_Stream& stream, double& value );
+};
+
+
+//-----------------------------------------------------------------------------------------------
+template< typename T_Stream >
+inline bool WireFormat< double >::Serialize( T_Stream& stream, double& value )
+{
+	unsigned long long bits;
+	memcpy( &bits, &value, sizeof( bits ) );
+	if( !stream.SerializeUInt64( bits ) )
+		return false;
+
+	memcpy( &value, &bits, sizeof( value ) );
+	return true;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+template< typename T_Element, size_t T_NumElements >
+struct WireFormat< T_Element[ T_NumElements ] >
+{
+	static const unsigned int WIRE_SIZE = WireFormat< T_Element >::WIRE_SIZE * T_NumElements;
+	template< typename T_Stream >
+		static bool Serialize( T_Stream& stream, T_Element ( &values )[ T_NumElements ] );
+};
+
+
+//-----------------------------------------------------------------------------------------------
+template< typename T_Element, size_t T_NumElements >
+template< typename T_Stream >
+inline bool WireFormat< T_Element[ T_NumElements ] >::Serialize( T_Stream& stream, T_Element ( &values )[ T_NumElements ] )
+{
+	for( size_t elementIndex = 0; elementIndex < T_NumElements; ++elementIndex )
+	{
+		if( !WireFormat< T_Element >::Serialize( stream, values[ elementIndex ] ) )
+			return false;
+	}
+
+	return true;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+template< typename T_Message, typename T_Value, T_Value T_Message::*T_Member >
+struct MessageField
+{
+	static const unsigned int WIRE_SIZE = WireFormat< T_Value >::WIRE_SIZE;
+	template< typename T_Stream >
+		static bool Serialize( T_Stream& stream, T_Message& message ) { return WireFormat< T_Value >::Serialize( stream, message.*T_Member ); }
+};
+
+
+//-----------------------------------------------------------------------------------------------
+struct NoMessageField
+{
+	static const unsigned int WIRE_SIZE = 0;
+	template< typename T_Stream, typename T_Message >
+		static bool Serialize( T_Stream&, T_Message& ) { return true; }
+};
+
+
+//-----------------------------------------------------------------------------------------------
+template< typename T_Field0, typename T_Field1 = NoMessageField, typename T_Field2 = NoMessageField, typename T_Field3 = NoMessageField, typename T_Field4 = NoMessageField, typename T_Field5 = NoMessageField >
+struct MessageSchema
+{
+	static const unsigned int WIRE_SIZE = T_Field0::WIRE_SIZE + T_Field1::WIRE_SIZE + T_Field2::WIRE_SIZE + T_Field3::WIRE_SIZE + T_Field4::WIRE_SIZE + T_Field5::WIRE_SIZE;
+	template< typename T_Stream, typename T_Message >
+		static bool Serialize( T_Stream& stream, T_Message& message );
+};
+
+
+//-----------------------------------------------------------------------------------------------
+template< typename T_Field0, typename T_Field1, typename T_Field2, typename T_Field3, typename T_Field4, typename T_Field5 >
+template< typename T_Stream, typename T_Message >
+inline bool MessageSchema< T_Field0, T_Field1, T_Field2, T_Field3, T_Field4, T_Field5 >::Serialize( T_Stream& stream, T_Message& message )
+{
+	return T_Field0::Serialize( stream, message )
+		&& T_Field1::Serialize( stream, message )
+		&& T_Field2::Serialize( stream, message )
+		&& T_Field3::Serialize( stream, message )
+		&& T_Field4::Serialize( stream, message )
+		&& T_Field5::Serialize( stream, message );
+}
+
+
+#endif // include_PacketSerialization
\ No newline at end of file
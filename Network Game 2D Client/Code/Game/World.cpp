@@ -1,5 +1,7 @@
 #include "World.hpp"
+#include <assert.h>
 #include "../Engine/Time.hpp"
+#include "../Engine/ParallelFor.hpp"
 #include "../Engine/DeveloperConsole.hpp"
 #include "../Engine/NewMacroDef.hpp"
 
@@ -11,8 +13,10 @@ World::World( float worldWidth, float worldHeight )
 	, m_isConnectedToServer( false )
 	, m_hasFlag( false )
 	, m_nextPacketNumber( 0 )
+	, m_playerPool( "Player", PLAYER_POOL_SLOTS_PER_SLAB )
+	, m_numJoinAttempts( 0 )
 {
-	m_mainPlayer = new Player();
+	m_mainPlayer = m_playerPool.Create();
 	m_mainPlayer->m_color = Color3b( 255, 255, 255 );
 	m_mainPlayer->m_currentPosition = Vector2( m_size.x * 0.5f, m_size.y * 0.5f );
 	m_mainPlayer->m_previousPosition = Vector2( m_size.x * 0.5f, m_size.y * 0.5f );
@@ -21,6 +25,9 @@ World::World( float worldWidth, float worldHeight )
 	m_mainPlayer->m_orientationDegrees = 0.f;
 	m_flagPosition = Vector2( m_size.x * 0.5f, m_size.y * 0.5f );
 	m_players.push_back( m_mainPlayer );
+
+	InitializeCriticalSection( &m_packetAwaitersCS );
+	RegisterPacketHandlers();
 }
 
 
@@ -29,6 +36,7 @@ void World::Initialize()
 {
 	InitializeTime();
 	InitializeConnection();
+	m_packetAwaitersSubscription = EventChannel< PacketReceivedEvent >::Subscribe< World, &World::WakePacketAwaiters >( this );
 	SendJoinGamePacket();
 	m_playerTexture = Texture::CreateOrGetTexture( PLAYER_TEXTURE_FILE_PATH );
 	m_flagTexture = Texture::CreateOrGetTexture( FLAG_TEXTURE_FILE_PATH );
@@ -42,6 +50,20 @@ void World::Destruct()
 {
 	closesocket( m_socket );
 	WSACleanup();
+
+	RemoveOtherPlayers();
+	m_players.clear();
+	m_playerPool.Destroy( m_mainPlayer );
+	m_mainPlayer = nullptr;
+
+	EventChannel< PacketReceivedEvent >::Unsubscribe( m_packetAwaitersSubscription );
+
+	// the job system is shut down by now, so an awaiter still here belongs to a task that never ran
+	for( unsigned int awaiterIndex = 0; awaiterIndex < m_packetAwaiters.size(); ++awaiterIndex )
+		delete m_packetAwaiters[ awaiterIndex ];
+
+	m_packetAwaiters.clear();
+	DeleteCriticalSection( &m_packetAwaitersCS );
 }
 
 
@@ -49,9 +71,9 @@ void World::Destruct()
 void World::ChangeIPAddress( const std::string& ipAddrString )
 {
 	m_serverAddr.sin_addr.s_addr = inet_addr( ipAddrString.c_str() );
-	m_players.clear();
-	m_players.push_back( m_mainPlayer );
+	RemoveOtherPlayers();
 	m_isConnectedToServer = false;
+	++m_numJoinAttempts;
 }
 
 
@@ -59,9 +81,23 @@ void World::ChangeIPAddress( const std::string& ipAddrString )
 void World::ChangePortNumber( unsigned short portNumber )
 {
 	m_serverAddr.sin_port = htons( portNumber );
+	RemoveOtherPlayers();
+	m_isConnectedToServer = false;
+	++m_numJoinAttempts;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void World::RemoveOtherPlayers()
+{
+	for( unsigned int playerIndex = 0; playerIndex < m_players.size(); ++playerIndex )
+	{
+		if( m_players[ playerIndex ] != m_mainPlayer )
+			m_playerPool.Destroy( m_players[ playerIndex ] );
+	}
+
 	m_players.clear();
 	m_players.push_back( m_mainPlayer );
-	m_isConnectedToServer = false;
 }
 
 
@@ -72,6 +108,7 @@ void World::Update( float deltaSeconds, const Keyboard& keyboard, const Mouse& m
 	CheckForFlagCapture();
 	SendUpdates();
 	ReceivePackets();
+	FlushOutgoingBatch();
 	InterpolatePositions( deltaSeconds );
 }
 
@@ -91,6 +128,17 @@ void World::RenderObjects2D()
 }
 
 
+//-----------------------------------------------------------------------------------------------
+void World::RegisterPacketHandlers()
+{
+	m_packetHandlers.RegisterHandler( TYPE_Update, &World::UpdatePlayer );
+	m_packetHandlers.RegisterHandler( TYPE_Acknowledge, &World::ProcessAckPacket );
+	m_packetHandlers.RegisterHandler( TYPE_Reset, &World::ResetGame );
+	m_packetHandlers.RegisterHandler( TYPE_Victory, &World::AcknowledgeVictory );
+	m_packetHandlers.RegisterHandler( TYPE_Challenge, &World::RespondToChallenge );
+}
+
+
 //-----------------------------------------------------------------------------------------------
 void World::InitializeConnection()
 {
@@ -123,7 +171,12 @@ void World::InitializeConnection()
 //-----------------------------------------------------------------------------------------------
 void World::SendPacket( const CS6Packet& packet, bool requireAck )
 {
-	sendto( m_socket, (char*) &packet, sizeof( packet ), 0, (struct sockaddr*) &m_serverAddr, sizeof( m_serverAddr ) );
+	if( !m_outgoingBatch.AddMessage( packet ) )
+	{
+		FlushOutgoingBatch();
+		m_outgoingBatch.AddMessage( packet );
+	}
+
 	++m_nextPacketNumber;
 
 	if( requireAck )
@@ -133,6 +186,17 @@ void World::SendPacket( const CS6Packet& packet, bool requireAck )
 }
 
 
+//-----------------------------------------------------------------------------------------------
+void World::FlushOutgoingBatch()
+{
+	if( m_outgoingBatch.IsEmpty() )
+		return;
+
+	sendto( m_socket, m_outgoingBatch.m_buffer, m_outgoingBatch.m_numBytesUsed, 0, (struct sockaddr*) &m_serverAddr, sizeof( m_serverAddr ) );
+	m_outgoingBatch.Clear();
+}
+
+
 //-----------------------------------------------------------------------------------------------
 void World::SendJoinGamePacket()
 {
@@ -147,6 +211,22 @@ void World::SendJoinGamePacket()
 }
 
 
+//-----------------------------------------------------------------------------------------------
+void World::RespondToChallenge( const CS6Packet& challengePacket )
+{
+	if( m_isConnectedToServer )
+		return;
+
+	CS6Packet responsePacket;
+	responsePacket.packetNumber = m_nextPacketNumber;
+	responsePacket.packetType = TYPE_Challenge;
+	responsePacket.timestamp = GetCurrentTimeSeconds();
+	responsePacket.data.challenge.cookie = challengePacket.data.challenge.cookie;
+
+	SendPacket( responsePacket, false );
+}
+
+
 //-----------------------------------------------------------------------------------------------
 void World::UpdatePlayer( const CS6Packet& updatePacket )
 {
@@ -175,7 +255,7 @@ void World::UpdatePlayer( const CS6Packet& updatePacket )
 		}
 	}
 
-	Player* player = new Player();
+	Player* player = m_playerPool.Create();
 	player->m_color.r = updatePacket.playerColorAndID[0];
 	player->m_color.g = updatePacket.playerColorAndID[1];
 	player->m_color.b = updatePacket.playerColorAndID[2];
@@ -228,6 +308,8 @@ void World::ResendAckPackets()
 //-----------------------------------------------------------------------------------------------
 void World::ResetGame( const CS6Packet& resetPacket )
 {
+	// the server also resets everyone after a flag capture; only the first reset after a join answers it
+	bool isJoinReply = !m_isConnectedToServer;
 	m_isConnectedToServer = true;
 	m_hasFlag = false;
 
@@ -251,6 +333,8 @@ void World::ResetGame( const CS6Packet& resetPacket )
 	ackPacket.data.acknowledged.packetType = TYPE_Reset;
 
 	SendPacket( ackPacket, false );
+	if( isJoinReply )
+		WakeJoinReplyAwaiters( resetPacket );
 }
 
 
@@ -412,55 +496,162 @@ void World::SendUpdates()
 void World::ReceivePackets()
 {
 	CS6Packet packet;
+	char datagram[ DATAGRAM_MTU_IN_BYTES ];
 	struct sockaddr_in clientAddr;
 	int clientLen = sizeof( clientAddr );
 
-	while( recvfrom( m_socket, (char*) &packet, sizeof( packet ), 0, (struct sockaddr*) &clientAddr, &clientLen ) > 0 )
+	int datagramSizeInBytes = 0;
+	while( ( datagramSizeInBytes = recvfrom( m_socket, datagram, sizeof( datagram ), 0, (struct sockaddr*) &clientAddr, &clientLen ) ) > 0 )
 	{
-		if( packet.packetType == TYPE_Update )
+		PacketBatchReader batchReader( datagram, datagramSizeInBytes );
+		while( batchReader.GetNextMessage( packet ) )
 		{
-			UpdatePlayer( packet );
-		}
-		else if( packet.packetType == TYPE_Acknowledge )
-		{
-			ProcessAckPacket( packet );
-		}
-		else if( packet.packetType == TYPE_Reset )
-		{
-			ResetGame( packet );
-		}
-		else if( packet.packetType == TYPE_Victory )
-		{
-			AcknowledgeVictory( packet );
+			PacketHandlerFunc handler = m_packetHandlers.GetHandler( packet.packetType );
+			if( handler != nullptr )
+				( this->*handler )( packet );
+
+			EventChannel< PacketReceivedEvent >::Fire( PacketReceivedEvent( packet ) );
 		}
 	}
 }
 
 
 //-----------------------------------------------------------------------------------------------
-void World::InterpolatePositions( float deltaSeconds )
+//Lets a job wait for the next packet of a type, such as the ack for a reliable packet, after the
+//main thread has handled it as usual. Returns false if nothing arrived before the timeout.
+bool World::AwaitPacket( PacketType packetType, double timeoutSeconds, CS6Packet& packet_out )
 {
-	for( unsigned int playerIndex = 0; playerIndex < m_players.size(); ++playerIndex )
+	assert( JobManager::IsWorkerThread() );
+	return AwaitExpectedPacket( RegisterPacketAwaiter( packetType, false ), timeoutSeconds, packet_out );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+//Main thread only, right after changing servers. The awaiter is registered before the next
+//Update sends the join, so a reply that comes in before a job awaits it is still caught.
+World::PacketAwaiter* World::ExpectJoinReply()
+{
+	return RegisterPacketAwaiter( TYPE_Reset, true );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+//Waits on an awaiter from RegisterPacketAwaiter, then unregisters and deletes it.
+bool World::AwaitExpectedPacket( PacketAwaiter* awaiter, double timeoutSeconds, CS6Packet& packet_out )
+{
+	assert( JobManager::IsWorkerThread() );
+
+	JobManager::AddTimer( &awaiter->m_arrivedOrTimedOut, timeoutSeconds );
+	JobManager::WaitFor( &awaiter->m_arrivedOrTimedOut );
+	JobManager::CancelTimer( &awaiter->m_arrivedOrTimedOut );
+
+	EnterCriticalSection( &m_packetAwaitersCS );
+	for( unsigned int awaiterIndex = 0; awaiterIndex < m_packetAwaiters.size(); ++awaiterIndex )
 	{
-		Player* player = m_players[ playerIndex ];
-		if( player == nullptr || player == m_mainPlayer )
+		if( m_packetAwaiters[ awaiterIndex ] == awaiter )
 		{
-			player->m_currentPosition += player->m_currentVelocity * deltaSeconds;
+			m_packetAwaiters.erase( m_packetAwaiters.begin() + awaiterIndex );
+			break;
 		}
-		else
-		{
-			Vector2 blendVector = player->m_currentVelocity + ( player->m_previousVelocity - player->m_currentVelocity ) * player->m_secondsSinceLastUpdate;
-			Vector2 currentProj = player->m_currentPosition + player->m_currentVelocity * deltaSeconds;
-			Vector2 previousProj = player->m_previousPosition + player->m_previousVelocity * deltaSeconds;
-			Vector2 gotoPosition = currentProj + ( previousProj - currentProj ) * player->m_secondsSinceLastUpdate;
-			player->m_secondsSinceLastUpdate += deltaSeconds;
+	}
+
+	bool hasArrived = awaiter->m_hasArrived;
+	if( hasArrived )
+		packet_out = awaiter->m_packet;
+	LeaveCriticalSection( &m_packetAwaitersCS );
+
+	delete awaiter;
+	return hasArrived;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+World::PacketAwaiter* World::RegisterPacketAwaiter( PacketType packetType, bool isJoinReplyOnly )
+{
+	PacketAwaiter* awaiter = new PacketAwaiter;
+	awaiter->m_packetType = packetType;
+	awaiter->m_isJoinReplyOnly = isJoinReplyOnly;
+	awaiter->m_joinAttempt = isJoinReplyOnly ? m_numJoinAttempts : 0;
+	awaiter->m_hasArrived = false;
+	awaiter->m_arrivedOrTimedOut.m_numUnfinishedJobs = 1;
+
+	EnterCriticalSection( &m_packetAwaitersCS );
+	m_packetAwaiters.push_back( awaiter );
+	LeaveCriticalSection( &m_packetAwaitersCS );
+
+	return awaiter;
+}
 
-			player->m_currentPosition += deltaSeconds * ( gotoPosition - player->m_currentPosition );
-		}
 
-		player->m_currentPosition.x = ClampFloat( player->m_currentPosition.x, 0.f, m_size.x );
-		player->m_currentPosition.y = ClampFloat( player->m_currentPosition.y, 0.f, m_size.y );
+//-----------------------------------------------------------------------------------------------
+void World::WakePacketAwaiters( const PacketReceivedEvent& event )
+{
+	const CS6Packet& packet = event.m_packet;
+	EnterCriticalSection( &m_packetAwaitersCS );
+	for( unsigned int awaiterIndex = 0; awaiterIndex < m_packetAwaiters.size(); ++awaiterIndex )
+	{
+		PacketAwaiter* awaiter = m_packetAwaiters[ awaiterIndex ];
+		if( awaiter->m_isJoinReplyOnly || awaiter->m_packetType != packet.packetType || awaiter->m_hasArrived )
+			continue;
+
+		awaiter->m_packet = packet;
+		awaiter->m_hasArrived = true;
+		JobManager::SignalCounter( &awaiter->m_arrivedOrTimedOut );
 	}
+	LeaveCriticalSection( &m_packetAwaitersCS );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+//A join started before the latest change of server is stale, so its awaiter keeps waiting and
+//times out rather than take this reply.
+void World::WakeJoinReplyAwaiters( const CS6Packet& resetPacket )
+{
+	EnterCriticalSection( &m_packetAwaitersCS );
+	for( unsigned int awaiterIndex = 0; awaiterIndex < m_packetAwaiters.size(); ++awaiterIndex )
+	{
+		PacketAwaiter* awaiter = m_packetAwaiters[ awaiterIndex ];
+		if( !awaiter->m_isJoinReplyOnly || awaiter->m_joinAttempt != m_numJoinAttempts || awaiter->m_hasArrived )
+			continue;
+
+		awaiter->m_packet = resetPacket;
+		awaiter->m_hasArrived = true;
+		JobManager::SignalCounter( &awaiter->m_arrivedOrTimedOut );
+	}
+	LeaveCriticalSection( &m_packetAwaitersCS );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void World::InterpolatePositions( float deltaSeconds )
+{
+	ParallelFor( 0, (unsigned int) m_players.size(), PLAYER_INTERPOLATION_GRAIN_SIZE, InterpolatePlayerPositionFunction( this, deltaSeconds ) );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void World::InterpolatePlayerPosition( Player* player, float deltaSeconds )
+{
+	if( player == nullptr )
+		return;
+
+	if( player == m_mainPlayer )
+	{
+		player->m_currentPosition += player->m_currentVelocity * deltaSeconds;
+	}
+	else
+	{
+		Vector2 blendVector = player->m_currentVelocity + ( player->m_previousVelocity - player->m_currentVelocity ) * player->m_secondsSinceLastUpdate;
+		Vector2 currentProj = player->m_currentPosition + player->m_currentVelocity * deltaSeconds;
+		Vector2 previousProj = player->m_previousPosition + player->m_previousVelocity * deltaSeconds;
+		Vector2 gotoPosition = currentProj + ( previousProj - currentProj ) * player->m_secondsSinceLastUpdate;
+		player->m_secondsSinceLastUpdate += deltaSeconds;
+
+		player->m_currentPosition += deltaSeconds * ( gotoPosition - player->m_currentPosition );
+	}
+
+	player->m_currentPosition.x = ClampFloat( player->m_currentPosition.x, 0.f, m_size.x );
+	player->m_currentPosition.y = ClampFloat( player->m_currentPosition.y, 0.f, m_size.y );
 }
 
 
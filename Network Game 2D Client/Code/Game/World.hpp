@@ -8,6 +8,8 @@
 #include "Player.hpp"
 #include "Color3b.hpp"
 #include "CS6Packet.hpp"
+#include "PacketBatch.hpp"
+#include "PacketDispatchTable.hpp"
 #include "GameCommon.hpp"
 #include "../Engine/Clock.hpp"
 #include "../Engine/Mouse.hpp"
@@ -18,6 +20,9 @@
 #include "../Engine/Vector2.hpp"
 #include "../Engine/Keyboard.hpp"
 #include "../Engine/Material.hpp"
+#include "../Engine/JobManager.hpp"
+#include "../Engine/ObjectPool.hpp"
+#include "../Engine/EventChannel.hpp"
 #include "../Engine/BitmapFont.hpp"
 #include "../Engine/DebugGraphics.hpp"
 #include "../Engine/OpenGLRenderer.hpp"
@@ -35,17 +40,43 @@ const float POINT_SIZE_PIXELS = 30.f;
 const float ONE_HALF_POINT_SIZE_PIXELS = POINT_SIZE_PIXELS * 0.5f;
 const double SECONDS_BEFORE_RESEND_INIT_PACKET = 0.1;
 const double SECONDS_BEFORE_SEND_UPDATE_PACKET = 0.05;
+const double SECONDS_BEFORE_JOIN_TIMEOUT = 5.0;
 const unsigned short PORT_NUMBER = 5000;
+const unsigned int PLAYER_POOL_SLOTS_PER_SLAB = 16;
+const unsigned int PLAYER_INTERPOLATION_GRAIN_SIZE = 32;
 //const std::string IP_ADDRESS = "129.119.142.83";
 const std::string IP_ADDRESS = "127.0.0.1";
 const std::string FLAG_TEXTURE_FILE_PATH = "../Data/Images/Flag.png";
 const std::string PLAYER_TEXTURE_FILE_PATH = "../Data/Images/Player.png";
 
 
+//-----------------------------------------------------------------------------------------------
+//Fired on the main thread for every packet received, after its handler has run.
+struct PacketReceivedEvent
+{
+	PacketReceivedEvent( const CS6Packet& packet ) : m_packet( packet ) {}
+
+	const CS6Packet&	m_packet;
+
+private:
+	void operator=( const PacketReceivedEvent& );
+};
+
+
 //-----------------------------------------------------------------------------------------------
 class World
 {
 public:
+	struct PacketAwaiter
+	{
+		PacketType		m_packetType;
+		bool			m_isJoinReplyOnly;
+		unsigned int	m_joinAttempt;
+		bool			m_hasArrived;
+		CS6Packet		m_packet;
+		JobCounter		m_arrivedOrTimedOut;
+	};
+
 	World( float worldWidth, float worldHeight );
 	void Initialize();
 	void Destruct();
@@ -54,11 +85,28 @@ public:
 	void Update( float deltaSeconds, const Keyboard& keyboard, const Mouse& mouse );
 	void RenderObjects3D();
 	void RenderObjects2D();
+	bool AwaitPacket( PacketType packetType, double timeoutSeconds, CS6Packet& packet_out );
+	PacketAwaiter* ExpectJoinReply();
+	bool AwaitExpectedPacket( PacketAwaiter* awaiter, double timeoutSeconds, CS6Packet& packet_out );
 
 private:
+	typedef void ( World::*PacketHandlerFunc )( const CS6Packet& pkt );
+
+	struct InterpolatePlayerPositionFunction
+	{
+		InterpolatePlayerPositionFunction( World* world, float deltaSeconds ) : m_world( world ), m_deltaSeconds( deltaSeconds ) {}
+		void operator()( unsigned int playerIndex ) const { m_world->InterpolatePlayerPosition( m_world->m_players[ playerIndex ], m_deltaSeconds ); }
+
+		World*	m_world;
+		float	m_deltaSeconds;
+	};
+
+	void RegisterPacketHandlers();
 	void InitializeConnection();
 	void SendPacket( const CS6Packet& pkt, bool requireAck );
+	void FlushOutgoingBatch();
 	void SendJoinGamePacket();
+	void RespondToChallenge( const CS6Packet& challengePacket );
 	void UpdatePlayer( const CS6Packet& updatePacket );
 	void ProcessAckPacket( const CS6Packet& ackPacket );
 	void ResendAckPackets();
@@ -68,8 +116,13 @@ private:
 	void CheckForFlagCapture();
 	void UpdateFromInput( const Keyboard& keyboard, const Mouse& mouse );
 	void SendUpdates();
+	void RemoveOtherPlayers();
 	void ReceivePackets();
+	PacketAwaiter* RegisterPacketAwaiter( PacketType packetType, bool isJoinReplyOnly );
+	void WakePacketAwaiters( const PacketReceivedEvent& event );
+	void WakeJoinReplyAwaiters( const CS6Packet& resetPacket );
 	void InterpolatePositions( float deltaSeconds );
+	void InterpolatePlayerPosition( Player* player, float deltaSeconds );
 	void RenderFlag();
 	void RenderPlayers();
 
@@ -82,13 +135,20 @@ private:
 	struct sockaddr_in			m_serverAddr;
 	unsigned int				m_nextPacketNumber;
 	bool						m_isConnectedToServer;
+	unsigned int				m_numJoinAttempts;
 	bool						m_hasFlag;
 	double						m_timeWhenLastInitPacketSent;
 	double						m_timeWhenLastUpdatePacketSent;
 	Vector2						m_flagPosition;
+	ObjectPool< Player >		m_playerPool;
 	Player*						m_mainPlayer;
 	std::vector< Player* >		m_players;
 	std::vector< CS6Packet >	m_sentPackets;
+	PacketBatch					m_outgoingBatch;
+	PacketDispatchTable< PacketHandlerFunc >	m_packetHandlers;
+	std::vector< PacketAwaiter* >	m_packetAwaiters;
+	CRITICAL_SECTION				m_packetAwaitersCS;
+	EventChannelHandle				m_packetAwaitersSubscription;
 };
 
 
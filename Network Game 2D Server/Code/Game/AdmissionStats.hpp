@@ -0,0 +1,21 @@
+#ifndef include_AdmissionStats
+#define include_AdmissionStats
+#pragma once
+
+//-----------------------------------------------------------------------------------------------
+struct AdmissionStats
+{
+	AdmissionStats() : m_joinRequests( 0 ), m_challengesSent( 0 ), m_rejectedRateLimited( 0 ), m_rejectedBadCookie( 0 ), m_rejectedSessionCap( 0 ), m_rejectedServerFull( 0 ), m_admitted( 0 ) {}
+	unsigned int GetTotalRejected() const { return m_rejectedRateLimited + m_rejectedBadCookie + m_rejectedSessionCap + m_rejectedServerFull; }
+
+	unsigned int	m_joinRequests;
+	unsigned int	m_challengesSent;
+	unsigned int	m_rejectedRateLimited;
+	unsigned int	m_rejectedBadCookie;
+	unsigned int	m_rejectedSessionCap;
+	unsigned int	m_rejectedServerFull;
+	unsigned int	m_admitted;
+};
+
+
+#endif // include_AdmissionStats
\ No newline at end of file
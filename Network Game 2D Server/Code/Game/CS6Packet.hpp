@@ -4,6 +4,8 @@
 
 //Communication Protocol:
 //   Client->Server: Ack
+//   Server->Client: Challenge
+//   Client->Server: Challenge (echoes the server's cookie)
 //   Server->Client: Reset
 //   Client->Server: Ack
 
@@ -25,6 +27,7 @@ static const PacketType TYPE_Acknowledge = 10;
 static const PacketType TYPE_Victory = 11;
 static const PacketType TYPE_Update = 12;
 static const PacketType TYPE_Reset = 13;
+static const PacketType TYPE_Challenge = 14;
 
 //-----------------------------------------------------------------------------------------------
 struct AckPacket
@@ -63,6 +66,12 @@ struct VictoryPacket
 	unsigned char playerColorAndID[ 3 ];
 };
 
+//-----------------------------------------------------------------------------------------------
+struct ChallengePacket
+{
+	unsigned int cookie;
+};
+
 
 
 //-----------------------------------------------------------------------------------------------
@@ -78,6 +87,7 @@ struct CS6Packet
 		ResetPacket reset;
 		UpdatePacket updated;
 		VictoryPacket victorious;
+		ChallengePacket challenge;
 	} data;
 };
 
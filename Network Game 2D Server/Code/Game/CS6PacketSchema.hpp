@@ -0,0 +1,191 @@
+#ifndef include_CS6PacketSchema
+#define include_CS6PacketSchema
+#pragma once
+
+//-----------------------------------------------------------------------------------------------
+#include "CS6Packet.hpp"
+#include "PacketSerialization.hpp"
+
+//Wire Layout:
+//   [16 bytes] header: packetType, playerColorAndID, packetNumber, timestamp
+//   [N bytes]  body described by the schema for packetType; N is fixed per type
+
+
+//-----------------------------------------------------------------------------------------------
+typedef MessageSchema<
+	MessageField< CS6Packet, PacketType, &CS6Packet::packetType >,
+	MessageField< CS6Packet, unsigned char[ 3 ], &CS6Packet::playerColorAndID >,
+	MessageField< CS6Packet, unsigned int, &CS6Packet::packetNumber >,
+	MessageField< CS6Packet, double, &CS6Packet::timestamp > > CS6PacketHeaderSchema;
+
+typedef MessageSchema<
+	MessageField< AckPacket, PacketType, &AckPacket::packetType >,
+	MessageField< AckPacket, unsigned int, &AckPacket::packetNumber > > AckPacketSchema;
+
+typedef MessageSchema<
+	MessageField< ResetPacket, float, &ResetPacket::flagXPosition >,
+	MessageField< ResetPacket, float, &ResetPacket::flagYPosition >,
+	MessageField< ResetPacket, float, &ResetPacket::playerXPosition >,
+	MessageField< ResetPacket, float, &ResetPacket::playerYPosition >,
+	MessageField< ResetPacket, unsigned char[ 3 ], &ResetPacket::playerColorAndID > > ResetPacketSchema;
+
+typedef MessageSchema<
+	MessageField< UpdatePacket, float, &UpdatePacket::xPosition >,
+	MessageField< UpdatePacket, float, &UpdatePacket::yPosition >,
+	MessageField< UpdatePacket, float, &UpdatePacket::xVelocity >,
+	MessageField< UpdatePacket, float, &UpdatePacket::yVelocity >,
+	MessageField< UpdatePacket, float, &UpdatePacket::yawDegrees > > UpdatePacketSchema;
+
+typedef MessageSchema<
+	MessageField< VictoryPacket, unsigned char[ 3 ], &VictoryPacket::playerColorAndID > > VictoryPacketSchema;
+
+typedef MessageSchema<
+	MessageField< ChallengePacket, unsigned int, &ChallengePacket::cookie > > ChallengePacketSchema;
+
+
+//-----------------------------------------------------------------------------------------------
+template< PacketType T_PacketType >
+struct CS6PacketBody;
+
+
+//-----------------------------------------------------------------------------------------------
+template<>
+struct CS6PacketBody< TYPE_Acknowledge >
+{
+	typedef AckPacketSchema Schema;
+	static AckPacket& Get( CS6Packet& pkt ) { return pkt.data.acknowledged; }
+};
+
+
+//-----------------------------------------------------------------------------------------------
+template<>
+struct CS6PacketBody< TYPE_Victory >
+{
+	typedef VictoryPacketSchema Schema;
+	static VictoryPacket& Get( CS6Packet& pkt ) { return pkt.data.victorious; }
+};
+
+
+//-----------------------------------------------------------------------------------------------
+template<>
+struct CS6PacketBody< TYPE_Update >
+{
+	typedef UpdatePacketSchema Schema;
+	static UpdatePacket& Get( CS6Packet& pkt ) { return pkt.data.updated; }
+};
+
+
+//-----------------------------------------------------------------------------------------------
+template<>
+struct CS6PacketBody< TYPE_Reset >
+{
+	typedef ResetPacketSchema Schema;
+	static ResetPacket& Get( CS6Packet& pkt ) { return pkt.data.reset; }
+};
+
+
+//-----------------------------------------------------------------------------------------------
+template<>
+struct CS6PacketBody< TYPE_Challenge >
+{
+	typedef ChallengePacketSchema Schema;
+	static ChallengePacket& Get( CS6Packet& pkt ) { return pkt.data.challenge; }
+};
+
+
+//-----------------------------------------------------------------------------------------------
+template< PacketType T_PacketType >
+struct CS6PacketCodec
+{
+	static const unsigned int WIRE_SIZE = CS6PacketHeaderSchema::WIRE_SIZE + CS6PacketBody< T_PacketType >::Schema::WIRE_SIZE;
+	static bool Write( PacketWriteStream& stream, CS6Packet& pkt ) { return CS6PacketBody< T_PacketType >::Schema::Serialize( stream, CS6PacketBody< T_PacketType >::Get( pkt ) ); }
+	static bool Read( PacketReadStream& stream, CS6Packet& pkt ) { return CS6PacketBody< T_PacketType >::Schema::Serialize( stream, CS6PacketBody< T_PacketType >::Get( pkt ) ); }
+};
+
+
+//-----------------------------------------------------------------------------------------------
+static const PacketType FIRST_CS6_PACKET_TYPE = TYPE_Acknowledge;
+static const PacketType LAST_CS6_PACKET_TYPE = TYPE_Challenge;
+static const unsigned int MAX_CS6_PACKET_WIRE_SIZE = CS6PacketCodec< TYPE_Update >::WIRE_SIZE;
+
+static_assert( CS6PacketHeaderSchema::WIRE_SIZE == 16, "CS6Packet header wire size changed" );
+static_assert( CS6PacketCodec< TYPE_Acknowledge >::WIRE_SIZE <= MAX_CS6_PACKET_WIRE_SIZE, "Ack packet is larger than the largest packet" );
+static_assert( CS6PacketCodec< TYPE_Victory >::WIRE_SIZE <= MAX_CS6_PACKET_WIRE_SIZE, "Victory packet is larger than the largest packet" );
+static_assert( CS6PacketCodec< TYPE_Reset >::WIRE_SIZE <= MAX_CS6_PACKET_WIRE_SIZE, "Reset packet is larger than the largest packet" );
+static_assert( CS6PacketCodec< TYPE_Challenge >::WIRE_SIZE <= MAX_CS6_PACKET_WIRE_SIZE, "Challenge packet is larger than the largest packet" );
+static_assert( MAX_CS6_PACKET_WIRE_SIZE <= sizeof( CS6Packet ), "Encoded packets should never be larger than the in-memory packet" );
+
+
+//-----------------------------------------------------------------------------------------------
+struct CS6PacketCodecEntry
+{
+	bool ( *m_writeFunction )( PacketWriteStream&, CS6Packet& );
+	bool ( *m_readFunction )( PacketReadStream&, CS6Packet& );
+	unsigned int m_wireSizeInBytes;
+};
+
+
+//-----------------------------------------------------------------------------------------------
+static const CS6PacketCodecEntry CS6_PACKET_CODECS[ LAST_CS6_PACKET_TYPE - FIRST_CS6_PACKET_TYPE + 1 ] =
+{
+	{ &CS6PacketCodec< TYPE_Acknowledge >::Write, &CS6PacketCodec< TYPE_Acknowledge >::Read, CS6PacketCodec< TYPE_Acknowledge >::WIRE_SIZE },
+	{ &CS6PacketCodec< TYPE_Victory >::Write, &CS6PacketCodec< TYPE_Victory >::Read, CS6PacketCodec< TYPE_Victory >::WIRE_SIZE },
+	{ &CS6PacketCodec< TYPE_Update >::Write, &CS6PacketCodec< TYPE_Update >::Read, CS6PacketCodec< TYPE_Update >::WIRE_SIZE },
+	{ &CS6PacketCodec< TYPE_Reset >::Write, &CS6PacketCodec< TYPE_Reset >::Read, CS6PacketCodec< TYPE_Reset >::WIRE_SIZE },
+	{ &CS6PacketCodec< TYPE_Challenge >::Write, &CS6PacketCodec< TYPE_Challenge >::Read, CS6PacketCodec< TYPE_Challenge >::WIRE_SIZE },
+};
+
+
+//-----------------------------------------------------------------------------------------------
+inline const CS6PacketCodecEntry* GetCS6PacketCodec( PacketType packetType )
+{
+	if( packetType < FIRST_CS6_PACKET_TYPE || packetType > LAST_CS6_PACKET_TYPE )
+		return nullptr;
+
+	return &CS6_PACKET_CODECS[ packetType - FIRST_CS6_PACKET_TYPE ];
+}
+
+
+//-----------------------------------------------------------------------------------------------
+inline unsigned int GetCS6PacketWireSize( PacketType packetType )
+{
+	const CS6PacketCodecEntry* codec = GetCS6PacketCodec( packetType );
+	if( codec == nullptr )
+		return 0;
+
+	return codec->m_wireSizeInBytes;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+inline unsigned int WriteCS6Packet( const CS6Packet& pkt, char* buffer, unsigned int bufferSizeInBytes )
+{
+	const CS6PacketCodecEntry* codec = GetCS6PacketCodec( pkt.packetType );
+	if( codec == nullptr || codec->m_wireSizeInBytes > bufferSizeInBytes )
+		return 0;
+
+	CS6Packet pktCopy = pkt;
+	PacketWriteStream stream( buffer, bufferSizeInBytes );
+	if( !CS6PacketHeaderSchema::Serialize( stream, pktCopy ) || !codec->m_writeFunction( stream, pktCopy ) )
+		return 0;
+
+	return stream.GetNumBytesUsed();
+}
+
+
+//-----------------------------------------------------------------------------------------------
+inline bool ReadCS6Packet( const char* buffer, unsigned int bufferSizeInBytes, CS6Packet& pkt_out )
+{
+	if( bufferSizeInBytes == 0 )
+		return false;
+
+	const CS6PacketCodecEntry* codec = GetCS6PacketCodec( (PacketType) buffer[ 0 ] );
+	if( codec == nullptr || codec->m_wireSizeInBytes != bufferSizeInBytes )
+		return false;
+
+	PacketReadStream stream( buffer, bufferSizeInBytes );
+	return CS6PacketHeaderSchema::Serialize( stream, pkt_out ) && codec->m_readFunction( stream, pkt_out );
+}
+
+
+#endif // include_CS6PacketSchema
\ No newline at end of file
@@ -7,13 +7,13 @@ struct ClientInfo
 {
 	bool operator<( const ClientInfo& info ) const;
 
-	char*			m_ipAddress;
+	unsigned long	m_ipAddress; // network byte order, as in sockaddr_in
 	unsigned short	m_portNumber;
 };
 
 
 //-----------------------------------------------------------------------------------------------
-bool ClientInfo::operator<( const ClientInfo& info ) const
+inline bool ClientInfo::operator<( const ClientInfo& info ) const
 {
 	if( m_ipAddress < info.m_ipAddress )
 		return true;
@@ -10,6 +10,7 @@
 //-----------------------------------------------------------------------------------------------
 struct Player
 {
+	unsigned int	m_playerID;
 	Color3b			m_color;
 	Vector2			m_position;
 	Vector2			m_velocity;
@@ -0,0 +1,46 @@
+#ifndef include_Room
+#define include_Room
+#pragma once
+
+//-----------------------------------------------------------------------------------------------
+#include <map>
+#include <vector>
+#include "Player.hpp"
+#include "CS6Packet.hpp"
+#include "ClientInfo.hpp"
+#include "PacketBatch.hpp"
+#include "../Engine/Vector2.hpp"
+
+
+//-----------------------------------------------------------------------------------------------
+struct RoomMessage
+{
+	RoomMessage( const CS6Packet& pkt, const ClientInfo& info ) : m_packet( pkt ), m_clientInfo( info ) {}
+
+	CS6Packet		m_packet;
+	ClientInfo		m_clientInfo;
+};
+
+
+//-----------------------------------------------------------------------------------------------
+//Everything a single match needs. A room is only ever touched by one thread at a time: the main
+//thread while it receives packets and admits players, then a single worker while the room ticks.
+struct Room
+{
+	Room( unsigned int roomID, unsigned int randomSeed ) : m_roomID( roomID ), m_randomSeed( randomSeed ), m_nextPacketNumber( 0 ), m_secondsSinceLastUpdate( 0.0 ), m_secondsSinceLastReliableSend( 0.0 ) {}
+
+	unsigned int										m_roomID;
+	unsigned int										m_randomSeed;
+	unsigned int										m_nextPacketNumber;
+	double												m_secondsSinceLastUpdate;
+	double												m_secondsSinceLastReliableSend;
+	Vector2												m_flagPosition;
+	std::map< ClientInfo, Player* >						m_players;
+	std::map< ClientInfo, std::vector< CS6Packet > >	m_sentPacketsPerClient;
+	std::map< ClientInfo, PacketBatch >					m_outgoingBatchPerClient;
+	std::vector< RoomMessage >							m_inbox;
+	std::vector< ClientInfo >							m_departedClients;
+};
+
+
+#endif // include_Room
\ No newline at end of file
@@ -0,0 +1,49 @@
+#ifndef include_TokenBucket
+#define include_TokenBucket
+#pragma once
+
+//-----------------------------------------------------------------------------------------------
+struct TokenBucket
+{
+	TokenBucket() : m_tokens( 0.0 ), m_lastRefillTime( 0.0 ) {}
+	TokenBucket( double burstTokens, double currentTime ) : m_tokens( burstTokens ), m_lastRefillTime( currentTime ) {}
+	void Refill( double tokensPerSecond, double burstTokens, double currentTime );
+	bool TryConsume( double tokensPerSecond, double burstTokens, double currentTime );
+	bool IsFull( double tokensPerSecond, double burstTokens, double currentTime ) const;
+
+	double	m_tokens;
+	double	m_lastRefillTime;
+};
+
+
+//-----------------------------------------------------------------------------------------------
+inline void TokenBucket::Refill( double tokensPerSecond, double burstTokens, double currentTime )
+{
+	m_tokens += ( currentTime - m_lastRefillTime ) * tokensPerSecond;
+	if( m_tokens > burstTokens )
+		m_tokens = burstTokens;
+
+	m_lastRefillTime = currentTime;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+inline bool TokenBucket::TryConsume( double tokensPerSecond, double burstTokens, double currentTime )
+{
+	Refill( tokensPerSecond, burstTokens, currentTime );
+	if( m_tokens < 1.0 )
+		return false;
+
+	m_tokens -= 1.0;
+	return true;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+inline bool TokenBucket::IsFull( double tokensPerSecond, double burstTokens, double currentTime ) const
+{
+	return ( m_tokens + ( currentTime - m_lastRefillTime ) * tokensPerSecond ) >= burstTokens;
+}
+
+
+#endif // include_TokenBucket
\ No newline at end of file
@@ -4,13 +4,21 @@
 #include <vector>
 #include <sstream>
 #include <iostream>
+#include <process.h>
 #include <WinSock2.h>
+#include <wincrypt.h>
+#include "Room.hpp"
 #include "Player.hpp"
 #include "Color3b.hpp"
 #include "CS6Packet.hpp"
 #include "ClientInfo.hpp"
+#include "PacketBatch.hpp"
+#include "PacketDispatchTable.hpp"
+#include "TokenBucket.hpp"
+#include "AdmissionStats.hpp"
 #include "../Engine/Time.hpp"
 #pragma comment(lib,"ws2_32.lib")
+#pragma comment(lib,"advapi32.lib")
 
 //-----------------------------------------------------------------------------------------------
 const unsigned short PORT_NUMBER = 5000;
@@ -18,21 +26,50 @@ const int MAP_SIZE_WIDTH = 500;
 const int MAP_SIZE_HEIGHT = 500;
 const double SECONDS_BEFORE_SEND_UPDATE = 0.0045;
 const double SECONDS_BEFORE_RESEND_RELIABLE_PACKETS = 0.25;
+const double JOIN_TOKENS_PER_SECOND_PER_ADDRESS = 1.0;
+const double JOIN_BURST_TOKENS_PER_ADDRESS = 4.0;
+const double NEW_SESSIONS_PER_SECOND = 20.0;
+const double NEW_SESSIONS_BURST = 20.0;
+const double SECONDS_PER_COOKIE_WINDOW = 5.0;
+const double SECONDS_BETWEEN_JOIN_BUCKET_PRUNES = 1.0;
+const double SECONDS_BETWEEN_ADMISSION_REPORTS = 5.0;
+const size_t MAX_TRACKED_JOIN_ADDRESSES = 4096;
+const int MAX_DATAGRAMS_PER_UPDATE = 512;
+const unsigned int MAX_PLAYERS_PER_ROOM = 8;
+const unsigned int MAX_ROOMS = 64;
+const unsigned int MAX_ROOM_WORKER_THREADS = 16;
+
+
+//-----------------------------------------------------------------------------------------------
+typedef void ( *PacketHandlerFunc )( Room& room, const CS6Packet& pkt, const ClientInfo& info );
 
 
 //-----------------------------------------------------------------------------------------------
 bool g_isQuitting = false;
 WSADATA g_wsaData;
 SOCKET	g_socket;
-double g_secondsSinceLastUpdate;
-double g_secondsSinceLastReliableSend;
 struct sockaddr_in g_serverAddr;
 struct sockaddr_in g_clientAddr;
 int g_clientLen = sizeof( g_clientAddr );
-unsigned int g_nextPacketNumber = 0;
-Vector2 g_flagPosition;
-std::map< ClientInfo, Player* > g_players;
-std::map< ClientInfo, std::vector< CS6Packet > > g_sentPacketsPerClient;
+unsigned int g_nextHandshakePacketNumber = 0;
+std::vector< Room* > g_rooms;
+unsigned int g_nextRoomID = 0;
+std::map< ClientInfo, Room* > g_roomPerClient;
+PacketDispatchTable< PacketHandlerFunc > g_packetHandlers;
+unsigned int g_cookieSecret;
+std::map< unsigned long, TokenBucket > g_joinBucketPerAddress;
+TokenBucket g_newSessionBucket;
+double g_lastJoinBucketPruneTime;
+AdmissionStats g_admissionStats;
+unsigned int g_lastReportedNumRejected = 0;
+double g_lastAdmissionReportTime;
+CRITICAL_SECTION g_consoleCS;
+std::vector< HANDLE > g_roomWorkerThreads;
+HANDLE g_roomTickStartSemaphore;
+HANDLE g_roomTickDoneEvent;
+volatile LONG g_nextRoomToTick;
+volatile LONG g_numRoomWorkersTicking;
+volatile bool g_areRoomWorkersQuitting = false;
 
 
 //-----------------------------------------------------------------------------------------------
@@ -44,6 +81,15 @@ void PrintError( const char* errorMessage, bool quitProgram )
 }
 
 
+//-----------------------------------------------------------------------------------------------
+void PrintRoomMessage( const Room& room, const std::string& message )
+{
+	EnterCriticalSection( &g_consoleCS );
+	std::cout << "[Room " << room.m_roomID << "] " << message << "\n";
+	LeaveCriticalSection( &g_consoleCS );
+}
+
+
 //-----------------------------------------------------------------------------------------------
 std::string ConvertNumberToString( int number )
 {
@@ -51,6 +97,15 @@ std::string ConvertNumberToString( int number )
 }
 
 
+//-----------------------------------------------------------------------------------------------
+std::string GetClientAddressString( const ClientInfo& info )
+{
+	struct in_addr addr;
+	addr.s_addr = info.m_ipAddress;
+	return std::string( inet_ntoa( addr ) ) + ":" + ConvertNumberToString( ntohs( info.m_portNumber ) );
+}
+
+
 //-----------------------------------------------------------------------------------------------
 Color3b GetPlayerColorForID( unsigned int playerID )
 {
@@ -76,11 +131,19 @@ Color3b GetPlayerColorForID( unsigned int playerID )
 
 
 //-----------------------------------------------------------------------------------------------
-Vector2 GetRandomPosition()
+int GetRoomRandomInt( Room& room )
+{
+	room.m_randomSeed = room.m_randomSeed * 1103515245 + 12345;
+	return (int) ( ( room.m_randomSeed >> 16 ) & 0x7fff );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+Vector2 GetRandomPosition( Room& room )
 {
 	Vector2 returnVec;
-	returnVec.x = (float) ( rand() % MAP_SIZE_WIDTH );
-	returnVec.y = (float) ( rand() % MAP_SIZE_HEIGHT );
+	returnVec.x = (float) ( GetRoomRandomInt( room ) % MAP_SIZE_WIDTH );
+	returnVec.y = (float) ( GetRoomRandomInt( room ) % MAP_SIZE_HEIGHT );
 
 	return returnVec;
 }
@@ -124,80 +187,130 @@ void InitializeServer()
 
 
 //-----------------------------------------------------------------------------------------------
-void SendPacketToSinglePlayer( const CS6Packet& pkt, const ClientInfo& info, bool requireAck )
+void SendBatchToSinglePlayer( PacketBatch& batch, const ClientInfo& info )
+{
+	if( batch.IsEmpty() )
+		return;
+
+	// rooms send from their own worker threads, so each send builds its own address
+	struct sockaddr_in clientAddr;
+	memset( &clientAddr, 0, sizeof( clientAddr ) );
+	clientAddr.sin_family = AF_INET;
+	clientAddr.sin_addr.s_addr = info.m_ipAddress;
+	clientAddr.sin_port = info.m_portNumber;
+	sendto( g_socket, batch.m_buffer, batch.m_numBytesUsed, 0, (struct sockaddr*) &clientAddr, sizeof( clientAddr ) );
+	batch.Clear();
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void FlushOutgoingBatches( Room& room )
 {
-	g_clientAddr.sin_addr.s_addr = inet_addr( info.m_ipAddress );
-	g_clientAddr.sin_port = info.m_portNumber;
-	sendto( g_socket, (const char*) &pkt, sizeof( pkt ), 0, (struct sockaddr*) &g_clientAddr, g_clientLen );
-	++g_nextPacketNumber;
+	std::map< ClientInfo, PacketBatch >::iterator batchIter;
+	for( batchIter = room.m_outgoingBatchPerClient.begin(); batchIter != room.m_outgoingBatchPerClient.end(); ++batchIter )
+	{
+		SendBatchToSinglePlayer( batchIter->second, batchIter->first );
+	}
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void SendPacketToSinglePlayer( Room& room, const CS6Packet& pkt, const ClientInfo& info, bool requireAck )
+{
+	PacketBatch& batch = room.m_outgoingBatchPerClient[ info ];
+	if( !batch.AddMessage( pkt ) )
+	{
+		SendBatchToSinglePlayer( batch, info );
+		batch.AddMessage( pkt );
+	}
+
+	++room.m_nextPacketNumber;
 
 	if( requireAck )
 	{
 		std::vector< CS6Packet > sentPackets;
-		std::map< ClientInfo, std::vector< CS6Packet > >::iterator vecIter = g_sentPacketsPerClient.find( info );
-		if( vecIter != g_sentPacketsPerClient.end() )
+		std::map< ClientInfo, std::vector< CS6Packet > >::iterator vecIter = room.m_sentPacketsPerClient.find( info );
+		if( vecIter != room.m_sentPacketsPerClient.end() )
 			sentPackets = vecIter->second;
 
 		sentPackets.push_back( pkt );
-		g_sentPacketsPerClient[ info ] = sentPackets;
+		room.m_sentPacketsPerClient[ info ] = sentPackets;
 	}
 }
 
 
 //-----------------------------------------------------------------------------------------------
-void SendPacketToAllPlayers( const CS6Packet& pkt, bool requireAck )
+void SendPacketToAllPlayers( Room& room, const CS6Packet& pkt, bool requireAck )
 {
 	std::map< ClientInfo, Player* >::iterator playerIter;
-	for( playerIter = g_players.begin(); playerIter != g_players.end(); ++playerIter )
+	for( playerIter = room.m_players.begin(); playerIter != room.m_players.end(); ++playerIter )
 	{
-		SendPacketToSinglePlayer( pkt, playerIter->first, requireAck );
+		SendPacketToSinglePlayer( room, pkt, playerIter->first, requireAck );
 	}
 }
 
 
 //-----------------------------------------------------------------------------------------------
-void ResetPlayer( const ClientInfo& info )
+void ResetPlayer( Room& room, const ClientInfo& info )
 {
-	std::map< ClientInfo, Player* >::iterator playerIter = g_players.find( info );
-	if( playerIter == g_players.end() )
+	std::map< ClientInfo, Player* >::iterator playerIter = room.m_players.find( info );
+	if( playerIter == room.m_players.end() )
 		return;
 
 	Player* player = playerIter->second;
-	player->m_position = GetRandomPosition();
+	player->m_position = GetRandomPosition( room );
 	player->m_velocity = Vector2( 0.f, 0.f );
 	player->m_orientationDegrees = 0.f;
 	player->m_lastUpdateTime = GetCurrentTimeSeconds();
 
 	CS6Packet resetPacket;
 	resetPacket.packetType = TYPE_Reset;
-	resetPacket.packetNumber = g_nextPacketNumber;
+	resetPacket.packetNumber = room.m_nextPacketNumber;
 	resetPacket.timestamp = GetCurrentTimeSeconds();
-	resetPacket.data.reset.flagXPosition = g_flagPosition.x;
-	resetPacket.data.reset.flagYPosition = g_flagPosition.y;
+	resetPacket.data.reset.flagXPosition = room.m_flagPosition.x;
+	resetPacket.data.reset.flagYPosition = room.m_flagPosition.y;
 	resetPacket.data.reset.playerXPosition = player->m_position.x;
 	resetPacket.data.reset.playerYPosition = player->m_position.y;
 	resetPacket.data.reset.playerColorAndID[0] = player->m_color.r;
 	resetPacket.data.reset.playerColorAndID[1] = player->m_color.g;
 	resetPacket.data.reset.playerColorAndID[2] = player->m_color.b;
 
-	SendPacketToSinglePlayer( resetPacket, info, true );
+	SendPacketToSinglePlayer( room, resetPacket, info, true );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+unsigned int GetUnusedPlayerID( const Room& room )
+{
+	for( unsigned int playerID = 0; playerID < MAX_PLAYERS_PER_ROOM; ++playerID )
+	{
+		bool isIDTaken = false;
+		std::map< ClientInfo, Player* >::const_iterator playerIter;
+		for( playerIter = room.m_players.begin(); playerIter != room.m_players.end() && !isIDTaken; ++playerIter )
+			isIDTaken = ( playerIter->second->m_playerID == playerID );
+
+		if( !isIDTaken )
+			return playerID;
+	}
+
+	return (unsigned int) room.m_players.size();
 }
 
 
 //-----------------------------------------------------------------------------------------------
-void AddPlayer( const ClientInfo& info )
+void AddPlayer( Room& room, const ClientInfo& info )
 {
-	std::map< ClientInfo, Player* >::iterator playerIter = g_players.find( info );
-	if( playerIter == g_players.end() )
+	std::map< ClientInfo, Player* >::iterator playerIter = room.m_players.find( info );
+	if( playerIter == room.m_players.end() )
 	{
 		Player* player = new Player();
-		player->m_color = GetPlayerColorForID( g_players.size() );
-		g_players[ info ] = player;
-		std::cout << "Added client " << info.m_ipAddress << ":" << ConvertNumberToString( info.m_portNumber ) << ". ";
-		std::cout << "Set to color <" << ConvertNumberToString( player->m_color.r ) << ", " << ConvertNumberToString( player->m_color.g ) << ", " << ConvertNumberToString( player->m_color.b ) << ">\n";
+		player->m_playerID = GetUnusedPlayerID( room );
+		player->m_color = GetPlayerColorForID( player->m_playerID );
+		room.m_players[ info ] = player;
+		PrintRoomMessage( room, "Added client " + GetClientAddressString( info ) + ". Set to color <" + ConvertNumberToString( player->m_color.r ) + ", " + ConvertNumberToString( player->m_color.g ) + ", " + ConvertNumberToString( player->m_color.b ) + ">" );
 	}
 
-	ResetPlayer( info );
+	ResetPlayer( room, info );
 }
 
 
@@ -221,10 +334,10 @@ void SendPlayerRemoval( Player* timeOutPlayer )
 
 
 //-----------------------------------------------------------------------------------------------
-void UpdatePlayer( const CS6Packet& pkt, const ClientInfo& info )
+void UpdatePlayer( Room& room, const CS6Packet& pkt, const ClientInfo& info )
 {
-	std::map< ClientInfo, Player* >::iterator playerIter = g_players.find( info );
-	if( playerIter == g_players.end() )
+	std::map< ClientInfo, Player* >::iterator playerIter = room.m_players.find( info );
+	if( playerIter == room.m_players.end() )
 		return;
 
 	Player* player = playerIter->second;
@@ -238,10 +351,10 @@ void UpdatePlayer( const CS6Packet& pkt, const ClientInfo& info )
 
 
 //-----------------------------------------------------------------------------------------------
-void SendVictory( const CS6Packet& clientVictoryPacket, const ClientInfo& info )
+void SendVictory( Room& room, const CS6Packet& clientVictoryPacket, const ClientInfo& info )
 {
 	CS6Packet ackPacket;
-	ackPacket.packetNumber = g_nextPacketNumber;
+	ackPacket.packetNumber = room.m_nextPacketNumber;
 	ackPacket.packetType = TYPE_Acknowledge;
 	ackPacket.playerColorAndID[0] = clientVictoryPacket.playerColorAndID[0];
 	ackPacket.playerColorAndID[1] = clientVictoryPacket.playerColorAndID[1];
@@ -250,38 +363,240 @@ void SendVictory( const CS6Packet& clientVictoryPacket, const ClientInfo& info )
 	ackPacket.data.acknowledged.packetNumber = clientVictoryPacket.packetNumber;
 	ackPacket.data.acknowledged.packetType = TYPE_Victory;
 
-	SendPacketToSinglePlayer( ackPacket, info, false );
+	SendPacketToSinglePlayer( room, ackPacket, info, false );
 
-	std::cout << "Client " << info.m_ipAddress << ":" << ConvertNumberToString( info.m_portNumber ) << " has captured the flag. Reseting game.\n";
+	PrintRoomMessage( room, "Client " + GetClientAddressString( info ) + " has captured the flag. Reseting game." );
 
-	g_flagPosition = GetRandomPosition();
+	room.m_flagPosition = GetRandomPosition( room );
 
 	CS6Packet serverVictoryPacket;
-	serverVictoryPacket.packetNumber = g_nextPacketNumber;
+	serverVictoryPacket.packetNumber = room.m_nextPacketNumber;
 	serverVictoryPacket.packetType = TYPE_Victory;
 	serverVictoryPacket.timestamp = GetCurrentTimeSeconds();
 	serverVictoryPacket.data.victorious.playerColorAndID[0] = clientVictoryPacket.playerColorAndID[0];
 	serverVictoryPacket.data.victorious.playerColorAndID[1] = clientVictoryPacket.playerColorAndID[1];
 	serverVictoryPacket.data.victorious.playerColorAndID[2] = clientVictoryPacket.playerColorAndID[2];
 
-	SendPacketToAllPlayers( serverVictoryPacket, true );
+	SendPacketToAllPlayers( room, serverVictoryPacket, true );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+unsigned int MixCookieBits( unsigned int hash )
+{
+	hash ^= hash >> 16;
+	hash *= 0x85ebca6b;
+	hash ^= hash >> 13;
+	hash *= 0xc2b2ae35;
+	hash ^= hash >> 16;
+	return hash;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+//Anyone who sees one cookie could work a rand() seeded secret back out and forge the rest, so the
+//secret comes from the system's cryptographic generator instead.
+void GenerateCookieSecret()
+{
+	HCRYPTPROV cryptProvider;
+	if( !CryptAcquireContext( &cryptProvider, NULL, NULL, PROV_RSA_FULL, CRYPT_VERIFYCONTEXT | CRYPT_SILENT ) )
+	{
+		PrintError( "Failed to acquire a cryptographic provider for the cookie secret", true );
+		g_isQuitting = true;
+		return;
+	}
+
+	if( !CryptGenRandom( cryptProvider, sizeof( g_cookieSecret ), reinterpret_cast< BYTE* >( &g_cookieSecret ) ) )
+	{
+		PrintError( "Failed to generate the cookie secret", true );
+		g_isQuitting = true;
+	}
+
+	CryptReleaseContext( cryptProvider, 0 );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+unsigned int ComputeChallengeCookie( const ClientInfo& info, unsigned int cookieWindow )
+{
+	unsigned int hash = MixCookieBits( g_cookieSecret ^ cookieWindow );
+	hash = MixCookieBits( hash ^ (unsigned int) info.m_ipAddress );
+	hash = MixCookieBits( hash ^ info.m_portNumber );
+	return hash;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+unsigned int GetCurrentCookieWindow()
+{
+	return (unsigned int) ( GetCurrentTimeSeconds() / SECONDS_PER_COOKIE_WINDOW );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+bool IsChallengeCookieValid( unsigned int cookie, const ClientInfo& info )
+{
+	unsigned int cookieWindow = GetCurrentCookieWindow();
+	return ( cookie == ComputeChallengeCookie( info, cookieWindow ) || cookie == ComputeChallengeCookie( info, cookieWindow - 1 ) );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void PruneIdleJoinBuckets()
+{
+	double currentTime = GetCurrentTimeSeconds();
+	if( ( currentTime - g_lastJoinBucketPruneTime ) < SECONDS_BETWEEN_JOIN_BUCKET_PRUNES )
+		return;
+
+	g_lastJoinBucketPruneTime = currentTime;
+
+	std::map< unsigned long, TokenBucket >::iterator bucketIter = g_joinBucketPerAddress.begin();
+	while( bucketIter != g_joinBucketPerAddress.end() )
+	{
+		if( bucketIter->second.IsFull( JOIN_TOKENS_PER_SECOND_PER_ADDRESS, JOIN_BURST_TOKENS_PER_ADDRESS, currentTime ) )
+			g_joinBucketPerAddress.erase( bucketIter++ );
+		else
+			++bucketIter;
+	}
 }
 
 
 //-----------------------------------------------------------------------------------------------
-void ProcessAckPacket( const CS6Packet& ackPacket, const ClientInfo& info )
+bool TryConsumeJoinToken( unsigned long ipAddress )
 {
-	if( ackPacket.data.acknowledged.packetType == TYPE_Acknowledge )
+	double currentTime = GetCurrentTimeSeconds();
+	std::map< unsigned long, TokenBucket >::iterator bucketIter = g_joinBucketPerAddress.find( ipAddress );
+	if( bucketIter == g_joinBucketPerAddress.end() )
+	{
+		if( g_joinBucketPerAddress.size() >= MAX_TRACKED_JOIN_ADDRESSES )
+		{
+			PruneIdleJoinBuckets();
+			if( g_joinBucketPerAddress.size() >= MAX_TRACKED_JOIN_ADDRESSES )
+				return false;
+		}
+
+		bucketIter = g_joinBucketPerAddress.insert( std::make_pair( ipAddress, TokenBucket( JOIN_BURST_TOKENS_PER_ADDRESS, currentTime ) ) ).first;
+	}
+
+	return bucketIter->second.TryConsume( JOIN_TOKENS_PER_SECOND_PER_ADDRESS, JOIN_BURST_TOKENS_PER_ADDRESS, currentTime );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void SendChallenge( const ClientInfo& info )
+{
+	// handshake packets are numbered on their own so they never take a number out of a room's
+	// reliable sequence
+	CS6Packet challengePacket;
+	challengePacket.packetNumber = g_nextHandshakePacketNumber++;
+	challengePacket.packetType = TYPE_Challenge;
+	challengePacket.timestamp = GetCurrentTimeSeconds();
+	challengePacket.data.challenge.cookie = ComputeChallengeCookie( info, GetCurrentCookieWindow() );
+
+	// sent straight out so that unknown clients never get per-client state
+	PacketBatch challengeBatch;
+	challengeBatch.AddMessage( challengePacket );
+	SendBatchToSinglePlayer( challengeBatch, info );
+	++g_admissionStats.m_challengesSent;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void ProcessJoinRequest( const ClientInfo& info )
+{
+	++g_admissionStats.m_joinRequests;
+	if( !TryConsumeJoinToken( info.m_ipAddress ) )
+	{
+		++g_admissionStats.m_rejectedRateLimited;
+		return;
+	}
+
+	SendChallenge( info );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+Room* CreateRoom()
+{
+	Room* room = new Room( g_nextRoomID++, ( (unsigned int) rand() << 15 ) ^ (unsigned int) rand() );
+	room->m_flagPosition = GetRandomPosition( *room );
+	room->m_secondsSinceLastUpdate = GetCurrentTimeSeconds();
+	room->m_secondsSinceLastReliableSend = GetCurrentTimeSeconds();
+	g_rooms.push_back( room );
+	PrintRoomMessage( *room, "Opened" );
+	return room;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+Room* FindRoomWithOpenSlot()
+{
+	// fill the oldest rooms first so that matches start with as many players as possible
+	for( unsigned int roomIndex = 0; roomIndex < g_rooms.size(); ++roomIndex )
+	{
+		if( g_rooms[ roomIndex ]->m_players.size() < MAX_PLAYERS_PER_ROOM )
+			return g_rooms[ roomIndex ];
+	}
+
+	if( g_rooms.size() < MAX_ROOMS )
+		return CreateRoom();
+
+	return nullptr;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void ProcessChallengeResponse( const CS6Packet& challengePacket, const ClientInfo& info )
+{
+	if( !IsChallengeCookieValid( challengePacket.data.challenge.cookie, info ) )
+	{
+		++g_admissionStats.m_rejectedBadCookie;
+		return;
+	}
+
+	if( !g_newSessionBucket.TryConsume( NEW_SESSIONS_PER_SECOND, NEW_SESSIONS_BURST, GetCurrentTimeSeconds() ) )
 	{
-		AddPlayer( info );
+		++g_admissionStats.m_rejectedSessionCap;
+		return;
 	}
-	else if( ackPacket.data.acknowledged.packetType == TYPE_Victory )
+
+	Room* room = FindRoomWithOpenSlot();
+	if( room == nullptr )
 	{
-		ResetPlayer( info );
+		++g_admissionStats.m_rejectedServerFull;
+		return;
 	}
 
-	std::map< ClientInfo, std::vector< CS6Packet > >::iterator vecIter = g_sentPacketsPerClient.find( info );
-	if( vecIter == g_sentPacketsPerClient.end() )
+	++g_admissionStats.m_admitted;
+	g_roomPerClient[ info ] = room;
+	AddPlayer( *room, info );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void ReportAdmissionStats()
+{
+	if( ( GetCurrentTimeSeconds() - g_lastAdmissionReportTime ) < SECONDS_BETWEEN_ADMISSION_REPORTS )
+		return;
+
+	g_lastAdmissionReportTime = GetCurrentTimeSeconds();
+	if( g_admissionStats.GetTotalRejected() == g_lastReportedNumRejected )
+		return;
+
+	g_lastReportedNumRejected = g_admissionStats.GetTotalRejected();
+	std::cout << "Join attempts: " << g_admissionStats.m_joinRequests << " requested, " << g_admissionStats.m_challengesSent << " challenged, " << g_admissionStats.m_admitted << " admitted. ";
+	std::cout << "Rejected: " << g_admissionStats.m_rejectedRateLimited << " rate limited, " << g_admissionStats.m_rejectedBadCookie << " bad cookie, " << g_admissionStats.m_rejectedSessionCap << " session cap, " << g_admissionStats.m_rejectedServerFull << " server full\n";
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void ProcessAckPacket( Room& room, const CS6Packet& ackPacket, const ClientInfo& info )
+{
+	if( ackPacket.data.acknowledged.packetType == TYPE_Acknowledge || ackPacket.data.acknowledged.packetType == TYPE_Victory )
+		ResetPlayer( room, info );
+
+	std::map< ClientInfo, std::vector< CS6Packet > >::iterator vecIter = room.m_sentPacketsPerClient.find( info );
+	if( vecIter == room.m_sentPacketsPerClient.end() )
 		return;
 
 	std::vector< CS6Packet > sentPackets = vecIter->second;
@@ -294,10 +609,44 @@ void ProcessAckPacket( const CS6Packet& ackPacket, const ClientInfo& info )
 			break;
 		}
 
-		SendPacketToSinglePlayer( packet, info, false ); // we don't want to re-add packet to list
+		SendPacketToSinglePlayer( room, packet, info, false ); // we don't want to re-add packet to list
 	}
 
-	g_sentPacketsPerClient[ info ] = sentPackets;
+	room.m_sentPacketsPerClient[ info ] = sentPackets;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void ProcessRepeatedChallengeResponse( Room& room, const CS6Packet&, const ClientInfo& info )
+{
+	ResetPlayer( room, info );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void RegisterPacketHandlers()
+{
+	g_packetHandlers.RegisterHandler( TYPE_Acknowledge, &ProcessAckPacket );
+	g_packetHandlers.RegisterHandler( TYPE_Update, &UpdatePlayer );
+	g_packetHandlers.RegisterHandler( TYPE_Victory, &SendVictory );
+	g_packetHandlers.RegisterHandler( TYPE_Challenge, &ProcessRepeatedChallengeResponse );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void RoutePacket( const CS6Packet& pkt, const ClientInfo& info )
+{
+	std::map< ClientInfo, Room* >::iterator roomIter = g_roomPerClient.find( info );
+	if( roomIter != g_roomPerClient.end() )
+	{
+		roomIter->second->m_inbox.push_back( RoomMessage( pkt, info ) );
+		return;
+	}
+
+	if( pkt.packetType == TYPE_Acknowledge && pkt.data.acknowledged.packetType == TYPE_Acknowledge )
+		ProcessJoinRequest( info );
+	else if( pkt.packetType == TYPE_Challenge )
+		ProcessChallengeResponse( pkt, info );
 }
 
 
@@ -305,34 +654,46 @@ void ProcessAckPacket( const CS6Packet& ackPacket, const ClientInfo& info )
 void GetPackets()
 {
 	CS6Packet pkt;
-	while( recvfrom( g_socket, (char*) &pkt, sizeof( pkt ), 0, (struct sockaddr*) &g_clientAddr, &g_clientLen ) > 0 )
+	char datagram[ DATAGRAM_MTU_IN_BYTES ];
+	int datagramSizeInBytes = 0;
+	int numDatagramsReceived = 0;
+	while( numDatagramsReceived < MAX_DATAGRAMS_PER_UPDATE && ( datagramSizeInBytes = recvfrom( g_socket, datagram, sizeof( datagram ), 0, (struct sockaddr*) &g_clientAddr, &g_clientLen ) ) > 0 )
 	{
+		++numDatagramsReceived;
 		ClientInfo info;
-		info.m_ipAddress = inet_ntoa( g_clientAddr.sin_addr );
+		info.m_ipAddress = g_clientAddr.sin_addr.s_addr;
 		info.m_portNumber = g_clientAddr.sin_port;
 
-		if( pkt.packetType == TYPE_Acknowledge )
+		PacketBatchReader batchReader( datagram, datagramSizeInBytes );
+		while( batchReader.GetNextMessage( pkt ) )
 		{
-			ProcessAckPacket( pkt, info );
-		}
-		else if( pkt.packetType == TYPE_Update )
-		{
-			UpdatePlayer( pkt, info );
-		}
-		else if( pkt.packetType == TYPE_Victory )
-		{
-			SendVictory( pkt, info );
+			RoutePacket( pkt, info );
 		}
 	}
 }
 
 
 //-----------------------------------------------------------------------------------------------
-void RemoveTimedOutPlayers()
+void ProcessRoomInbox( Room& room )
+{
+	for( unsigned int messageIndex = 0; messageIndex < room.m_inbox.size(); ++messageIndex )
+	{
+		const RoomMessage& message = room.m_inbox[ messageIndex ];
+		PacketHandlerFunc handler = g_packetHandlers.GetHandler( message.m_packet.packetType );
+		if( handler != nullptr )
+			handler( room, message.m_packet, message.m_clientInfo );
+	}
+
+	room.m_inbox.clear();
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void RemoveTimedOutPlayers( Room& room )
 {
 	std::map< ClientInfo, Player* > tempPlayerMap;
 	std::map< ClientInfo, Player* >::iterator playerIter;
-	for( playerIter = g_players.begin(); playerIter != g_players.end(); ++playerIter )
+	for( playerIter = room.m_players.begin(); playerIter != room.m_players.end(); ++playerIter )
 	{
 		Player* player = playerIter->second;
 		double timeSinceLastActivity = GetCurrentTimeSeconds() - player->m_lastUpdateTime;
@@ -340,11 +701,13 @@ void RemoveTimedOutPlayers()
 		{
 			SendPlayerRemoval( player );
 			delete playerIter->second;
-			std::map< ClientInfo, std::vector< CS6Packet > >::iterator vecIter = g_sentPacketsPerClient.find( playerIter->first );
-			if( vecIter != g_sentPacketsPerClient.end() )
+			room.m_departedClients.push_back( playerIter->first );
+			std::map< ClientInfo, std::vector< CS6Packet > >::iterator vecIter = room.m_sentPacketsPerClient.find( playerIter->first );
+			room.m_outgoingBatchPerClient.erase( playerIter->first );
+			if( vecIter != room.m_sentPacketsPerClient.end() )
 			{
-				g_sentPacketsPerClient.erase( vecIter );
-				std::cout << "Client " << vecIter->first.m_ipAddress << ":" << ConvertNumberToString( vecIter->first.m_portNumber ) << " has timed out and is removed.\n";
+				PrintRoomMessage( room, "Client " + GetClientAddressString( vecIter->first ) + " has timed out and is removed." );
+				room.m_sentPacketsPerClient.erase( vecIter );
 			}
 
 			continue;
@@ -353,15 +716,20 @@ void RemoveTimedOutPlayers()
 		tempPlayerMap[ playerIter->first ] = playerIter->second;
 	}
 
-	g_players = tempPlayerMap;
+	room.m_players = tempPlayerMap;
 }
 
 
 //-----------------------------------------------------------------------------------------------
-void ResendAckPackets()
+void ResendAckPackets( Room& room )
 {
+	if( ( GetCurrentTimeSeconds() - room.m_secondsSinceLastReliableSend ) < SECONDS_BEFORE_RESEND_RELIABLE_PACKETS )
+		return;
+
+	room.m_secondsSinceLastReliableSend = GetCurrentTimeSeconds();
+
 	std::map< ClientInfo, std::vector< CS6Packet > >::iterator vecIter;
-	for( vecIter = g_sentPacketsPerClient.begin(); vecIter != g_sentPacketsPerClient.end(); ++vecIter )
+	for( vecIter = room.m_sentPacketsPerClient.begin(); vecIter != room.m_sentPacketsPerClient.end(); ++vecIter )
 	{
 		std::vector< CS6Packet > sentPackets = vecIter->second;
 		for( unsigned int packetIndex = 0; packetIndex < sentPackets.size(); ++packetIndex )
@@ -369,7 +737,7 @@ void ResendAckPackets()
 			CS6Packet packet = sentPackets[ packetIndex ];
 			if( ( GetCurrentTimeSeconds() - packet.timestamp ) > SECONDS_BEFORE_RESEND_RELIABLE_PACKETS )
 			{
-				SendPacketToSinglePlayer( packet, vecIter->first, false ); // we don't want to re-add packet to list
+				SendPacketToSinglePlayer( room, packet, vecIter->first, false ); // we don't want to re-add packet to list
 			}
 		}
 	}
@@ -377,18 +745,17 @@ void ResendAckPackets()
 
 
 //-----------------------------------------------------------------------------------------------
-void SendUpdatesToClients()
+void SendUpdatesToClients( Room& room )
 {
-	if( ( GetCurrentTimeSeconds() - g_secondsSinceLastUpdate ) < SECONDS_BEFORE_SEND_UPDATE )
+	if( ( GetCurrentTimeSeconds() - room.m_secondsSinceLastUpdate ) < SECONDS_BEFORE_SEND_UPDATE )
 		return;
 
-	std::map< ClientInfo, Player* >::iterator addrIter;
 	std::map< ClientInfo, Player* >::iterator playerIter;
-	for( playerIter = g_players.begin(); playerIter != g_players.end(); ++playerIter )
+	for( playerIter = room.m_players.begin(); playerIter != room.m_players.end(); ++playerIter )
 	{
 		Player* player = playerIter->second;
 		CS6Packet updatePacket;
-		updatePacket.packetNumber = g_nextPacketNumber;
+		updatePacket.packetNumber = room.m_nextPacketNumber;
 		updatePacket.packetType = TYPE_Update;
 		updatePacket.playerColorAndID[0] = player->m_color.r;
 		updatePacket.playerColorAndID[1] = player->m_color.g;
@@ -400,10 +767,147 @@ void SendUpdatesToClients()
 		updatePacket.data.updated.yVelocity = player->m_velocity.y;
 		updatePacket.data.updated.yawDegrees = player->m_orientationDegrees;
 
-		SendPacketToAllPlayers( updatePacket, false );
+		SendPacketToAllPlayers( room, updatePacket, false );
+	}
+
+	room.m_secondsSinceLastUpdate = GetCurrentTimeSeconds();
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void TickRoom( Room& room )
+{
+	ProcessRoomInbox( room );
+	RemoveTimedOutPlayers( room );
+	SendUpdatesToClients( room );
+	ResendAckPackets( room );
+	FlushOutgoingBatches( room );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void TickClaimedRooms()
+{
+	LONG numRooms = (LONG) g_rooms.size();
+	LONG roomIndex;
+	while( ( roomIndex = InterlockedIncrement( &g_nextRoomToTick ) - 1 ) < numRooms )
+	{
+		TickRoom( *g_rooms[ roomIndex ] );
+	}
+}
+
+
+//-----------------------------------------------------------------------------------------------
+unsigned int __stdcall RoomWorkerThreadMain( void* )
+{
+	while( true )
+	{
+		WaitForSingleObject( g_roomTickStartSemaphore, INFINITE );
+		if( g_areRoomWorkersQuitting )
+			break;
+
+		TickClaimedRooms();
+		if( InterlockedDecrement( &g_numRoomWorkersTicking ) == 0 )
+			SetEvent( g_roomTickDoneEvent );
 	}
 
-	g_secondsSinceLastUpdate = GetCurrentTimeSeconds();
+	return 0;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void StartRoomWorkers()
+{
+	SYSTEM_INFO systemInfo;
+	GetSystemInfo( &systemInfo );
+
+	// the main thread ticks rooms too, so it counts as one of the workers
+	unsigned int numWorkerThreads = systemInfo.dwNumberOfProcessors > 1 ? systemInfo.dwNumberOfProcessors - 1 : 0;
+	if( numWorkerThreads > MAX_ROOM_WORKER_THREADS )
+		numWorkerThreads = MAX_ROOM_WORKER_THREADS;
+
+	g_roomTickStartSemaphore = CreateSemaphore( NULL, 0, MAX_ROOM_WORKER_THREADS, NULL );
+	g_roomTickDoneEvent = CreateEvent( NULL, FALSE, FALSE, NULL );
+	for( unsigned int threadIndex = 0; threadIndex < numWorkerThreads; ++threadIndex )
+	{
+		HANDLE workerThread = (HANDLE) _beginthreadex( NULL, 0, &RoomWorkerThreadMain, NULL, 0, NULL );
+		if( workerThread != 0 )
+			g_roomWorkerThreads.push_back( workerThread );
+	}
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void StopRoomWorkers()
+{
+	g_areRoomWorkersQuitting = true;
+	if( !g_roomWorkerThreads.empty() )
+	{
+		ReleaseSemaphore( g_roomTickStartSemaphore, (LONG) g_roomWorkerThreads.size(), NULL );
+		WaitForMultipleObjects( (DWORD) g_roomWorkerThreads.size(), &g_roomWorkerThreads[ 0 ], TRUE, INFINITE );
+	}
+
+	for( unsigned int threadIndex = 0; threadIndex < g_roomWorkerThreads.size(); ++threadIndex )
+		CloseHandle( g_roomWorkerThreads[ threadIndex ] );
+
+	g_roomWorkerThreads.clear();
+	CloseHandle( g_roomTickStartSemaphore );
+	CloseHandle( g_roomTickDoneEvent );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void TickRooms()
+{
+	if( g_rooms.empty() )
+		return;
+
+	g_nextRoomToTick = 0;
+	LONG numWorkersToWake = (LONG) g_roomWorkerThreads.size();
+	if( numWorkersToWake > (LONG) g_rooms.size() - 1 )
+		numWorkersToWake = (LONG) g_rooms.size() - 1;
+
+	g_numRoomWorkersTicking = numWorkersToWake;
+	if( numWorkersToWake > 0 )
+		ReleaseSemaphore( g_roomTickStartSemaphore, numWorkersToWake, NULL );
+
+	TickClaimedRooms();
+	if( numWorkersToWake > 0 )
+		WaitForSingleObject( g_roomTickDoneEvent, INFINITE );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void ReleaseDepartedClients()
+{
+	for( unsigned int roomIndex = 0; roomIndex < g_rooms.size(); ++roomIndex )
+	{
+		Room& room = *g_rooms[ roomIndex ];
+		for( unsigned int clientIndex = 0; clientIndex < room.m_departedClients.size(); ++clientIndex )
+			g_roomPerClient.erase( room.m_departedClients[ clientIndex ] );
+
+		room.m_departedClients.clear();
+	}
+}
+
+
+//-----------------------------------------------------------------------------------------------
+//Runs after the departed clients have been released, so nothing routes to an empty room any more.
+void CloseEmptyRooms()
+{
+	for( unsigned int roomIndex = 0; roomIndex < g_rooms.size(); )
+	{
+		Room* room = g_rooms[ roomIndex ];
+		if( !room->m_players.empty() || !room->m_inbox.empty() )
+		{
+			++roomIndex;
+			continue;
+		}
+
+		PrintRoomMessage( *room, "Closed" );
+		delete room;
+		g_rooms.erase( g_rooms.begin() + roomIndex );
+	}
 }
 
 
@@ -413,12 +917,16 @@ void Initialize()
 	srand( (unsigned int) time( NULL ) );
 
 	InitializeTime();
+	InitializeCriticalSection( &g_consoleCS );
 	InitializeServer();
-	g_flagPosition = GetRandomPosition();
-	g_secondsSinceLastUpdate = GetCurrentTimeSeconds();
-	g_secondsSinceLastReliableSend = GetCurrentTimeSeconds();
-
-	std::cout << "Server is up and running\n";
+	RegisterPacketHandlers();
+	StartRoomWorkers();
+	GenerateCookieSecret();
+	g_newSessionBucket = TokenBucket( NEW_SESSIONS_BURST, GetCurrentTimeSeconds() );
+	g_lastJoinBucketPruneTime = GetCurrentTimeSeconds();
+	g_lastAdmissionReportTime = GetCurrentTimeSeconds();
+
+	std::cout << "Server is up and running with " << g_roomWorkerThreads.size() + 1 << " room threads\n";
 }
 
 
@@ -426,9 +934,10 @@ void Initialize()
 void Update()
 {
 	GetPackets();
-	RemoveTimedOutPlayers();
-	SendUpdatesToClients();
-	ResendAckPackets();
+	TickRooms();
+	ReleaseDepartedClients();
+	CloseEmptyRooms();
+	ReportAdmissionStats();
 }
 
 
@@ -442,7 +951,9 @@ int main( int, char* )
 		Update();
 	}
 
+	StopRoomWorkers();
 	closesocket( g_socket );
 	WSACleanup();
+	DeleteCriticalSection( &g_consoleCS );
 	return 0;
 }
\ No newline at end of file